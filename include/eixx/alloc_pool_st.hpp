@@ -31,6 +31,7 @@ limitations under the License.
 
 #include <boost/pool/pool_alloc.hpp>
 #include <boost/pool/detail/mutex.hpp>
+#include <eixx/marshal/alloc_base.hpp>
 
 #define EIXX_USE_ALLOCATOR
 
@@ -42,6 +43,25 @@ typedef boost::fast_pool_allocator<
     , boost::details::pool::null_mutex
 > allocator_t;
 
+namespace marshal {
+
+    /// Pool allocators without a mutex are single-threaded, so terms
+    /// allocated by them don't need atomic reference counting.
+    template <typename T, typename UA, unsigned NS, unsigned MS>
+    struct refcount_traits<
+        boost::fast_pool_allocator<T, UA, boost::details::pool::null_mutex, NS, MS>
+    > {
+        typedef plain_counter<int> counter_type;
+    };
+
+    template <typename T, typename UA, unsigned NS, unsigned MS>
+    struct refcount_traits<
+        boost::pool_allocator<T, UA, boost::details::pool::null_mutex, NS, MS>
+    > {
+        typedef plain_counter<int> counter_type;
+    };
+
+} // namespace marshal
 } // namespace eixx
 
 #endif // _EIXX_ALLOC_POOL_HPP_
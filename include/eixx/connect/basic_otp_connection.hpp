@@ -173,7 +173,7 @@ public:
             m_on_connect_status(this, std::string());
         if (unlikely(verbose() > VERBOSE_NONE)) {
             report_status(REPORT_INFO,
-                "Connected to node: " + a_con->remote_nodename().to_string());
+                "Connected to node: " + std::string(a_con->remote_nodename().to_string()));
         }
     }
 
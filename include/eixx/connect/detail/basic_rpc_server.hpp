@@ -105,7 +105,8 @@ public:
     }
 
     static eterm<Alloc> decode_rpc(const eterm<Alloc>& a_msg) {
-        static const eterm<Alloc> s_pattern = eterm<Alloc>::format("{rex, ~v}", var(T));
+        static const eterm<Alloc> s_pattern =
+            eterm<Alloc>::format("{rex, ~v}", var(T)).freeze();
 
         if (a_msg.type() != TUPLE)
             return eterm<Alloc>();
@@ -29,7 +29,13 @@ limitations under the License.
 #ifndef _EIXX_TRANSPORT_MSG_HPP_
 #define _EIXX_TRANSPORT_MSG_HPP_
 
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <mutex>
 #include <eixx/marshal/eterm.hpp>
+#include <eixx/marshal/atom_cache.hpp>
+#include <eixx/marshal/eterm_view.hpp>
 #include <eixx/util/common.hpp>
 #include <ei.h>
 
@@ -39,6 +45,8 @@ namespace connect {
 using eixx::marshal::tuple;
 using eixx::marshal::list;
 using eixx::marshal::eterm;
+using eixx::marshal::eterm_view;
+using eixx::marshal::atom_decode_cache;
 using eixx::marshal::epid;
 using eixx::marshal::ref;
 using eixx::marshal::trace;
@@ -77,26 +85,50 @@ private:
     // constant objects.
     mutable transport_msg_type  m_type;
     tuple<Alloc>                m_cntrl;
-    eterm<Alloc>                m_msg;
+    // The payload received from the wire is kept encoded in m_msg_view
+    // and decoded into m_msg on the first call to msg(). m_msg_state
+    // tells if m_msg is ready, so that concurrent calls of msg() decode
+    // it once. The atoms of the payload are looked up in the atom cache
+    // of the connection it was received from, if it's given.
+    enum msg_state { MSG_READY, MSG_PENDING, MSG_DECODING };
+
+    mutable eterm<Alloc>        m_msg;
+    eterm_view<Alloc>           m_msg_view;
+    mutable std::atomic<int>    m_msg_state;
+    std::shared_ptr<atom_decode_cache> m_atom_cache;
+
+    /// Decode m_msg from m_msg_view unless another thread did or is doing it.
+    void decode_msg() const;
 
 public:
-    transport_msg() : m_type(UNDEFINED) {}
+    transport_msg() : m_type(UNDEFINED), m_msg_state(MSG_READY) {}
 
     transport_msg(int a_msgtype, const tuple<Alloc>& a_cntrl, const eterm<Alloc>* a_msg = NULL)
-        : m_type(1 << a_msgtype), m_cntrl(a_cntrl)
+        : m_type(1 << a_msgtype), m_cntrl(a_cntrl), m_msg_state(MSG_READY)
     {
         if (a_msg)
             new (&m_msg) eterm<Alloc>(*a_msg);
     }
 
     transport_msg(const transport_msg& rhs)
-        : m_type(rhs.m_type), m_cntrl(rhs.m_cntrl), m_msg(rhs.m_msg)
-    {}
+        : m_type(rhs.m_type), m_cntrl(rhs.m_cntrl), m_msg_view(rhs.m_msg_view)
+        , m_msg_state(MSG_PENDING), m_atom_cache(rhs.m_atom_cache)
+    {
+        // m_msg of rhs may only be read once it's decoded
+        if (rhs.m_msg_state.load(std::memory_order_acquire) == MSG_READY) {
+            m_msg = rhs.m_msg;
+            m_msg_state.store(MSG_READY, std::memory_order_relaxed);
+        }
+    }
 
     transport_msg(transport_msg&& rhs)
         : m_type(rhs.m_type), m_cntrl(std::move(rhs.m_cntrl)), m_msg(std::move(rhs.m_msg))
+        , m_msg_view(std::move(rhs.m_msg_view))
+        , m_msg_state(rhs.m_msg_state.load(std::memory_order_relaxed))
+        , m_atom_cache(std::move(rhs.m_atom_cache))
     {
         rhs.m_type = UNDEFINED;
+        rhs.m_msg_state.store(MSG_READY, std::memory_order_relaxed);
     }
 
     /// Return a string representation of the transport message type.
@@ -106,10 +138,19 @@ public:
     transport_msg_type  type()      const { return m_type; }
     int                 to_type()   const { return m_type == UNDEFINED ? 0 : bit_scan_forward(m_type); }
     const tuple<Alloc>& cntrl()     const { return m_cntrl;}
-    const eterm<Alloc>& msg()       const { return m_msg;  }
+    /// Message payload. If the message was set from a view, the payload
+    /// is decoded on the first call. It's safe to call from several threads.
+    const eterm<Alloc>& msg()       const {
+        if (unlikely(m_msg_state.load(std::memory_order_acquire) != MSG_READY))
+            decode_msg();
+        return m_msg;
+    }
+    /// Encoded message payload. It is empty unless the message was set
+    /// from a view.
+    const eterm_view<Alloc>& msg_view() const { return m_msg_view; }
     /// Returns true when the transport message contains message payload
     /// associated with SEND or REG_SEND message type.
-    bool                has_msg()   const { return m_msg.type() != eixx::UNDEFINED; }
+    bool                has_msg()   const { return !m_msg_view.empty() || !m_msg.empty(); }
 
     /// Indicates that there was an error processing this message
     bool  has_error()               const { return (m_type & EXCEPTION) == EXCEPTION; }
@@ -227,6 +268,23 @@ public:
             m_msg = *a_msg;
         else
             m_msg.clear();
+        m_msg_view = eterm_view<Alloc>();
+        m_msg_state.store(MSG_READY, std::memory_order_relaxed);
+        m_atom_cache.reset();
+    }
+
+    /// Initialize the object with the message payload given by a view
+    /// of its encoded form. The payload is not decoded until msg() is called,
+    /// which looks up its atoms in \a a_cache unless it's NULL.
+    void set(int a_msgtype, const tuple<Alloc>& a_cntrl, const eterm_view<Alloc>& a_msg,
+             const std::shared_ptr<atom_decode_cache>& a_cache = nullptr)
+    {
+        m_type = static_cast<transport_msg_type>(1 << a_msgtype);
+        m_cntrl = a_cntrl;
+        m_msg.clear();
+        m_msg_view = a_msg;
+        m_msg_state.store(a_msg.empty() ? MSG_READY : MSG_PENDING, std::memory_order_relaxed);
+        m_atom_cache = a_cache;
     }
 
     /// Set the current message to represent a SEND message containing \a a_msg to
@@ -456,6 +514,29 @@ const char* transport_msg<Alloc>::type_string() const {
     }
 }
 
+template <typename Alloc>
+void transport_msg<Alloc>::decode_msg() const {
+    int state = MSG_PENDING;
+    while (!m_msg_state.compare_exchange_weak(state, MSG_DECODING, std::memory_order_acquire)) {
+        if (state == MSG_READY)
+            return;
+        state = MSG_PENDING;
+        std::this_thread::yield();
+    }
+    try {
+        // Without the cache if another thread is using it
+        std::unique_lock<atom_decode_cache> lock;
+        if (m_atom_cache)
+            lock = std::unique_lock<atom_decode_cache>(*m_atom_cache, std::try_to_lock);
+        marshal::atom_cache_scope scope(nullptr, 0, lock ? m_atom_cache.get() : nullptr);
+        m_msg = m_msg_view.to_eterm();
+    } catch (...) {
+        m_msg_state.store(MSG_PENDING, std::memory_order_release);
+        throw;
+    }
+    m_msg_state.store(MSG_READY, std::memory_order_release);
+}
+
 } // namespace connect
 } // namespace eixx
 
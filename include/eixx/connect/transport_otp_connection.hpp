@@ -39,6 +39,7 @@ limitations under the License.
 #include <eixx/util/string_util.hpp>
 #include <eixx/connect/verbose.hpp>
 #include <eixx/marshal/string.hpp>
+#include <eixx/marshal/atom_cache.hpp>
 
 namespace eixx {
 namespace connect {
@@ -66,6 +67,7 @@ class connection
 protected:
     static const size_t         s_header_size;
     static const char           s_header_magic;
+    static const size_t         s_rd_buf_size;
     static const eterm<Alloc>   s_null_cookie;
 
     boost::asio::io_service&    m_io_service;
@@ -83,7 +85,9 @@ protected:
     size_t                      m_in_msg_count;
     size_t                      m_out_msg_count;
 
-    std::vector<char, Alloc>    m_rd_buf;           /// buffer for incoming data
+    marshal::char_blob<Alloc>   m_rd_buf;           /// buffer for incoming data
+                                                    /// (shared with large binaries
+                                                    /// decoded from it)
     char*                       m_rd_ptr;
     char*                       m_rd_end;
 
@@ -95,6 +99,15 @@ protected:
     size_t                      m_available_queue;  /// Index of the queue used for cacheing
     bool                        m_is_writing;
     bool                        m_connection_aborted;
+    bool                        m_utf8_atoms;       /// Peer supports UTF-8 atom tags
+
+    /// Atom caches of the distribution header, which are allocated when
+    /// the peer supports DFLAG_DIST_HDR_ATOM_CACHE.
+    std::unique_ptr<marshal::atom_cache_in>  m_atom_cache_in;
+    std::unique_ptr<marshal::atom_cache_out> m_atom_cache_out;
+    /// Atoms decoded from the received messages, which is shared with
+    /// the messages whose payloads are decoded after they are delivered.
+    std::shared_ptr<marshal::atom_decode_cache> m_atom_decode_cache;
 
     /// Construct a connection
     connection(connection_type a_ct, boost::asio::io_service& a_svc, 
@@ -103,10 +116,12 @@ protected:
         , m_allocator(a_alloc)
         , m_got_header(false), m_packet_size(s_header_size)
         , m_in_msg_count(0), m_out_msg_count(0)
-        , m_rd_buf(16*1024), m_rd_ptr(&m_rd_buf[0]), m_rd_end(&m_rd_buf[0])
+        , m_rd_buf(s_rd_buf_size, a_alloc), m_rd_ptr(m_rd_buf.data()), m_rd_end(m_rd_buf.data())
         , m_available_queue(0)
         , m_is_writing(false)
         , m_connection_aborted(false)
+        , m_utf8_atoms(false)
+        , m_atom_decode_cache(std::make_shared<marshal::atom_decode_cache>())
     {
         if (unlikely(handler()->verbose() >= VERBOSE_TRACE)) {
             std::stringstream s;
@@ -121,6 +136,14 @@ protected:
         return p;
     }
 
+    /// Start using the distribution header with empty atom caches for
+    /// the messages sent and received by the connection. The atoms of
+    /// the header are in UTF-8 if the peer supports UTF-8 atoms.
+    void enable_atom_cache() {
+        m_atom_cache_in.reset(new marshal::atom_cache_in(m_utf8_atoms));
+        m_atom_cache_out.reset(new marshal::atom_cache_out(m_utf8_atoms));
+    }
+
     /// Swap available and writing queue indexes.
     void   flip_queues()              { m_available_queue = writing_queue(); }
     /// Index of the queue used for writing to socket
@@ -130,7 +153,25 @@ protected:
 
     char*  rd_ptr()                 { return m_rd_ptr; }
     size_t rd_length()              { return m_rd_end - m_rd_ptr; }
-    size_t rd_capacity()            { return m_rd_buf.capacity() - rd_length(); }
+    size_t rd_capacity()            { return m_rd_buf.size() - (m_rd_end - m_rd_buf.data()); }
+
+    /// Make room for \a a_size bytes starting at rd_ptr().
+    void rd_reserve(size_t a_size) {
+        if (unlikely(m_rd_ptr + a_size > m_rd_buf.data() + m_rd_buf.size()))
+            rd_realloc(a_size);
+    }
+
+    /// Move unprocessed data to a new read buffer of at least \a a_size bytes.
+    /// This is done when the rest of the buffer is too small for the next
+    /// packet and binaries decoded from it may still reference its content.
+    void rd_realloc(size_t a_size) {
+        size_t len = rd_length();
+        marshal::char_blob<Alloc> buf(std::max(a_size, (size_t)s_rd_buf_size), m_allocator);
+        memcpy(buf.data(), m_rd_ptr, len);
+        m_rd_buf = std::move(buf);
+        m_rd_ptr = m_rd_buf.data();
+        m_rd_end = m_rd_ptr + len;
+    }
     /// Verboseness
     verbose_type verbose()    const { return m_handler->verbose(); }
 
@@ -175,6 +216,11 @@ protected:
 
     void process_message(const char* a_buf, size_t a_size);
 
+    /// Encode \a a_msg with the distribution header and queue it for
+    /// writing. Must be called by the thread running the I/O service, so
+    /// that the atom cache is updated in the order of the messages.
+    void write_cached(const transport_msg<Alloc>& a_msg);
+
     bool check_connected(const eterm<Alloc>* a_msg) {
         if (likely(!m_connection_aborted))
             return true;
@@ -288,6 +334,7 @@ public:
     virtual ~connection() {
         if (handler()->verbose() >= VERBOSE_TRACE)
             m_handler->report_status(REPORT_INFO, "Calling ~connection::connection()");
+        m_rd_buf.release();
     }
 
     /// Close connection channel orderly by user. 
@@ -328,6 +375,12 @@ public:
     Handler*                    handler()                   { return m_handler; }
     boost::asio::io_service&    io_service()                { return m_io_service; }
 
+    /// Number of atoms decoded from received messages that were found in
+    /// the connection's atom cache, and the number of the other ones,
+    /// including the atoms of payloads decoded by their recipients.
+    size_t                      atom_cache_hits()   const   { return m_atom_decode_cache->hits();   }
+    size_t                      atom_cache_misses() const   { return m_atom_decode_cache->misses(); }
+
     /// Send a message \a a_msg to the remote node.
     void send(const transport_msg<Alloc>& a_msg);
 
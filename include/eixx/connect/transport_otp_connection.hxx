@@ -46,6 +46,9 @@ const size_t connection<Handler, Alloc>::s_header_size = 4;
 template <class Handler, class Alloc>
 const char   connection<Handler, Alloc>::s_header_magic = 132;
 
+template <class Handler, class Alloc>
+const size_t connection<Handler, Alloc>::s_rd_buf_size = 16*1024;
+
 template <class Handler, class Alloc>
 const eterm<Alloc> connection<Handler, Alloc>::s_null_cookie;
 
@@ -208,9 +211,9 @@ handle_read(const boost::system::error_code& err, size_t bytes_transferred)
         s << "connection::handle_read(transferred="
           << bytes_transferred << ", got_header="
           << (m_got_header ? "true" : "false")
-          << ", rd_buf.size=" << m_rd_buf.capacity()
-          << ", rd_ptr=" << (m_rd_ptr - &m_rd_buf[0])
-          << ", rd_end=" << (m_rd_end - &m_rd_buf[0])
+          << ", rd_buf.size=" << m_rd_buf.size()
+          << ", rd_ptr=" << (m_rd_ptr - m_rd_buf.data())
+          << ", rd_end=" << (m_rd_end - m_rd_buf.data())
           << ", rd_capacity=" << rd_capacity()
           << ", pkt_sz=" << m_packet_size << " (ec="
           << err.value() << ')';
@@ -245,12 +248,7 @@ handle_read(const boost::system::error_code& err, size_t bytes_transferred)
             // Make sure that the buffer size is large enouch to store
             // next message.
             m_packet_size = cast_be<uint32_t>(m_rd_ptr);
-            if (m_packet_size > m_rd_buf.capacity()-s_header_size) {
-                size_t begin_offset = m_rd_ptr - &m_rd_buf[0];
-                m_rd_buf.reserve(begin_offset + m_packet_size + s_header_size);
-                m_rd_ptr = &m_rd_buf[0] + begin_offset;
-                m_rd_end = m_rd_ptr + len;
-            }
+            rd_reserve(m_packet_size + s_header_size);
         }
     }
 
@@ -259,10 +257,10 @@ handle_read(const boost::system::error_code& err, size_t bytes_transferred)
     /*
     if (unlikely(verbose() >= VERBOSE_WIRE))
         std::cout << "  pkt_size=" << m_packet_size << ", need=" << need_bytes
-                  << ", rd_ptr=" << (m_rd_ptr - &m_rd_buf[0])
-                  << ", rd_end=" << (m_rd_end - &m_rd_buf[0])
+                  << ", rd_ptr=" << (m_rd_ptr - m_rd_buf.data())
+                  << ", rd_end=" << (m_rd_end - m_rd_buf.data())
                   << ", length=" << rd_length()
-                  << ", rd_buf.size=" << m_rd_buf.capacity()
+                  << ", rd_buf.size=" << m_rd_buf.size()
                   << ", got_header=" << (m_got_header ? "true" : "false")
                   << ", " << to_binary_string(m_rd_ptr, std::min(rd_length(), 15lu)) << "..."
                   << std::endl;
@@ -278,9 +276,9 @@ handle_read(const boost::system::error_code& err, size_t bytes_transferred)
             if (unlikely(verbose() >= VERBOSE_WIRE)) {
                 std::cout << " MsgCnt=" << m_in_msg_count
                           << ", pkt_size=" << m_packet_size << ", need=" << need_bytes
-                          << ", rd_buf.size=" << m_rd_buf.capacity()
-                          << ", rd_ptr=" << (m_rd_ptr - &m_rd_buf[0])
-                          << ", rd_end=" << (m_rd_end - &m_rd_buf[0])
+                          << ", rd_buf.size=" << m_rd_buf.size()
+                          << ", rd_ptr=" << (m_rd_ptr - m_rd_buf.data())
+                          << ", rd_end=" << (m_rd_end - m_rd_buf.data())
                           << ", len=" << rd_length()
                           << ", rd_capacity=" << rd_capacity()
                           << std::endl;
@@ -289,7 +287,10 @@ handle_read(const boost::system::error_code& err, size_t bytes_transferred)
             }
             */
 
-            // Decode the packet into a message and dispatch it.
+            // Decode the packet into a message and dispatch it. Large
+            // binaries in the message reference the read buffer instead
+            // of being copied out of it.
+            marshal::binary_slice_scope<Alloc> scope(m_rd_buf);
             process_message(m_rd_ptr, m_packet_size);
 
         } catch (std::exception& e) {
@@ -305,29 +306,38 @@ handle_read(const boost::system::error_code& err, size_t bytes_transferred)
         }
     }
     bool crunched = false;
+    // Processed bytes may only be overwritten when no binaries reference them.
+    // Otherwise reading continues past them, and the leftover bytes are
+    // moved to a new buffer only when the pending packet doesn't fit.
+    bool shared   = m_rd_buf.use_count() > 1;
 
     if (m_rd_ptr == m_rd_end) {
-        m_rd_ptr = &m_rd_buf[0];
-        m_rd_end = m_rd_ptr;
+        if (likely(!shared)) {
+            m_rd_ptr = m_rd_buf.data();
+            m_rd_end = m_rd_ptr;
+        }
         m_packet_size = s_header_size;
         need_bytes    = m_packet_size;
-    } else if ((m_rd_ptr - (&m_rd_buf[0] + s_header_size)) > 0) {
-        // Crunch the buffer by copying leftover bytes to the beginning of the buffer.
-        const size_t len = m_rd_end - m_rd_ptr;
-        char* begin = &m_rd_buf[0];
-        if (likely((size_t)(m_rd_ptr - begin) < len))
-            memcpy(begin, m_rd_ptr, len);
-        else
-            memmove(begin, m_rd_ptr, len);
-        m_rd_ptr = begin;
-        m_rd_end = begin + len;
-        crunched = true;
+    } else if ((m_rd_ptr - (m_rd_buf.data() + s_header_size)) > 0) {
+        if (likely(!shared)) {
+            // Crunch the buffer by copying leftover bytes to the beginning of the buffer.
+            const size_t len = m_rd_end - m_rd_ptr;
+            char* begin = m_rd_buf.data();
+            if (likely((size_t)(m_rd_ptr - begin) >= len))
+                memcpy(begin, m_rd_ptr, len);
+            else
+                memmove(begin, m_rd_ptr, len);
+            m_rd_ptr = begin;
+            m_rd_end = begin + len;
+            crunched = true;
+        }
     }
+    rd_reserve(m_got_header ? m_packet_size + s_header_size : s_header_size);
 
     if (unlikely(verbose() >= VERBOSE_WIRE)) {
         std::stringstream s;
         s << "Scheduling connection::async_read(offset="
-          << (m_rd_end-&m_rd_buf[0])
+          << (m_rd_end-m_rd_buf.data())
           << ", capacity=" << rd_capacity() << ", pkt_size="
           << m_packet_size << ", need=" << need_bytes
           << ", got_header=" << (m_got_header ? "true" : "false")
@@ -362,18 +372,32 @@ transport_msg_decode(const char *mbuf, int len, transport_msg<Alloc>& a_tm)
         return ERL_TICK;
 
     /* now decode header */
-    /* pass-through, version, control tuple header, control message type */
-    if (unlikely(get8(s) != ERL_PASS_THROUGH)) {
+    /* Either a distribution header followed by the terms without the
+     * version byte, or pass-through, version, control tuple header,
+     * control message type */
+    marshal::atom_cache_in::header_refs refs;
+    size_t nrefs   = 0;
+    bool   dist_hdr= (uint8_t)*s == ERL_VERSION_MAGIC;
+
+    if (dist_hdr) {
+        if (unlikely(!m_atom_cache_in) || unlikely(s[1] != ERL_DIST_HEADER))
+            throw err_decode_exception("Unexpected distribution header", len);
+        s += 2;
+        nrefs = m_atom_cache_in->decode_header(s, mbuf + len, refs);
+    } else if (unlikely(get8(s) != ERL_PASS_THROUGH)) {
         int n = len < 65 ? len : 64;
         std::string s = std::string("Missing pass-throgh flag in message")
                       + to_binary_string(mbuf, n);
         throw err_decode_exception(s, len);
-    }
-
-    if (unlikely(ei_decode_version(s,&index,&version) || version != ERL_VERSION_MAGIC))
+    } else if (unlikely(ei_decode_version(s,&index,&version) || version != ERL_VERSION_MAGIC))
         throw err_decode_exception("Invalid control message magic number", version);
 
-    tuple<Alloc> cntrl(s, index, len, m_allocator);
+    // The cache may be in use by a thread decoding an earlier payload
+    std::unique_lock<marshal::atom_decode_cache> l_lock(*m_atom_decode_cache, std::try_to_lock);
+    marshal::atom_cache_scope l_scope(refs.data(), nrefs,
+                                      l_lock ? m_atom_decode_cache.get() : nullptr);
+
+    tuple<Alloc> cntrl(s, index, mbuf + len - s, m_allocator);
 
     int msgtype = cntrl[0].to_long();
 
@@ -385,11 +409,22 @@ transport_msg_decode(const char *mbuf, int len, transport_msg<Alloc>& a_tm)
                                              | 1 << ERL_SEND_TT
                                              | 1 << ERL_REG_SEND_TT;
     if (likely((1 << msgtype) & types_with_payload)) {
-        if (unlikely(ei_decode_version(s,&index,&version)) || unlikely((version != ERL_VERSION_MAGIC)))
+        if (unlikely(!dist_hdr) &&
+           (unlikely(ei_decode_version(s,&index,&version)) || unlikely((version != ERL_VERSION_MAGIC))))
             throw err_decode_exception("Invalid message magic number", version);
 
-        eterm<Alloc> msg(s, index, len, m_allocator);
-        a_tm.set(msgtype, cntrl, &msg);
+        if (nrefs > 0) {
+            // Atom cache references are only valid while the header's
+            // scope is active, so the payload is decoded eagerly.
+            eterm<Alloc> msg(s, index, mbuf + len - s, m_allocator);
+            a_tm.set(msgtype, cntrl, &msg);
+        } else {
+            // The payload references the read buffer (see the
+            // binary_slice_scope in handle_read()) and gets decoded when
+            // the recipient accesses it.
+            eterm_view<Alloc> msg(s + index, mbuf + len - s - index, m_allocator);
+            a_tm.set(msgtype, cntrl, msg, m_atom_decode_cache);
+        }
     } else {
         a_tm.set(msgtype, cntrl);
     }
@@ -452,6 +487,13 @@ send(const transport_msg<Alloc>& a_msg)
     if (!check_connected(&a_msg.msg()))
         return;
 
+    if (m_atom_cache_out) {
+        auto pthis = this->shared_from_this();
+        m_io_service.post([pthis, a_msg]() { pthis->write_cached(a_msg); });
+        return;
+    }
+
+    marshal::atom_cache_scope l_scope(nullptr, m_utf8_atoms);
     eterm<Alloc> l_cntrl(a_msg.cntrl());
     bool   l_has_msg= a_msg.has_msg();
     size_t cntrl_sz = l_cntrl.encode_size(0, true);
@@ -480,6 +522,44 @@ send(const transport_msg<Alloc>& a_msg)
         std::bind(&connection<Handler, Alloc>::do_write, this->shared_from_this(), b));
 }
 
+template <class Handler, class Alloc>
+void connection<Handler, Alloc>::
+write_cached(const transport_msg<Alloc>& a_msg)
+{
+    if (!check_connected(&a_msg.msg()))
+        return;
+
+    marshal::atom_cache_out& l_cache = *m_atom_cache_out;
+    marshal::atom_cache_scope l_scope(&l_cache, m_utf8_atoms);
+    l_cache.begin();
+
+    eterm<Alloc> l_cntrl(a_msg.cntrl());
+    bool   l_has_msg= a_msg.has_msg();
+    size_t cntrl_sz = l_cntrl.encode_size(0, false);
+    size_t msg_sz   = l_has_msg ? a_msg.msg().encode_size(0, false) : 0;
+    size_t hdr_sz   = l_cache.header_size();
+    size_t len      = hdr_sz + cntrl_sz + msg_sz + 4 /*len*/;
+    char*  data     = allocate(len);
+    char*  s        = data;
+    put32be(s, len-4);
+    l_cache.encode_header(s);
+    BOOST_ASSERT(s == data + 4 + hdr_sz);
+    l_cntrl.encode(s, cntrl_sz, 0, false);
+    if (l_has_msg)
+        a_msg.msg().encode(s + cntrl_sz, msg_sz, 0, false);
+
+    if (unlikely(verbose() >= VERBOSE_MESSAGE)) {
+        std::stringstream s;
+        s << "SEND cntrl="
+          << l_cntrl.to_string() << (l_has_msg ? ", msg=" : "")
+          << (l_has_msg ? a_msg.msg().to_string() : std::string(""));
+        m_handler->report_status(REPORT_INFO, s.str());
+    }
+
+    boost::asio::const_buffer b(data, len);
+    do_write(b);
+}
+
 } // namespace connect
 } // namespace eixx
 
@@ -64,6 +64,8 @@ static const int   DFLAG_FUN_TAGS               = 16;
 static const int   DFLAG_NEW_FUN_TAGS           = 0x80;
 static const int   DFLAG_EXTENDED_PIDS_PORTS    = 0x100;
 static const int   DFLAG_NEW_FLOATS             = 0x800;
+static const int   DFLAG_DIST_HDR_ATOM_CACHE    = 0x2000;
+static const int   DFLAG_UTF8_ATOMS             = 0x10000;
 #endif
 
 //----------------------------------------------------------------------------
@@ -153,7 +155,7 @@ private:
     void start();
 
     std::string remote_alivename() const {
-        auto s = this->remote_nodename().to_string();
+        std::string s = this->remote_nodename().to_string();
 #ifndef NDEBUG
         auto n = s.find('@');
 #endif
@@ -161,7 +163,7 @@ private:
         return s.substr(0, s.find('@'));
     }
     std::string remote_hostname() const {
-        auto s = this->remote_nodename().to_string();
+        std::string s = this->remote_nodename().to_string();
 #ifndef NDEBUG
         auto n = s.find('@');
 #endif
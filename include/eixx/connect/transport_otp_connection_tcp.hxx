@@ -336,7 +336,9 @@ void tcp_connection<Handler, Alloc>::handle_connect(const boost::system::error_c
                 | DFLAG_FUN_TAGS
                 | DFLAG_NEW_FUN_TAGS
                 | DFLAG_NEW_FLOATS
-                | DFLAG_DIST_MONITOR));
+                | DFLAG_DIST_MONITOR
+                | DFLAG_DIST_HDR_ATOM_CACHE
+                | DFLAG_UTF8_ATOMS));
     memcpy(w, this->local_nodename().c_str(), this->local_nodename().size());
 
     if (this->handler()->verbose() >= VERBOSE_TRACE) {
@@ -535,6 +537,10 @@ void tcp_connection<Handler, Alloc>::handle_read_challenge_body(
         this->handler()->report_status(REPORT_INFO, s.str());
     }
 
+    this->m_utf8_atoms = (flags & DFLAG_UTF8_ATOMS) != 0;
+    if (flags & DFLAG_DIST_HDR_ATOM_CACHE)
+        this->enable_atom_cache();
+
     uint8_t our_digest[16];
     gen_digest(m_remote_challenge, this->m_cookie.c_str(), our_digest);
 
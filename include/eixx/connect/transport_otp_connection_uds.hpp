@@ -83,16 +83,17 @@ private:
         base_t::connect(a_this_node, a_remote_nodename, a_cookie);
 
         boost::system::error_code err;
-        boost::asio::local::stream_protocol::endpoint endpoint(a_remote_nodename.to_string());
+        std::string name = a_remote_nodename.to_string();
+        boost::asio::local::stream_protocol::endpoint endpoint(name);
         m_socket.connect(endpoint, err);
         if (err)
             THROW_RUNTIME_ERROR("Error connecting to: " << m_uds_filename 
                 << ':' << err.message());
-        auto s = a_remote_nodename.to_string();
+        std::string s = name;
         auto n = s.find_last_of('/');
         if (n != std::string::npos) s.erase(n);
         this->m_remote_nodename = atom(s);
-        m_uds_filename = a_remote_nodename.to_string();
+        m_uds_filename = name;
         this->start();
     }
 
@@ -31,6 +31,7 @@ limitations under the License.
 #include <eixx/config.h>
 #include <eixx/marshal/defaults.hpp>
 #include <eixx/marshal/eterm.hpp>
+#include <eixx/marshal/eterm_view.hpp>
 
 namespace eixx {
 
@@ -38,12 +39,17 @@ typedef marshal::eterm<allocator_t>                  eterm;
 typedef marshal::atom                                atom;
 typedef marshal::string<allocator_t>                 string;
 typedef marshal::binary<allocator_t>                 binary;
+typedef marshal::binary_slice_scope<allocator_t>     binary_slice_scope;
 typedef marshal::epid<allocator_t>                   epid;
 typedef marshal::port<allocator_t>                   port;
 typedef marshal::ref<allocator_t>                    ref;
 typedef marshal::tuple<allocator_t>                  tuple;
 typedef marshal::list<allocator_t>                   list;
+typedef marshal::list_view<allocator_t>              list_view;
 typedef marshal::trace<allocator_t>                  trace;
+typedef marshal::map<allocator_t>                    map;
+typedef marshal::eterm_view<allocator_t>             eterm_view;
+template <typename T> using packed_list = marshal::packed_list<T, allocator_t>;
 typedef marshal::var                                 var;
 typedef marshal::varbind<allocator_t>                varbind;
 typedef marshal::eterm_pattern_matcher<allocator_t>  eterm_pattern_matcher;
@@ -60,6 +66,7 @@ namespace detail {
     BOOST_STATIC_ASSERT(sizeof(tuple)     <= sizeof(uint64_t));
     BOOST_STATIC_ASSERT(sizeof(list)      <= sizeof(uint64_t));
     BOOST_STATIC_ASSERT(sizeof(trace)     <= sizeof(uint64_t));
+    BOOST_STATIC_ASSERT(sizeof(map)       <= sizeof(uint64_t));
     BOOST_STATIC_ASSERT(sizeof(var)       == sizeof(uint64_t));
 } // namespace detail
 
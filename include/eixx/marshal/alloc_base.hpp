@@ -29,10 +29,14 @@ limitations under the License.
 #define _EIXX_ETERM_BASE_HPP_
 
 #include <boost/noncopyable.hpp>
+#include <boost/predef/other/endian.h>
 #include <eixx/marshal/defaults.hpp>
 #include <eixx/util/common.hpp>
+#include <eixx/util/hashtable.hpp>
+#include <atomic>
 #include <iostream>
 #include <memory>
+#include <string.h>
 
 namespace eixx {
 namespace marshal {
@@ -72,35 +76,116 @@ namespace marshal {
         get_allocator() const { return allocator_type(get_t_allocator()); }
     };
 
+    /// \brief Reference counting policy of blobs allocated with \a Alloc.
+    ///
+    /// By default blobs use an atomic counter, so that terms can be shared
+    /// between threads. Specialize this template for allocators that are
+    /// only ever used from a single thread (see alloc_pool_st.hpp) to make
+    /// reference counting use plain increments and decrements.
+    template <typename Alloc>
+    struct refcount_traits {
+        typedef atomic<int> counter_type;
+    };
+
+    /// \brief Reference count shared by all blob instantiations of \a Alloc.
+    ///
+    /// The counter lives in a base class located at the start of every blob,
+    /// so that eterm can adjust the reference count of any compound value
+    /// directly without dispatching on the value's type.
+    template <typename Alloc>
+    class blob_base : private boost::noncopyable {
+    protected:
+        typename refcount_traits<Alloc>::counter_type m_rc;
+        /// Hash value of the blob's content or 0 if it wasn't computed.
+        /// It is cached only for content that can't change behind the
+        /// blob's back (see is_mutable_type()), so a racing
+        /// store can only write the same value.
+        mutable std::atomic<uint32_t> m_hash;
+
+        /// Reference count value of a blob that is never freed.
+        enum { s_immortal = -1 };
+
+        blob_base() : m_rc(1), m_hash(0) {}
+    public:
+        /// Increment internal reference count.
+        void inc_rc()           { if (!immortal()) ++m_rc; }
+        /// Decrement internal reference count.
+        /// @return true if the count reached 0 and the storage must be freed.
+        bool dec_rc()           { return !immortal() && --m_rc == 0; }
+        /// Return internal reference count. Use for debugging only.
+        int  use_count() const  { return m_rc; }
+
+        /// Make the blob immortal. Its reference count is no longer
+        /// modified and the blob is never freed. This must be done before
+        /// the blob is shared with other threads.
+        void freeze()           { m_rc = s_immortal; }
+        /// Returns true if the blob was frozen.
+        bool immortal() const   { return m_rc == s_immortal; }
+
+        /// Cached hash value of the content or 0 if it is not known.
+        uint32_t cached_hash() const {
+            return m_hash.load(std::memory_order_relaxed);
+        }
+        /// Cache the hash value \a h (must not be 0) of the content.
+        void cache_hash(uint32_t h) const {
+            BOOST_ASSERT(h != 0);
+            m_hash.store(h, std::memory_order_relaxed);
+        }
+        /// Forget the cached hash value after the content was modified.
+        void reset_hash() {
+            if (cached_hash())
+                m_hash.store(0, std::memory_order_relaxed);
+        }
+
+        /// Returns true if the hash values of both blobs are known and
+        /// differ, in which case their contents can't be equal.
+        static bool hash_mismatch(const blob_base* a, const blob_base* b) {
+            if (!a || !b) return false;
+            uint32_t h1 = a->cached_hash(), h2 = b->cached_hash();
+            return h1 && h2 && h1 != h2;
+        }
+    };
+
+    namespace detail {
+        /// Hash values cached in blobs are never 0, which marks unknown hash.
+        inline uint32_t nonzero_hash(uint32_t h) { return h ? h : 1; }
+    }
+
     /// \brief Reference-counted blob of memory to store the object of type T.
+    ///
+    /// The header and the array of items live in a single allocation
+    /// obtained from \a Alloc, with the items trailing the header.
+    /// Blobs are created with create() and destroyed with release()/free().
     template<typename T, typename Alloc>
-    class blob : private boost::noncopyable
-               , public Alloc::template rebind<T>::other
+    class blob : public blob_base<Alloc>
+               , public Alloc::template rebind<uint64_t>::other
     {
-        typedef typename Alloc::template rebind<T>::other base_t;
-        typedef typename Alloc::template rebind<blob<T,Alloc> >::other blob_alloc_t;
+        typedef typename Alloc::template rebind<uint64_t>::other base_t;
 
-        atomic<int>  m_rc;
         const size_t m_size;
-        T*           m_data;
 
-        ~blob() {
-            if (m_data)
-                this->deallocate(m_data, m_size);
-        }
+        blob(size_t n, const Alloc& a) : base_t(a), m_size(n) {}
+        ~blob() {}
 
-        /// This is needed in order to allow blobs to be hosted inside
-        /// std::unique_ptr:
-        template <typename U> friend struct std::default_delete;
-    public:
-        blob(const Alloc& a = Alloc())
-            : base_t(a), m_rc(1), m_size(0), m_data(NULL)
-        {}
+        /// Number of uint64_t words taken by the header. The items start
+        /// at the next word boundary.
+        static const size_t s_header_words =
+            (sizeof(blob) + sizeof(uint64_t)-1) / sizeof(uint64_t);
 
-        /// Allocate storage for \a n items if size sizeof(T).
-        blob(size_t n, const Alloc& a = Alloc())
-            : base_t(a), m_rc(1), m_size(n), m_data(this->allocate(n)) {
-            BOOST_ASSERT(m_data != NULL);
+        /// Number of uint64_t words needed to hold a blob with \a n items.
+        static size_t words(size_t n) {
+            return s_header_words + (n*sizeof(T) + sizeof(uint64_t)-1) / sizeof(uint64_t);
+        }
+    public:
+        /// Allocate a blob with storage for \a n items of size sizeof(T).
+        static blob* create(size_t n, const Alloc& a = Alloc()) {
+            BOOST_STATIC_ASSERT(alignof(T) <= alignof(uint64_t));
+            base_t alloc(a);
+            void* p = alloc.allocate(words(n));
+            BOOST_ASSERT(p != NULL);
+            blob* b = new (p) blob(n, a);
+            BOOST_ASSERT((void*)static_cast<blob_base<Alloc>*>(b) == (void*)b);
+            return b;
         }
 
         /// Decrement reference count and release internal storage 
@@ -109,50 +194,236 @@ namespace marshal {
         /// @return true is object was deleted or was supposed to be deleted
         ///         and \a immediate argument was <tt>false</tt>.
         bool release(bool immediate = true) {
-            bool destroy = --m_rc == 0;
+            bool destroy = this->dec_rc();
             if (destroy && immediate)
-                delete this;
+                free();
             return destroy;
         }
 
         /// Destructs the object.  This method is to be invoked by caller
         /// after a preceding call to release(false) returned true.
         void free() {
-            BOOST_ASSERT(m_rc == 0);
-            delete this;
+            BOOST_ASSERT(this->m_rc == 0);
+            base_t alloc(*this);
+            size_t n = words(m_size);
+            this->~blob();
+            alloc.deallocate(reinterpret_cast<uint64_t*>(this), n);
         }
 
         /// Pointer to allocated array of items.
-        T*     data()       const   { return m_data; }
+        T* data() const {
+            return reinterpret_cast<T*>(
+                reinterpret_cast<uint64_t*>(const_cast<blob*>(this)) + s_header_words);
+        }
         /// Number of items that data() points to.
         size_t size()       const   { return m_size; }
 
-        /// Increment internal reference count.
-        void   inc_rc()             { ++m_rc; }
-        /// Return internal reference count. Use for debugging only.
-        int    use_count()  const   { return m_rc; }
+        Alloc get_allocator() const {
+            return Alloc(*static_cast<const base_t*>(this));
+        }
+    };
+
+    /// \brief Reference to a range of bytes owned by another blob.
+    /// It is the item of a blob that holds a reference to \a parent.
+    template <typename Alloc>
+    struct char_slice {
+        blob<char, Alloc>*  parent;
+        const char*         data;
+        size_t              size;
+    };
+
+    /// \brief Character storage that is either a reference-counted blob,
+    /// a slice of another blob's bytes, or, for payloads of up to capacity
+    /// bytes, the payload itself.
+    ///
+    /// Blobs are aligned, so the two lowest bits of a blob pointer are clear.
+    /// When the lowest bit is set, the byte holding it stores
+    /// <tt>(size << 1) | 1</tt> and the remaining bytes of the pointer's
+    /// 8-byte slot store the payload, so that short strings and binaries need
+    /// neither an allocation nor reference counting. When the second bit is
+    /// set, the pointer refers to a blob holding a char_slice, which keeps
+    /// the parent blob alive while the slice is referenced.
+    template <typename Alloc>
+    class char_blob {
+        typedef blob<char, Alloc>               blob_t;
+        typedef blob<char_slice<Alloc>, Alloc>  slice_t;
+
+        #if BOOST_ENDIAN_BIG_BYTE
+        enum { TAG = sizeof(void*)-1, DATA = 0 };
+        #else
+        enum { TAG = 0, DATA = 1 };
+        #endif
+
+        enum { SLICE = 2, TAG_MASK = 3 };
+
+        union {
+            blob_t*   m_ptr;
+            uintptr_t m_word;
+            uint8_t   m_bytes[sizeof(uint64_t)];
+        };
+
+        void set_inline(size_t n) {
+            memset(m_bytes, 0, sizeof(m_bytes));
+            m_bytes[TAG] = uint8_t(n << 1 | 1);
+        }
+
+        slice_t* slice_ptr() const {
+            return reinterpret_cast<slice_t*>(m_word & ~uintptr_t(TAG_MASK));
+        }
+        const char_slice<Alloc>& sliced() const { return *slice_ptr()->data(); }
+    public:
+        /// Maximum size of a payload stored inline.
+        static const size_t capacity =
+            (TAG == 0 || TAG == sizeof(uint64_t)-1) ? sizeof(uint64_t)-1 : 0;
+
+        char_blob() : m_ptr(nullptr) {}
+
+        /// Allocate storage for \a n characters.
+        explicit char_blob(size_t n, const Alloc& a = Alloc()) {
+            if (n <= capacity)
+                set_inline(n);
+            else
+                m_ptr = blob_t::create(n, a);
+        }
+
+        /// Allocate storage for \a n characters and copy them from \a p.
+        /// The copy is done separately for either storage, so the compiler
+        /// knows that at most capacity bytes are copied inline.
+        char_blob(const char* p, size_t n, const Alloc& a = Alloc()) {
+            if (n <= capacity) {
+                set_inline(n);
+                memcpy(m_bytes + DATA, p, n);
+            } else {
+                m_ptr = blob_t::create(n, a);
+                memcpy(m_ptr->data(), p, n);
+            }
+        }
+
+        char_blob(const char_blob& rhs) : m_ptr(rhs.m_ptr) { inc_rc(); }
+        char_blob(char_blob&& rhs)      : m_ptr(rhs.m_ptr) { rhs.reset(); }
+
+        char_blob& operator= (const char_blob& rhs) {
+            if (this != &rhs) {
+                release();
+                m_ptr = rhs.m_ptr;
+                inc_rc();
+            }
+            return *this;
+        }
+
+        char_blob& operator= (char_blob&& rhs) {
+            if (this != &rhs) {
+                release();
+                m_ptr = rhs.m_ptr;
+                rhs.reset();
+            }
+            return *this;
+        }
+
+        /// Storage holding \a n bytes at \a offset of this payload.
+        /// Payloads that fit inline are copied, otherwise the result
+        /// references the blob that owns the bytes.
+        char_blob slice(size_t offset, size_t n) const {
+            BOOST_ASSERT(offset + n <= size());
+            const char* p = data() + offset;
+            if (n <= capacity)
+                return char_blob(p, n);
+            char_blob r;
+            blob_t* parent = is_slice() ? sliced().parent : m_ptr;
+            slice_t* s = slice_t::create(1, parent->get_allocator());
+            new (s->data()) char_slice<Alloc>{parent, p, n};
+            parent->inc_rc();
+            r.m_word = reinterpret_cast<uintptr_t>(s) | SLICE;
+            return r;
+        }
+
+        /// True if the payload is stored inline.
+        bool    is_inline() const { return m_bytes[TAG] & 1; }
+        /// True if the payload is a slice of another blob.
+        bool    is_slice()  const { return (m_word & TAG_MASK) == SLICE; }
+        /// True if no storage is attached.
+        bool    null()      const { return m_ptr == nullptr; }
+        /// Blob shared with other owners or NULL if there is no such blob.
+        blob_base<Alloc>* shared() const {
+            return is_inline() ? nullptr
+                 : is_slice()  ? static_cast<blob_base<Alloc>*>(slice_ptr())
+                 :               static_cast<blob_base<Alloc>*>(m_ptr);
+        }
+        /// Blob owning the payload's bytes or NULL if they are stored inline.
+        const blob_base<Alloc>* owner() const {
+            return is_slice() ? sliced().parent : shared();
+        }
+
+        char*   data() {
+            return is_inline() ? reinterpret_cast<char*>(m_bytes + DATA)
+                 : is_slice()  ? const_cast<char*>(sliced().data)
+                 : m_ptr       ? m_ptr->data() : nullptr;
+        }
+        const char* data() const { return const_cast<char_blob*>(this)->data(); }
+
+        size_t  size() const {
+            return is_inline() ? m_bytes[TAG] >> 1
+                 : is_slice()  ? sliced().size
+                 : m_ptr       ? m_ptr->size() : 0;
+        }
+
+        void inc_rc() { if (blob_base<Alloc>* p = shared()) p->inc_rc(); }
+
+        /// Release the shared blob (if any) and detach the storage.
+        void release() {
+            blob_base<Alloc>* p = shared();
+            if (p && p->dec_rc())
+                free_shared();
+            m_ptr = nullptr;
+        }
+
+        /// Free the shared blob after its reference count dropped to 0.
+        void free_shared() {
+            if (is_slice()) {
+                slice_t* s = slice_ptr();
+                s->data()->parent->release();
+                s->free();
+            } else
+                m_ptr->free();
+        }
+
+        /// Detach the storage without releasing it (used when moving).
+        void reset() { m_ptr = nullptr; }
+
+        /// Hash value of the first \a n bytes of the payload computed by
+        /// \a a_fun. It is cached in the shared blob, so \a n and \a a_fun
+        /// must be the same for all callers.
+        uint32_t hash(size_t n, uint32_t (*a_fun)(const char*, size_t)
+                                    = &eixx::detail::hsieh_hash_fun::hash) const {
+            blob_base<Alloc>* p = shared();
+            if (p)
+                if (uint32_t h = p->cached_hash())
+                    return h;
+            uint32_t h = detail::nonzero_hash(a_fun(data(), n));
+            if (p)
+                p->cache_hash(h);
+            return h;
+        }
 
-        const Alloc& get_allocator() const {
-            return *reinterpret_cast<const Alloc*>(this);
+        /// Returns true if \a rhs is known to hold a different payload
+        /// without looking at it.
+        bool hash_mismatch(const char_blob& rhs) const {
+            return blob_base<Alloc>::hash_mismatch(shared(), rhs.shared());
         }
 
-        static blob_alloc_t& get_blob_alloc() {
-            static blob_alloc_t s_alloc;
-            return s_alloc;
+        /// Returns true if both refer to the same shared blob.
+        bool same(const char_blob& rhs) const {
+            return shared() && m_ptr == rhs.m_ptr;
         }
 
-        /// This method overrides the new() operator for this class
-        /// so that the blob memory is taken from the Alloc allocator.
-        static void* operator new(size_t sz) {
-            BOOST_ASSERT(sz == sizeof(blob<T,Alloc>));
-            return get_blob_alloc().allocate(1);
+        int use_count() const {
+            blob_base<Alloc>* p = shared();
+            return is_inline() ? 1 : p ? p->use_count() : 0;
         }
 
-        /// This method overrides the new() operator for this class
-        /// so that the blob memory is released to the Alloc allocator.
-        static void operator delete(void* p, size_t sz) {
-            BOOST_ASSERT(sz == sizeof(blob<T,Alloc>));
-            get_blob_alloc().deallocate(static_cast<blob<T,Alloc>*>(p), 1);
+        Alloc get_allocator() const {
+            return is_inline() || !m_ptr ? Alloc()
+                 : is_slice() ? slice_ptr()->get_allocator() : m_ptr->get_allocator();
         }
     };
 
@@ -33,31 +33,34 @@ limitations under the License.
 namespace eixx {
 
     using marshal::atom;
+    using marshal::operator"" _atom;
+    namespace am = marshal::am;
 
-    // Constant global atom values
-
-    const atom am_ANY_ = atom("_");
-    extern const atom am_badarg;
-    extern const atom am_badrpc;
-    extern const atom am_call;
-    extern const atom am_cast;
-    extern const atom am_erlang;
-    extern const atom am_error;
-    extern const atom am_false;
-    extern const atom am_format;
-    extern const atom am_gen_cast;
-    extern const atom am_io_lib;
-    extern const atom am_latin1;
-    extern const atom am_noconnection;
-    extern const atom am_noproc;
-    extern const atom am_normal;
-    extern const atom am_ok;
-    extern const atom am_request;
-    extern const atom am_rex;
-    extern const atom am_rpc;
-    extern const atom am_true;
-    extern const atom am_undefined;
-    extern const atom am_unsupported;
-    extern const atom am_user;
+    // Constant global atom values. They are well-known atoms (see
+    // am::known), so they are compile-time constants.
+
+    constexpr atom am_ANY_          = "_"_atom;
+    constexpr atom am_badarg        = "badarg"_atom;
+    constexpr atom am_badrpc        = "badrpc"_atom;
+    constexpr atom am_call          = "call"_atom;
+    constexpr atom am_cast          = "cast"_atom;
+    constexpr atom am_erlang        = "erlang"_atom;
+    constexpr atom am_error         = "error"_atom;
+    constexpr atom am_false         = "false"_atom;
+    constexpr atom am_format        = "format"_atom;
+    constexpr atom am_gen_cast      = "$gen_cast"_atom;
+    constexpr atom am_io_lib        = "io_lib"_atom;
+    constexpr atom am_latin1        = "latin1"_atom;
+    constexpr atom am_noconnection  = "noconnection"_atom;
+    constexpr atom am_noproc        = "noproc"_atom;
+    constexpr atom am_normal        = "normal"_atom;
+    constexpr atom am_ok            = "ok"_atom;
+    constexpr atom am_request       = "request"_atom;
+    constexpr atom am_rex           = "rex"_atom;
+    constexpr atom am_rpc           = "rpc"_atom;
+    constexpr atom am_true          = "true"_atom;
+    constexpr atom am_undefined     = "undefined"_atom;
+    constexpr atom am_unsupported   = "unsupported"_atom;
+    constexpr atom am_user          = "user"_atom;
 
 } // namespace eixx
@@ -30,14 +30,17 @@ limitations under the License.
 #define _EIXX_ATOM_HPP_
 
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <boost/assert.hpp>
+#include <boost/utility/string_ref.hpp>
 #include <eixx/marshal/defaults.hpp>
 #include <eixx/marshal/endian.hpp>
 #include <eixx/marshal/string.hpp>
 #include <eixx/eterm_exception.hpp>
 #include <eixx/util/hashtable.hpp>
 #include <eixx/util/atom_table.hpp>
+#include <eixx/util/string_util.hpp>
 #include <ei.h>
 
 namespace eixx {
@@ -58,18 +61,232 @@ namespace detail {
 
 } // namespace detail
 
+/// Well-known atoms given as X(Id, Name), which are added to the atom
+/// table at fixed indices in the listed order when the table is created.
+/// New atoms must be appended to the end of the list.
+#define EIXX_WELL_KNOWN_ATOMS(X)        \
+    X(ANY_,         "_")                \
+    X(badarg,       "badarg")           \
+    X(badrpc,       "badrpc")           \
+    X(call,         "call")             \
+    X(cast,         "cast")             \
+    X(erlang,       "erlang")           \
+    X(error,        "error")            \
+    X(false_,       "false")            \
+    X(format,       "format")           \
+    X(gen_cast,     "$gen_cast")        \
+    X(io_lib,       "io_lib")           \
+    X(latin1,       "latin1")           \
+    X(noconnection, "noconnection")     \
+    X(noproc,       "noproc")           \
+    X(normal,       "normal")           \
+    X(ok,           "ok")               \
+    X(request,      "request")          \
+    X(rex,          "rex")              \
+    X(rpc,          "rpc")              \
+    X(true_,        "true")             \
+    X(undefined,    "undefined")        \
+    X(unsupported,  "unsupported")      \
+    X(user,         "user")             \
+    X(gen_call,     "$gen_call")        \
+    X(EXIT,         "EXIT")             \
+    X(infinity,     "infinity")         \
+    X(timeout,      "timeout")
+
+namespace am {
+
+    /// Indices of the well-known atoms in the atom table. They are
+    /// compile-time constants, so that atoms can be dispatched on with
+    /// a \c switch on atom::index():
+    /// \code
+    ///   switch (a.index()) {
+    ///     case am::ok:    ...
+    ///     case am::error: ...
+    ///   }
+    /// \endcode
+    enum known : int {
+        null_ = 0,
+        #define EIXX_AM_INDEX(Id, Name) Id,
+        EIXX_WELL_KNOWN_ATOMS(EIXX_AM_INDEX)
+        #undef  EIXX_AM_INDEX
+        count_
+    };
+
+} // namespace am
+
+namespace detail {
+
+    template <typename T = void>
+    struct known_atoms {
+        /// Names of the well-known atoms indexed by am::known.
+        static constexpr const char* s_names[] = {
+            "",
+            #define EIXX_AM_NAME(Id, Name) Name,
+            EIXX_WELL_KNOWN_ATOMS(EIXX_AM_NAME)
+            #undef  EIXX_AM_NAME
+        };
+
+        static constexpr bool equal(const char* a, const char* s, size_t n) {
+            for (size_t i=0; i < n; i++)
+                if (a[i] != s[i])
+                    return false;
+            return a[n] == '\0';
+        }
+
+        /// Index of the well-known atom \a s of \a n bytes or 0 if it's
+        /// not one of them.
+        static constexpr int find(const char* s, size_t n) {
+            for (int i=1; i < am::count_; i++)
+                if (equal(s_names[i], s, n))
+                    return i;
+            return 0;
+        }
+    };
+
+    template <typename T>
+    constexpr const char* known_atoms<T>::s_names[];
+
+    /// Name of the atom literal made of characters \a Cs. Its hash value
+    /// and the index of a well-known atom are computed at compile time.
+    template <char... Cs>
+    struct atom_literal {
+        static constexpr size_t   s_size  = sizeof...(Cs);
+        static constexpr char     s_name[]= {Cs..., '\0'};
+        static constexpr uint32_t s_hash  = eixx::detail::hsieh_hash_fun::hash(s_name, s_size);
+        static constexpr int      s_known = known_atoms<>::find(s_name, s_size);
+
+        /// Index of the atom, which is looked up in the atom table once.
+        static int index();
+    };
+
+    template <char... Cs>
+    constexpr char atom_literal<Cs...>::s_name[];
+
+} // namespace detail
+
+class atom;
+template <typename C, C... Cs>
+constexpr atom operator"" _atom();
+
+#ifndef ERL_ATOM_CACHE_REF
+#define ERL_ATOM_CACHE_REF 82
+#endif
+
+class atom_cache_out;
+class atom_decode_cache;
+
+/**
+ * Name of an atom returned by atom::to_string(). It references the
+ * name stored in the atom table instead of copying it, and converts
+ * to std::string implicitly.
+ */
+class atom_name : public boost::string_ref {
+public:
+    atom_name(const char* s, size_t n) : boost::string_ref(s, n) {}
+
+    operator std::string() const { return std::string(data(), size()); }
+};
+
+/**
+ * Atom cache references (ATOM_CACHE_REF) of a distribution header used
+ * by the current thread while it decodes or encodes the terms of a
+ * message. While decoding, the i-th reference resolves to the i-th atom
+ * of the header, and other atoms are looked up in the connection's
+ * atom_decode_cache if it's given. While encoding, atoms are assigned
+ * references by the connection's atom_cache_out, and the other ones are
+ * encoded with the UTF-8 atom tags if the peer supports them. Scopes may
+ * be nested, in which case only the innermost one is used.
+ */
+class atom_cache_scope {
+    const atom*         m_refs;
+    size_t              m_count;
+    atom_cache_out*     m_out;
+    atom_decode_cache*  m_lookup;
+    bool                m_utf8;
+    atom_cache_scope*   m_prev;
+
+    static atom_cache_scope*& current() {
+        static thread_local atom_cache_scope* s_current = nullptr;
+        return s_current;
+    }
+public:
+    /// Scope decoding reference i as \a a_refs[i], where i < \a n,
+    /// and looking up other atoms in \a a_lookup unless it's NULL.
+    atom_cache_scope(const atom* a_refs, size_t n, atom_decode_cache* a_lookup = nullptr)
+        : m_refs(a_refs), m_count(n), m_out(nullptr), m_lookup(a_lookup)
+        , m_utf8(false), m_prev(current())
+    {
+        current() = this;
+    }
+
+    /// Scope decoding atoms by looking them up in \a a_lookup.
+    explicit atom_cache_scope(atom_decode_cache& a_lookup)
+        : atom_cache_scope(nullptr, 0, &a_lookup)
+    {}
+
+    /// Scope encoding atoms as references assigned by \a a_out unless
+    /// it's NULL. Other atoms are encoded as SMALL_ATOM_UTF8_EXT or
+    /// ATOM_UTF8_EXT if \a a_utf8 is true, and as ATOM_EXT otherwise.
+    explicit atom_cache_scope(atom_cache_out* a_out, bool a_utf8 = false)
+        : m_refs(nullptr), m_count(0), m_out(a_out), m_lookup(nullptr)
+        , m_utf8(a_utf8), m_prev(current())
+    {
+        current() = this;
+    }
+
+    ~atom_cache_scope() { current() = m_prev; }
+
+    /// Atom of the reference \a i decoded at offset \a idx.
+    /// @throws err_decode_exception if the innermost scope has no such reference.
+    static atom decode(uint8_t i, int idx);
+
+    /// Index of the atom named by \a len bytes at \a s, which is
+    /// received from a remote node in UTF-8 if \a a_utf8 is true or in
+    /// Latin-1 otherwise (see atom_decode_cache::lookup()).
+    static int lookup(const char* s, size_t len, bool a_utf8, bool a_transient);
+
+    /// Reference number of the atom \a a in the encoded message.
+    /// @param a_utf8 is set if the atom is to be encoded with a UTF-8 tag.
+    /// @return -1 if the atom is to be encoded by value.
+    static int encode(const atom& a, bool& a_utf8);
+};
+
 /**
  * Provides a representation of Erlang atoms. Atoms can be
- * created from strings whose length is not more than
- * MAXATOMLEN characters.
+ * created from UTF-8 strings whose length is not more than
+ * MAXATOMLEN-1 characters.
  */
 class atom
 {
     int m_index;
 
+    /// Length of the encoded name \a n, which is in Latin-1 unless
+    /// \a a_utf8 is true or it can't be converted, in which case
+    /// \a a_utf8 is set.
+    static size_t encoded_length(const util::atom_table::name_t& n, bool& a_utf8) {
+        if (!a_utf8) {
+            size_t len = utf8_latin1_size(n.name, n.len);
+            if (len != (size_t)-1)
+                return len;
+            a_utf8 = true;
+        }
+        return n.len;
+    }
+
+    constexpr explicit atom(int a_index) : m_index(a_index) {}
+
+    template <typename C, C... Cs>
+    friend constexpr atom operator"" _atom();
+    friend class atom_cache_in;
+
 public:
+    /// The atom table, which is created with the well-known atoms
+    /// at their am::known indices. Its transient tier is enabled by the
+    /// EI_TRANSIENT_ATOM_TABLE_SIZE environment variable.
     inline static util::atom_table& atom_table() {
-       static util::atom_table s_atom_table;
+       static util::atom_table s_atom_table(util::atom_table::default_size(),
+            detail::known_atoms<>::s_names + 1, am::count_ - 1,
+            util::atom_table::default_transient_size());
        return s_atom_table;
     }
 
@@ -80,68 +297,121 @@ public:
     }
 
     /// Create an empty atom
-    atom() : m_index(0) {
+    constexpr atom() : m_index(0) {
         BOOST_STATIC_ASSERT(sizeof(atom) == 4);
     }
 
     /// Create an atom from the given string.
     /// @param atom the string to create the atom from.
     /// @throws std::runtime_error if atom table is full.
-    /// @throws err_bad_argument if atom size is longer than MAXATOMLEN
+    /// @throws err_bad_argument if atom is longer than MAXATOMLEN-1 characters
     atom(const char* s) throw(std::runtime_error, err_bad_argument)
-        : m_index(atom_table().lookup(std::string(s))) {}
+        : m_index(atom_table().lookup(s)) {}
 
-    /// @copydoc atom::atom
+    /// Create an atom from a character array holding a name of up to
+    /// \a N characters, which is terminated by NUL if it's shorter.
     template <int N>
     atom(const char (&s)[N]) throw(std::runtime_error, err_bad_argument)
-        : m_index(atom_table().lookup(std::string(s, N))) {}
+        : m_index(atom_table().lookup(s, strnlen(s, N))) {}
 
     /// @copydoc atom::atom
-    explicit atom(const std::string& s) throw(std::runtime_error)
+    explicit atom(const std::string& s) throw(std::runtime_error, err_bad_argument)
         : m_index(atom_table().lookup(s))
     {}
 
     /// @copydoc atom::atom
     template<typename Alloc>
-    explicit atom(const string<Alloc>& s) throw(std::runtime_error)
-        : m_index(atom_table().lookup(std::string(s.c_str(), s.size())))
+    explicit atom(const string<Alloc>& s) throw(std::runtime_error, err_bad_argument)
+        : m_index(atom_table().lookup(s.c_str(), s.size()))
     {}
 
     /// @copydoc atom::atom
-    atom(const char* s, size_t n) throw(std::runtime_error)
-        : m_index(atom_table().lookup(std::string(s, n)))
+    atom(const char* s, size_t n) throw(std::runtime_error, err_bad_argument)
+        : m_index(atom_table().lookup(s, n))
     {}
 
+    /// Index of the atom named by \a len bytes at \a s, which is decoded
+    /// from a term in UTF-8 if \a a_utf8 is true or in Latin-1 otherwise,
+    /// in which case it's converted to UTF-8.
+    /// The atom is looked up with util::basic_atom_table::lookup_transient()
+    /// if \a a_transient is true, which sets \a a_gen unless it's NULL,
+    /// or with lookup() otherwise.
+    /// @throws err_bad_argument if atom is longer than MAXATOMLEN-1 characters
+    static int lookup(const char* s, size_t len, bool a_utf8, bool a_transient,
+                      uint32_t* a_gen = nullptr)
+        throw(std::runtime_error, err_bad_argument)
+    {
+        char buf[2*(MAXATOMLEN-1)];
+        if (!a_utf8 && !is_ascii(s, len)) {
+            if (len > MAXATOMLEN-1)
+                throw err_bad_argument("Atom size is too long!");
+            len = latin1_to_utf8(s, len, buf);
+            s   = buf;
+        }
+        return a_transient ? atom_table().lookup_transient(s, len, a_gen)
+                           : atom_table().lookup(s, len);
+    }
+
     /// Copy atom from another atom.  This is a constant time 
     /// SMP safe operation.
-    atom(const atom& s) throw() : m_index(s.m_index) {}
+    constexpr atom(const atom& s) throw() : m_index(s.m_index) {}
 
     /// Decode an atom from a binary buffer encoded in 
-    /// Erlang external binary format.
-    atom(const char* a_buf, int& idx, size_t a_size)
+    /// Erlang external binary format. The name of an atom with a Latin-1
+    /// tag is converted to UTF-8. Unless \a a_transient is false,
+    /// an atom that isn't in the atom table is added to its transient
+    /// tier if it's enabled (see util::basic_atom_table::lookup_transient()).
+    /// An ATOM_CACHE_REF is resolved by the current atom_cache_scope.
+    ///
+    /// The node atoms of pids, ports and refs are decoded with
+    /// \a a_transient false on purpose: these terms store their node atom
+    /// without referencing it (see util::basic_atom_table::acquire()), so
+    /// it must not be evicted, and a node only sees a few node names. A
+    /// transient atom received as a cache reference is then pinned.
+    atom(const char* a_buf, int& idx, size_t a_size, bool a_transient = true)
         throw (err_decode_exception, std::runtime_error)
     {
         const char *s = a_buf + idx;
         const char *s0 = s;
-        int len;
+        int  len;
+        bool utf8 = false;
         switch (get8(s)) {
-            case ERL_ATOM_EXT:       len = get16be(s);  break;
-            case ERL_SMALL_ATOM_EXT: len = get8(s);     break;
+            case ERL_ATOM_EXT:              len = get16be(s);               break;
+            case ERL_ATOM_UTF8_EXT:         len = get16be(s); utf8 = true;  break;
+            case ERL_SMALL_ATOM_EXT:        len = get8(s);                  break;
+            case ERL_SMALL_ATOM_UTF8_EXT:   len = get8(s);    utf8 = true;  break;
+            case ERL_ATOM_CACHE_REF:
+                *this = atom_cache_scope::decode(get8(s), idx);
+                idx  += 2;
+                if (!a_transient && m_index < 0)
+                    m_index = atom_table().lookup(c_str(), size());
+                return;
             default: throw err_decode_exception("Error decoding atom", idx);
         }
-        m_index = atom_table().lookup(std::string(s, len));
+        if ((size_t)(s + len - a_buf) > a_size)
+            throw err_decode_exception("Truncated atom", idx);
+        try {
+            m_index = atom_cache_scope::lookup(s, len, utf8, a_transient);
+        } catch (err_bad_argument&) {
+            throw err_decode_exception("Atom is too long", idx);
+        }
         idx += s + len - s0;
         BOOST_ASSERT((size_t)idx <= a_size);
     }
 
-    const char*         c_str()     const { return atom_table()[m_index].c_str();  }
-    const std::string&  to_string() const { return atom_table()[m_index];          }
-    size_t              size()      const { return atom_table()[m_index].size();   }
+    const char*         c_str()     const { return atom_table()[m_index];          }
+    atom_name           to_string() const {
+        util::atom_table::name_t n = atom_table().name(m_index);
+        return atom_name(n.name, n.len);
+    }
+    size_t              size()      const { return atom_table().length(m_index);   }
     size_t              length()    const { return size();                         }
     bool                empty()     const { return m_index == 0;                   }
 
     /// Get atom's index in the atom table.
-    int             index()     const { return m_index; }
+    constexpr int   index()     const { return m_index; }
+    /// Hash value of the atom (atoms are unique, so it's their index).
+    uint32_t        hash()      const { return m_index; }
 
     void operator=  (const atom& s)               { m_index = s.m_index; }
     void operator=  (const std::string& s)        { m_index = atom_table().lookup(s); }
@@ -161,20 +431,50 @@ public:
 
     /// Get the size of a buffer needed to encode this atom in 
     /// the external binary format.
-    size_t encode_size() const { return 3 + length(); }
+    size_t encode_size() const {
+        bool utf8;
+        if (atom_cache_scope::encode(*this, utf8) >= 0)
+            return 2;
+        const size_t len = encoded_length(atom_table().name(m_index), utf8);
+        return (utf8 && len < 256 ? 2 : 3) + len;
+    }
 
-    /// Encode the atom in external binary format.
+    /// Encode the atom in external binary format. In the scope of a
+    /// connection to a peer that supports UTF-8 atoms (see atom_cache_scope)
+    /// the atom is encoded as SMALL_ATOM_UTF8_EXT if it's shorter than 256
+    /// bytes or as ATOM_UTF8_EXT, and as ATOM_EXT in Latin-1 otherwise.
+    /// An atom that has characters beyond Latin-1 is always encoded in UTF-8.
     /// @param buf is the buffer space to encode the atom to.
     /// @param idx is the offset in the \a buf where to begin writing.
     /// @param size is the size of \a buf.
     void encode(char* buf, int& idx, size_t size) const {
         char* s  = buf + idx;
         char* s0 = s;
-        const int len = std::min((size_t)MAXATOMLEN, length());
-        /* This function is documented to truncate at MAXATOMLEN (256) */
-        put8(s,ERL_ATOM_EXT);
-        put16be(s,len);
-        memmove(s,c_str(),len); /* unterminated string */
+        bool utf8;
+        int  ref = atom_cache_scope::encode(*this, utf8);
+        if (ref >= 0) {
+            put8(s,ERL_ATOM_CACHE_REF);
+            put8(s,ref);
+            idx += s-s0;
+            BOOST_ASSERT((size_t)idx <= size);
+            return;
+        }
+        util::atom_table::name_t n = atom_table().name(m_index);
+        const size_t len = encoded_length(n, utf8);
+        if (!utf8) {
+            put8(s,ERL_ATOM_EXT);
+            put16be(s,len);
+        } else if (len < 256) {
+            put8(s,ERL_SMALL_ATOM_UTF8_EXT);
+            put8(s,len);
+        } else {
+            put8(s,ERL_ATOM_UTF8_EXT);
+            put16be(s,len);
+        }
+        if (len == n.len)
+            memmove(s,n.name,len); /* unterminated string */
+        else
+            utf8_to_latin1(n.name, n.len, s);
         s   += len;
         idx += s-s0;
         BOOST_ASSERT((size_t)idx <= size);
@@ -190,6 +490,26 @@ public:
     }
 };
 
+template <char... Cs>
+int detail::atom_literal<Cs...>::index() {
+    static const int s_index = atom::atom_table().lookup(s_name, s_size, s_hash);
+    return s_index;
+}
+
+/// Atom literal, e.g. \c "ok"_atom. Well-known atoms (see am::known) are
+/// compile-time constants, so their literals can be used as \c case labels
+/// in a \c switch on atom::index(). Other names are looked up in the
+/// atom table by the precomputed hash value the first time the literal
+/// is used. The literal is a string literal operator template (a GCC and
+/// Clang extension), so that the name is available at compile time.
+template <typename C, C... Cs>
+constexpr atom operator"" _atom() {
+    static_assert(std::is_same<C, char>::value, "Atom literal must be a narrow string");
+    return atom(detail::atom_literal<Cs...>::s_known
+              ? detail::atom_literal<Cs...>::s_known
+              : detail::atom_literal<Cs...>::index());
+}
+
 /// Create an atom containing node name.
 /// @param s is the string representation of the node name that must be
 ///        in the form: \c Alivename@Hostname.
@@ -216,4 +536,6 @@ namespace std {
 
 }
 
+#include <eixx/marshal/atom_cache.hpp>
+
 #endif
@@ -0,0 +1,449 @@
+//----------------------------------------------------------------------------
+/// \file  atom_cache.hpp
+//----------------------------------------------------------------------------
+/// \brief Atom caches of the distribution header used by connections
+///        that negotiated DFLAG_DIST_HDR_ATOM_CACHE, and the cache of
+///        atoms decoded by a connection.
+//----------------------------------------------------------------------------
+// Copyright (c) 2010 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+Copyright 2010 Serge Aleynikov <saleyn at gmail dot com>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+***** END LICENSE BLOCK *****
+*/
+#ifndef _EIXX_ATOM_CACHE_HPP_
+#define _EIXX_ATOM_CACHE_HPP_
+
+#include <string.h>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <eixx/marshal/atom.hpp>
+
+#ifndef ERL_DIST_HEADER
+#define ERL_DIST_HEADER 'D'
+#endif
+
+namespace eixx {
+namespace marshal {
+
+/**
+ * Atom cache of the messages received from a node. The distribution
+ * header of a message (131, 'D', ...) lists the atoms referenced by the
+ * message's control tuple and payload. Atoms that are new to the cache
+ * are sent with their names and stored in the cache, the other ones are
+ * sent as their positions in the cache.
+ *
+ * The header layout is:
+ * \verbatim
+ *   NumberOfAtomCacheRefs:8, Flags:(NumberOfAtomCacheRefs/2+1)*8,
+ *   AtomCacheRefs...
+ * \endverbatim
+ * The flags hold a half-byte per reference (NewCacheEntryFlag:1,
+ * SegmentIndex:3), the lower one first, followed by a half-byte whose
+ * lowest bit is the LongAtoms flag. A reference consists of the
+ * InternalSegmentIndex byte, which is followed by the atom's length
+ * (two bytes if LongAtoms is set) and name for a new cache entry.
+ */
+class atom_cache_in {
+public:
+    enum {
+        SIZE     = 2048,    ///< Number of entries (8 segments of 256 atoms)
+        MAX_REFS = 255      ///< Maximum number of references in a header
+    };
+
+    /// Atoms referenced by a distribution header. It holds references to
+    /// the transient ones (see util::basic_atom_table::acquire()), so that
+    /// they aren't evicted from the atom table while the message is decoded.
+    class header_refs {
+        atom    m_atoms[MAX_REFS];
+        size_t  m_count;
+
+        header_refs(const header_refs&);
+        void operator=(const header_refs&);
+    public:
+        header_refs() : m_count(0) {}
+        ~header_refs() { clear(); }
+
+        /// Add the atom \a a, whose reference the caller acquired.
+        void push_back(atom a)          { m_atoms[m_count++] = a; }
+        /// Release the atoms' references.
+        void clear() {
+            for (size_t i=0; i < m_count; i++)
+                atom::atom_table().release(m_atoms[i].index());
+            m_count = 0;
+        }
+
+        const atom* data()        const { return m_atoms; }
+        size_t      size()        const { return m_count; }
+    };
+
+private:
+    struct entry {
+        atom        value;
+        bool        valid;
+        uint32_t    gen;    ///< Generation of a transient atom's slot
+        std::string name;   ///< Used to restore an evicted transient atom
+
+        entry() : valid(false), gen(0) {}
+    };
+
+    entry m_entries[SIZE];
+    bool  m_utf8;
+
+    /// Look up the transient atom \a len bytes at \a s in the atom
+    /// table, acquire a reference to it and store it in \a e.
+    void lookup(entry& e, const char* s, size_t len) {
+        util::atom_table& t = atom::atom_table();
+        int n;
+        do n = atom::lookup(s, len, m_utf8, true, &e.gen); while (!t.acquire(n));
+        e.value = atom(n);
+        e.valid = true;
+    }
+
+public:
+    /// The atoms of the header are in UTF-8 if \a a_utf8 is true (i.e.
+    /// DFLAG_UTF8_ATOMS was negotiated) or in Latin-1 otherwise.
+    explicit atom_cache_in(bool a_utf8 = true) : m_utf8(a_utf8) {}
+
+    /// Decode the atom cache references of a distribution header that
+    /// follows the 131, 'D' bytes at \a s. The atoms are stored in
+    /// \a a_refs, which holds them until it's cleared or destroyed,
+    /// and \a s is advanced past the header.
+    /// @return the number of references.
+    /// @throws err_decode_exception if the header is malformed or refers
+    ///         to an empty cache entry.
+    size_t decode_header(const char*& s, const char* end, header_refs& a_refs)
+        throw(err_decode_exception, std::runtime_error)
+    {
+        a_refs.clear();
+        if (s >= end)
+            throw err_decode_exception("Truncated distribution header");
+        size_t n = get8(s);
+        if (n == 0)
+            return 0;
+
+        const uint8_t* flags = (const uint8_t*)s;
+        s += n/2 + 1;
+        if (s > end)
+            throw err_decode_exception("Truncated distribution header flags", n);
+
+        auto nibble = [flags](size_t i) { return (flags[i/2] >> ((i & 1) << 2)) & 0xF; };
+        bool long_atoms = nibble(n) & 1;
+
+        for (size_t i=0; i < n; i++) {
+            int f = nibble(i);
+            if (s >= end)
+                throw err_decode_exception("Truncated atom cache reference", i);
+            entry& e = m_entries[(f & 7) << 8 | (uint8_t)get8(s)];
+            if (f & 8) {
+                if (end - s < (long_atoms ? 2 : 1))
+                    throw err_decode_exception("Truncated atom cache entry", i);
+                size_t len = long_atoms ? get16be(s) : get8(s);
+                if ((size_t)(end - s) < len)
+                    throw err_decode_exception("Truncated atom cache entry", i);
+                try {
+                    lookup(e, s, len);
+                } catch (err_bad_argument&) {
+                    throw err_decode_exception("Atom cache entry is too long", i);
+                }
+                if (e.value.index() < 0)
+                    e.name.assign(s, len);
+                s += len;
+            } else if (!e.valid) {
+                throw err_decode_exception("Reference to an empty atom cache entry", i);
+            } else if (!atom::atom_table().acquire(e.value.index())) {
+                // The cached transient atom was evicted from the atom table
+                lookup(e, e.name.c_str(), e.name.size());
+            } else if (atom::atom_table().generation(e.value.index()) != e.gen) {
+                // ... and its slot was reused as many times as to wrap
+                // the generation stored in the index
+                atom::atom_table().release(e.value.index());
+                lookup(e, e.name.c_str(), e.name.size());
+            }
+            a_refs.push_back(e.value);
+        }
+        return n;
+    }
+};
+
+/**
+ * Atom cache of the messages sent to a node, which mirrors the peer's
+ * atom_cache_in. The atoms of a message are assigned references while
+ * its size is computed in an atom_cache_scope, and the header written
+ * by encode_header() stores the new ones in the cache. Messages must be
+ * encoded one at a time in the order they are sent.
+ */
+class atom_cache_out {
+public:
+    enum {
+        SIZE     = atom_cache_in::SIZE,
+        MAX_REFS = atom_cache_in::MAX_REFS
+    };
+
+private:
+    int         m_entries[SIZE];    ///< Cached atom indices (0 is empty)
+    uint32_t    m_msg[SIZE];        ///< Message that last referenced an entry
+    uint8_t     m_ref[SIZE];        ///< Reference of the entry in that message
+    uint16_t    m_slots[MAX_REFS];  ///< Entries referenced by the message
+    int         m_atoms[MAX_REFS];  ///< Atoms referenced by the message
+    uint32_t    m_msg_no;
+    size_t      m_count;
+    bool        m_utf8;
+
+    static size_t slot(int a_index) { return ((uint32_t)a_index * 2654435761u) >> 21; }
+
+    bool is_new(size_t i) const { return m_entries[m_slots[i]] != m_atoms[i]; }
+
+    /// Size of the name of the i-th atom in the header's encoding.
+    size_t name_size(size_t i) const {
+        util::atom_table::name_t n = atom::atom_table().name(m_atoms[i]);
+        return m_utf8 ? n.len : utf8_latin1_size(n.name, n.len);
+    }
+
+    /// True if a new atom of the message is longer than 255 bytes.
+    bool long_atoms() const {
+        for (size_t i=0; i < m_count; i++)
+            if (is_new(i) && name_size(i) > 255)
+                return true;
+        return false;
+    }
+
+public:
+    /// The atoms of the header are written in UTF-8 if \a a_utf8 is true
+    /// (i.e. DFLAG_UTF8_ATOMS was negotiated) or in Latin-1 otherwise.
+    explicit atom_cache_out(bool a_utf8 = true) : m_msg_no(1), m_count(0), m_utf8(a_utf8) {
+        memset(m_entries, 0, sizeof(m_entries));
+        memset(m_msg,     0, sizeof(m_msg));
+    }
+
+    /// Start encoding the next message.
+    void begin() {
+        m_count = 0;
+        if (++m_msg_no == 0) {
+            memset(m_msg, 0, sizeof(m_msg));
+            m_msg_no = 1;
+        }
+    }
+
+    /// Number of atoms referenced by the current message.
+    size_t count() const { return m_count; }
+
+    /// Reference of the atom \a a in the current message, which is
+    /// assigned on the first call. Returns -1 if the atom is to be encoded
+    /// by value, because the message has the maximum number of references,
+    /// another atom of the message is stored in the same cache entry, or
+    /// the header is in Latin-1 and the atom's name can't be converted.
+    int ref(const atom& a) {
+        int n = a.index();
+        if (n == 0)
+            return -1;
+        size_t i = slot(n);
+        if (m_msg[i] == m_msg_no)
+            return m_atoms[m_ref[i]] == n ? m_ref[i] : -1;
+        if (m_count == MAX_REFS)
+            return -1;
+        if (!m_utf8) {
+            util::atom_table::name_t s = atom::atom_table().name(n);
+            if (utf8_latin1_size(s.name, s.len) == (size_t)-1)
+                return -1;
+        }
+        m_msg[i]          = m_msg_no;
+        m_ref[i]          = m_count;
+        m_slots[m_count]  = i;
+        m_atoms[m_count]  = n;
+        return m_count++;
+    }
+
+    /// Size of the distribution header including the 131, 'D' bytes.
+    /// It must be called before encode_header() commits the new atoms.
+    size_t header_size() const {
+        if (m_count == 0)
+            return 3;
+        bool   l   = long_atoms();
+        size_t res = 3 + m_count/2 + 1 + m_count;
+        for (size_t i=0; i < m_count; i++)
+            if (is_new(i))
+                res += (l ? 2 : 1) + name_size(i);
+        return res;
+    }
+
+    /// Write the distribution header of the current message to \a s,
+    /// advancing it, and store the message's new atoms in the cache.
+    void encode_header(char*& s) {
+        put8(s, 131);
+        put8(s, ERL_DIST_HEADER);
+        put8(s, m_count);
+        if (m_count == 0)
+            return;
+
+        bool l = long_atoms();
+        uint8_t* flags = (uint8_t*)s;
+        memset(flags, 0, m_count/2 + 1);
+        s += m_count/2 + 1;
+
+        auto set = [flags](size_t i, int f) { flags[i/2] |= f << ((i & 1) << 2); };
+        set(m_count, l ? 1 : 0);
+
+        for (size_t i=0; i < m_count; i++) {
+            size_t k = m_slots[i];
+            if (is_new(i)) {
+                set(i, 8 | k >> 8);
+                put8(s, k & 0xFF);
+                util::atom_table::name_t n = atom::atom_table().name(m_atoms[i]);
+                size_t len = name_size(i);
+                if (l) put16be(s, len);
+                else   put8(s, len);
+                if (len == n.len)
+                    memcpy(s, n.name, len);
+                else
+                    utf8_to_latin1(n.name, n.len, s);
+                s += len;
+                m_entries[k] = m_atoms[i];
+            } else {
+                set(i, k >> 8);
+                put8(s, k & 0xFF);
+            }
+        }
+    }
+};
+
+/**
+ * Direct-mapped cache of the atoms decoded from the messages received by
+ * a connection. It is keyed on the atom's name as it's received and on
+ * its encoding (Latin-1 or UTF-8), since the same bytes name different
+ * atoms in either one, and maps it to the atom's index, so that the atoms
+ * a connection keeps receiving are found without hashing the whole name
+ * and probing the atom table. A cache must be used by one thread at a time,
+ * so the threads sharing it hold its lock while they use it (see try_lock()).
+ */
+class atom_decode_cache {
+public:
+    enum {
+        SIZE     = 256, ///< Number of entries
+        MAX_LEN  = 27   ///< Longer atoms are looked up in the atom table
+    };
+
+private:
+    struct entry {
+        int      index;
+        uint32_t gen;   ///< Generation of a transient atom's slot
+        uint8_t  len;
+        bool     utf8;
+        char     name[MAX_LEN];
+    };
+
+    entry               m_entries[SIZE];
+    std::atomic<size_t> m_hits;
+    std::atomic<size_t> m_misses;
+    std::mutex          m_lock;
+
+    /// Entry of a name that is 1 to MAX_LEN bytes long, which is computed
+    /// from its length, encoding and up to 8 first and last bytes.
+    /// The counters are only changed by the thread using the cache,
+    /// but may be read by any other one.
+    static void count(std::atomic<size_t>& a_counter) {
+        a_counter.store(a_counter.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+    }
+
+    static size_t slot(const char* s, size_t len, bool a_utf8) {
+        uint64_t a = 0, b = 0;
+        size_t   n = len < 8 ? len : 8;
+        memcpy(&a, s, n);
+        memcpy(&b, s + len - n, n);
+        uint64_t h = (a ^ (b << 29 | b >> 35) ^ len ^ uint64_t(a_utf8) << 8)
+                   * 0x9E3779B97F4A7C15ull;
+        return h >> 56;
+    }
+
+public:
+    atom_decode_cache() : m_hits(0), m_misses(0) {
+        memset(m_entries, 0, sizeof(m_entries));
+    }
+
+    /// Find the index of the atom named by \a len bytes at \a s in UTF-8
+    /// if \a a_utf8 is true or in Latin-1 otherwise. On a miss the atom is
+    /// looked up with atom::lookup() and cached.
+    int lookup(const char* s, size_t len, bool a_utf8, bool a_transient)
+        throw(std::runtime_error, err_bad_argument)
+    {
+        util::atom_table& t = atom::atom_table();
+        if (len == 0 || len > MAX_LEN) {
+            count(m_misses);
+            return atom::lookup(s, len, a_utf8, a_transient);
+        }
+        entry& e = m_entries[slot(s, len, a_utf8)];
+        // A cached transient atom may have been evicted from the table
+        if (e.len == len && e.utf8 == a_utf8 && memcmp(e.name, s, len) == 0 &&
+           (e.index >= 0 || (a_transient && t.touch(e.index)
+                                         && t.generation(e.index) == e.gen))) {
+            count(m_hits);
+            return e.index;
+        }
+        count(m_misses);
+        int n   = atom::lookup(s, len, a_utf8, a_transient, &e.gen);
+        e.index = n;
+        e.len   = len;
+        e.utf8  = a_utf8;
+        memcpy(e.name, s, len);
+        return n;
+    }
+
+    /// Lock the cache for the calling thread unless another one holds it,
+    /// in which case the caller decodes its atoms without the cache rather
+    /// than waiting. Makes the cache usable with std::unique_lock.
+    bool try_lock() { return m_lock.try_lock(); }
+    void lock()     { m_lock.lock(); }
+    void unlock()   { m_lock.unlock(); }
+
+    /// Number of lookups of atoms found in the cache.
+    size_t hits()   const { return m_hits.load(std::memory_order_relaxed);   }
+    /// Number of lookups of atoms that weren't in the cache.
+    size_t misses() const { return m_misses.load(std::memory_order_relaxed); }
+};
+
+//-----------------------------------------------------------------------------
+// atom_cache_scope
+//-----------------------------------------------------------------------------
+
+inline atom atom_cache_scope::decode(uint8_t i, int idx) {
+    const atom_cache_scope* p = current();
+    if (!p || i >= p->m_count)
+        throw err_decode_exception("Invalid atom cache reference", idx);
+    return p->m_refs[i];
+}
+
+inline int atom_cache_scope::lookup(const char* s, size_t len, bool a_utf8, bool a_transient) {
+    const atom_cache_scope* p = current();
+    if (p && p->m_lookup)
+        return p->m_lookup->lookup(s, len, a_utf8, a_transient);
+    return atom::lookup(s, len, a_utf8, a_transient);
+}
+
+inline int atom_cache_scope::encode(const atom& a, bool& a_utf8) {
+    atom_cache_scope* p = current();
+    a_utf8 = p && p->m_utf8;
+    return p && p->m_out ? p->m_out->ref(a) : -1;
+}
+
+} // namespace marshal
+} // namespace eixx
+
+#endif // _EIXX_ATOM_CACHE_HPP_
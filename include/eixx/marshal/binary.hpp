@@ -40,15 +40,74 @@ limitations under the License.
 namespace eixx {
 namespace marshal {
 
+template <class Alloc> class binary;
+
+/**
+ * Makes large binaries decoded on the current thread share the storage
+ * they are decoded from instead of copying it.
+ *
+ * While the scope is alive, a binary of at least \a threshold bytes whose
+ * bytes lie within the source storage references a slice of it. Such binary
+ * keeps the whole source storage alive, so the threshold should be large
+ * enough for the saved copy to outweigh the pinned memory.
+ * Scopes may be nested, in which case only the innermost one is used.
+ */
+template <class Alloc>
+class binary_slice_scope {
+    const char_blob<Alloc>& m_src;
+    size_t                  m_threshold;
+    binary_slice_scope*     m_prev;
+
+    static binary_slice_scope*& current() {
+        static thread_local binary_slice_scope* s_current = nullptr;
+        return s_current;
+    }
+public:
+    /// Default minimum size of a binary that references the source.
+    static const size_t DEF_THRESHOLD = 4096;
+
+    explicit binary_slice_scope(const char_blob<Alloc>& a_src,
+                                size_t a_threshold = DEF_THRESHOLD)
+        : m_src(a_src), m_threshold(a_threshold), m_prev(current())
+    {
+        current() = this;
+    }
+
+    explicit binary_slice_scope(const binary<Alloc>& a_src,
+                                size_t a_threshold = DEF_THRESHOLD);
+
+    ~binary_slice_scope() { current() = m_prev; }
+
+    /// Make \a a_out reference \a n bytes at \a p if they are covered by
+    /// the innermost scope of the current thread.
+    /// @return false if there's no such scope or \a n is below its threshold
+    ///         (unless \a a_any_size is true).
+    static bool slice(const char* p, size_t n, char_blob<Alloc>& a_out,
+                      bool a_any_size = false);
+
+    /// Binary referencing \a n bytes at \a p if possible, or their copy.
+    /// Unlike decoded binaries, the bytes are referenced regardless of the
+    /// scope's threshold, unless they fit inline.
+    static binary<Alloc> share(const char* p, size_t n, const Alloc& a_alloc = Alloc());
+};
+
 template <class Alloc>
 class binary
 {
-    blob<char, Alloc>* m_blob;
+    // Binaries of up to char_blob::capacity bytes are stored inline.
+    // Large binaries may reference a slice of another blob
+    // (see binary_slice_scope).
+    char_blob<Alloc> m_blob;
+
+    friend class eterm<Alloc>;
+    friend class binary_slice_scope<Alloc>;
+
+    void release() { m_blob.release(); }
 
     void decode(const char* buf, int& idx, size_t size) throw(err_decode_exception);
 
 public:
-    binary() : m_blob(nullptr) {}
+    binary() {}
 
     /// Create a binary from string
     explicit binary(const std::string& a_bin, const Alloc& a_alloc = Alloc())
@@ -63,19 +122,14 @@ public:
      * @param a_alloc is the allocator to use
      **/
     binary(const char* data, size_t size, const Alloc& a_alloc = Alloc()) {
-        if (size == 0) {
-            m_blob = nullptr;
+        if (size == 0)
             return;
-        }
-        m_blob = new blob<char, Alloc>(size, a_alloc);
-        memcpy(m_blob->data(), data, size);
+        new (&m_blob) char_blob<Alloc>(data, size, a_alloc);
     }
 
-    binary(const binary<Alloc>& rhs) : m_blob(rhs.m_blob) {
-        if (m_blob) m_blob->inc_rc();
-    }
+    binary(const binary<Alloc>& rhs) : m_blob(rhs.m_blob) {}
 
-    binary(binary<Alloc>&& rhs) : m_blob(rhs.m_blob) { rhs.m_blob = nullptr; }
+    binary(binary<Alloc>&& rhs) : m_blob(std::move(rhs.m_blob)) {}
 
     binary(std::initializer_list<uint8_t> bytes, const Alloc& alloc = Alloc())
         : binary(reinterpret_cast<const char*>(bytes.begin()), bytes.size(), alloc) {}
@@ -91,32 +145,67 @@ public:
     binary(const char* buf, int& idx, size_t size, const Alloc& a_alloc = Alloc())
         throw(err_decode_exception);
 
+    ~binary() { release(); }
+
     /** Get the size of the data (in bytes) */
-    size_t size() const { return m_blob ? m_blob->size() : 0; }
+    size_t size() const { return m_blob.size(); }
 
     /** Get the data's binary buffer */
-    const char* data() const { return m_blob ? m_blob->data() : ""; }
+    const char* data() const { return m_blob.null() ? "" : m_blob.data(); }
+
+    /** Get the reference count of the shared data. Use for debugging only. */
+    int use_count() const { return m_blob.use_count(); }
+
+    /** Get the allocator of the shared data. */
+    Alloc get_allocator() const { return m_blob.get_allocator(); }
+
+    /**
+     * Get the part of the binary of \a a_len bytes starting at \a a_offset.
+     * The result references the storage of this binary (unless it is short
+     * enough to be stored inline), so no data is copied.
+     * @throw err_bad_argument if the range is outside of the binary.
+     */
+    binary slice(size_t a_offset, size_t a_len) const {
+        if (a_offset > size() || a_len > size() - a_offset)
+            throw err_bad_argument("Invalid binary slice", a_offset);
+        binary b;
+        if (a_len)
+            b.m_blob = m_blob.slice(a_offset, a_len);
+        return b;
+    }
+
+    /** True if the binary references a part of another binary's storage. */
+    bool is_slice() const { return m_blob.is_slice(); }
+
+    /**
+     * Copy the data of a slice to its own storage, so that the slice no
+     * longer holds on to the storage of the binary it was taken from.
+     * This does nothing if the binary is not a slice.
+     */
+    binary& compact() {
+        if (is_slice())
+            *this = binary(data(), size(), m_blob.get_allocator());
+        return *this;
+    }
 
     binary& operator= (const binary& rhs) {
-        if (this != &rhs) {
-            m_blob = rhs.m_blob;
-            if (m_blob) m_blob->inc_rc();
-        }
+        m_blob = rhs.m_blob;
         return *this;
     }
 
     binary& operator= (binary&& rhs) {
-        if (this != &rhs) {
-            m_blob = rhs.m_blob;
-            rhs.m_blob = nullptr;
-        }
+        m_blob = std::move(rhs.m_blob);
         return *this;
     }
 
     bool operator== (const binary<Alloc>& rhs) const {
-        return size() == rhs.size() 
-            && (size() == 0 || memcmp(data(), rhs.data(), size()) == 0);
+        return m_blob.same(rhs.m_blob)
+            || (size() == rhs.size() && !m_blob.hash_mismatch(rhs.m_blob)
+                && (size() == 0 || memcmp(data(), rhs.data(), size()) == 0));
     }
+
+    /// Hash value of the binary's bytes.
+    uint32_t hash() const { return m_blob.hash(size()); }
     bool operator< (const binary<Alloc>& rhs) {
         if (size() < rhs.size()) return true;
         if (size() > rhs.size()) return false;
@@ -33,6 +33,34 @@ limitations under the License.
 namespace eixx {
 namespace marshal {
 
+template <class Alloc>
+binary_slice_scope<Alloc>::binary_slice_scope(const binary<Alloc>& a_src, size_t a_threshold)
+    : binary_slice_scope(a_src.m_blob, a_threshold)
+{}
+
+template <class Alloc>
+bool binary_slice_scope<Alloc>::slice(const char* p, size_t n, char_blob<Alloc>& a_out,
+                                      bool a_any_size)
+{
+    const binary_slice_scope* s = current();
+    if (!s || (n < s->m_threshold && !a_any_size) || !s->m_src.owner())
+        return false;
+    const char* begin = s->m_src.data();
+    if (p < begin || p + n > begin + s->m_src.size())
+        return false;
+    a_out = s->m_src.slice(p - begin, n);
+    return true;
+}
+
+template <class Alloc>
+binary<Alloc> binary_slice_scope<Alloc>::share(const char* p, size_t n, const Alloc& a_alloc)
+{
+    binary<Alloc> b;
+    if (n <= char_blob<Alloc>::capacity || !slice(p, n, b.m_blob, true))
+        b = binary<Alloc>(p, n, a_alloc);
+    return b;
+}
+
 template <class Alloc>
 binary<Alloc>::binary(const char* buf, int& idx, size_t size, const Alloc& a_alloc)
     throw (err_decode_exception)
@@ -44,8 +72,8 @@ binary<Alloc>::binary(const char* buf, int& idx, size_t size, const Alloc& a_all
         throw err_decode_exception("Error decoding binary", idx);
 
     size_t sz = get32be(s);
-    m_blob = new blob<char, Alloc>(sz, a_alloc);
-    ::memcpy(m_blob->data(),s,sz);
+    if (!binary_slice_scope<Alloc>::slice(s, sz, m_blob))
+        new (&m_blob) char_blob<Alloc>(s, sz, a_alloc);
 
     idx += s + sz - s0;
     BOOST_ASSERT((size_t)idx <= size);
@@ -53,7 +53,8 @@ namespace eixx {
     } // namespace marshal
 
     // eterm types
-    enum eterm_type {
+    /// Type of an eterm. Stored in a single byte of the eterm header.
+    enum eterm_type : char {
           UNDEFINED         = 0
         , LONG              = 1
         , DOUBLE            = 2
@@ -69,9 +70,14 @@ namespace eixx {
         , TUPLE             = 11
         , LIST              = 12
         , TRACE             = 13
-        , MAX_ETERM_TYPE    = 13
+        , MAP               = 14
+        , MAX_ETERM_TYPE    = 14
     };
 
+    /// True for the types of terms that can be changed in place through
+    /// their non-const element accessors while other terms share them.
+    inline bool is_mutable_type(eterm_type a_type) { return a_type >= TUPLE; }
+
     /// Returns string representation of type \a a_type.
     const char* type_to_string(eterm_type a_type);
 
@@ -106,6 +112,7 @@ namespace eixx {
             case TUPLE : return "TUPLE";
             case LIST  : return "LIST";
             case TRACE : return "TRACE";
+            case MAP   : return "MAP";
             default    : return "UNDEFINED";
         }
     }
@@ -125,6 +132,7 @@ namespace eixx {
             case TUPLE : return a_prefix ? "::tuple()"  : "tuple()";
             case LIST  : return a_prefix ? "::list()"   : "list()";
             case TRACE : return a_prefix ? "::trace()"  : "trace()";
+            case MAP   : return a_prefix ? "::map()"    : "map()";
             default    : return "";
         }
     }
@@ -46,14 +46,18 @@ limitations under the License.
 #include <eixx/marshal/ref.hpp>
 #include <eixx/marshal/tuple.hpp>
 #include <eixx/marshal/list.hpp>
+#include <eixx/marshal/map.hpp>
 #include <eixx/marshal/trace.hpp>
 #include <eixx/marshal/var.hpp>
 #include <eixx/marshal/varbind.hpp>
 #include <eixx/marshal/eterm_match.hpp>
+#include <eixx/marshal/phash2.hpp>
 
 namespace eixx {
 namespace marshal {
 
+template <typename Alloc> class list_view;
+
 namespace {
     template <typename T, typename Alloc> struct enum_type;
     template <typename Alloc> struct enum_type<long,   Alloc>        { typedef long   type; };
@@ -69,6 +73,7 @@ namespace {
     template <typename Alloc> struct enum_type<tuple<Alloc>,  Alloc> { typedef tuple<Alloc>  type; };
     template <typename Alloc> struct enum_type<list<Alloc>,   Alloc> { typedef list<Alloc>   type; };
     template <typename Alloc> struct enum_type<trace<Alloc>,  Alloc> { typedef trace<Alloc>  type; };
+    template <typename Alloc> struct enum_type<map<Alloc>,    Alloc> { typedef map<Alloc>    type; };
 }
 
 /**
@@ -79,8 +84,8 @@ namespace {
  * eterm initialization is not thread safe!
  *
  * eterm is a very lightweight structure of size equal to two
- * longs.  The first one represents term type and the second one
- * either contains the value or a pointer to a compound reference
+ * longs.  The first one is the term header holding the term type and the
+ * second one either contains the value or a pointer to a compound reference
  * counted value.  All eterms are copy constructed on stack, therefore
  * there's no need to create pointers to eterms as copying them is
  * a very fast operation due to their small size.  The underlying
@@ -126,6 +131,8 @@ namespace {
  */
 template <typename Alloc>
 class eterm {
+    // Term header. The type takes a single byte, the remaining bytes up
+    // to the alignment of the value are available for per-term flags.
     eterm_type m_type;
 
     union vartype {
@@ -142,6 +149,7 @@ class eterm {
         tuple<Alloc>    t;
         list<Alloc>     l;
         trace<Alloc>  trc;
+        map<Alloc>      m;
 
         uint64_t value; // this is for ease of copying
 
@@ -171,6 +179,7 @@ class eterm {
         vartype(const tuple<Alloc>&  x) :   t(x) {}
         vartype(const list<Alloc>&   x) :   l(x) {}
         vartype(const trace<Alloc>&  x) : trc(x) {}
+        vartype(const map<Alloc>&    x) :   m(x) {}
 
         vartype() : i(0) {}
         ~vartype() {}
@@ -180,6 +189,39 @@ class eterm {
 
     BOOST_STATIC_ASSERT(sizeof(vartype) == sizeof(uint64_t));
 
+    /// Reference-counted storage of a compound term (m_type >= STRING).
+    /// Every compound type holds a single blob pointer, so its reference
+    /// count can be reached without dispatching on the type. Short strings
+    /// and binaries stored inline (see char_blob) have no shared storage,
+    /// and the pointer to a slice of a blob is tagged.
+    blob_base<Alloc>* shared_blob() const {
+        uintptr_t p;
+        memcpy(&p, &vt, sizeof(p));
+        return (p & 1) ? nullptr : reinterpret_cast<blob_base<Alloc>*>(p & ~uintptr_t(3));
+    }
+
+    /// Free the storage of a compound term once its reference count
+    /// dropped to 0.
+    void free_blob() {
+        switch (m_type) {
+            case STRING: { vt.s.m_blob.free_shared();   return; }
+            case BINARY: { vt.bin.m_blob.free_shared(); return; }
+            case PID:    { vt.pid.m_blob->free(); return; }
+            case PORT:   { vt.prt.m_blob->free(); return; }
+            case REF:    { vt.r.m_blob->free();   return; }
+            case TUPLE:
+            case TRACE:  { tuple<Alloc>::free_blob(vt.t.m_blob); return; }
+            case LIST:   { vt.l.free_blob();      return; }
+            case MAP:    { map<Alloc>::free_blob(vt.m.m_blob); return; }
+            default: return;
+        }
+    }
+
+    /// A transient atom held by a term is referenced, so that it isn't
+    /// evicted from the atom table (see util::basic_atom_table::acquire()).
+    void ref_atom()     const { if (vt.a.index() < 0) atom::atom_table().ref(vt.a.index()); }
+    void release_atom() const { if (vt.a.index() < 0) atom::atom_table().release(vt.a.index()); }
+
     void check(eterm_type tp) const { if (unlikely(m_type != tp)) throw err_wrong_type(tp, m_type); }
 
     /**
@@ -201,6 +243,7 @@ class eterm {
     tuple<Alloc>&   get(const tuple<Alloc>*)    { check(TUPLE);  return vt.t; }
     list<Alloc>&    get(const list<Alloc>*)     { check(LIST);   return vt.l; }
     trace<Alloc>&   get(const trace<Alloc>*)    { check(TRACE);  return vt.trc; }
+    map<Alloc>&     get(const map<Alloc>*)      { check(MAP);    return vt.m; }
 
     template <typename T, typename A> friend T& get(eterm<A>& t);
 
@@ -229,7 +272,11 @@ public:
     eterm(long   a)                 : m_type(LONG),  vt(a) {}
     eterm(double a)                 : m_type(DOUBLE),vt(a) {}
     eterm(bool   a)                 : m_type(BOOL),  vt(a) {}
-    eterm(atom   a)                 : m_type(ATOM),  vt(a) {}
+    /// @throws err_bad_argument if \a a is an evicted transient atom.
+    eterm(atom   a)                 : m_type(ATOM),  vt(a) {
+        if (unlikely(a.index() < 0) && !atom::atom_table().acquire(a.index()))
+            throw err_bad_argument("Atom was evicted from transient atom table", a.index());
+    }
     eterm(var    a)                 : m_type(VAR),   vt(a) {}
     eterm(const char* a, const Alloc& alloc = Alloc())
         : m_type(STRING), vt(string<Alloc>(a, alloc)) {}
@@ -243,6 +290,7 @@ public:
     eterm(const tuple<Alloc>& a)   : m_type(TUPLE),  vt(a) {}
     eterm(const list<Alloc>&  a)   : m_type(LIST),   vt(a) {}
     eterm(const trace<Alloc>& a)   : m_type(TRACE),  vt(a) {}
+    eterm(const map<Alloc>& a)     : m_type(MAP),    vt(a) {}
 
     /**
      * Tuple initialization
@@ -280,18 +328,13 @@ public:
      * and for compound terms the storage is reference counted.
      */
     eterm(const eterm& a) : m_type(a.m_type) {
-        switch (m_type) {
-            case STRING:    { new (&vt.s)   string<Alloc>(a.vt.s);    break; }
-            case BINARY:    { new (&vt.bin) binary<Alloc>(a.vt.bin);  break; }
-            case PID:       { new (&vt.pid) epid<Alloc>(a.vt.pid);    break; }
-            case PORT:      { new (&vt.prt) port<Alloc>(a.vt.prt);    break; }
-            case REF:       { new (&vt.r)   ref<Alloc>(a.vt.r);       break; }
-            case TUPLE:     { new (&vt.t)   tuple<Alloc>(a.vt.t);     break; }
-            case LIST:      { new (&vt.l)   list<Alloc>(a.vt.l);      break; }
-            case TRACE:     { new (&vt.trc) trace<Alloc>(a.vt.trc);   break; }
-            default:
-                vt.value = a.vt.value;
-        }
+        vt.value = a.vt.value;
+        if (m_type >= STRING) {
+            BOOST_ASSERT(a.initialized());
+            if (blob_base<Alloc>* p = shared_blob())
+                p->inc_rc();
+        } else if (m_type == ATOM)
+            ref_atom();
     }
 
     /**
@@ -305,22 +348,17 @@ public:
 
     /**
      * Destruct this term. For compound terms it decreases the
-     * reference count of their storage. This does nothing to
-     * simple terms (e.g. long, double, bool).
+     * reference count of their storage, and for transient atoms that of
+     * their slot in the atom table. This does nothing to other simple
+     * terms (e.g. long, double, bool).
      */
     ~eterm() {
-        switch (m_type) {
-            //No need to destruct atoms - they are stored in global atom table.
-            case STRING: { vt.s.~string();   return; }
-            case BINARY: { vt.bin.~binary(); return; }
-            case PID:    { vt.pid.~epid();   return; }
-            case PORT:   { vt.prt.~port();   return; }
-            case REF:    { vt.r.~ref();      return; }
-            case TUPLE:  { vt.t.~tuple();    return; }
-            case LIST:   { vt.l.~list();     return; }
-            case TRACE:  { vt.trc.~trace();  return; }
-            default: return;
-        }
+        if (m_type >= STRING) {
+            blob_base<Alloc>* p = shared_blob();
+            if (p && p->dec_rc())
+                free_blob();
+        } else if (m_type == ATOM)
+            release_atom();
     }
 
     /**
@@ -341,7 +379,7 @@ public:
 #if __cplusplus >= 201103L
     eterm& operator= (eterm&& a) {
         if (this != &a) {
-            if (m_type >= STRING)
+            if (m_type >= ATOM)
                 this->~eterm();
             replace(&a);
         }
@@ -351,14 +389,61 @@ public:
 
     template <typename T>
     void set(const T& a) {
-        if (m_type >= STRING)
+        if (m_type >= ATOM)
             this->~eterm();
         new (this) eterm(a);
     }
 
+    /// Terms of different types are never equal, except that a string is
+    /// equal to the list of its characters' codes, because Erlang encodes
+    /// lists of bytes as strings.
     bool operator== (const eterm<Alloc>& rhs) const;
     bool operator!= (const eterm<Alloc>& rhs) const { return !this->operator==(rhs); }
 
+    /**
+     * Compare this term to \a rhs using the Erlang term order:
+     * number < atom < reference < port < pid < tuple < map < list < binary.
+     * Unlike in Erlang, an integer is ordered before a float of equal value,
+     * which keeps the order consistent with operator==().
+     *
+     * If \a a_key_order is true, the terms are compared in the order of
+     * map keys, in which all integers are ordered before all floats.
+     * @return 0 if the terms are equal, a negative value if this term is
+     *         less than \a rhs, and a positive value otherwise.
+     */
+    int compare(const eterm<Alloc>& rhs, bool a_key_order = false) const;
+
+    bool operator<  (const eterm<Alloc>& rhs) const { return compare(rhs) < 0; }
+
+    /**
+     * Hash value of the term consistent with operator==(). The hash of
+     * a string or binary, and of a tuple, list or map with no tuple, list
+     * or map elements, is computed once and cached in its shared storage,
+     * so rehashing a copy of the term is O(1).
+     */
+    size_t hash() const;
+
+    /**
+     * Compute erlang:phash2(Term, Range) of this term, so that a C++ node
+     * can pick the same bucket as Erlang code does.
+     * @param a_range is the range of the hash value (1..2^32).
+     * @return a value in the range 0..a_range-1.
+     * @throw err_bad_argument if \a a_range is invalid.
+     */
+    uint32_t phash2(uint64_t a_range = eixx::marshal::phash2::DEF_RANGE) const;
+
+    /**
+     * Compute erlang:phash2(Term, Range) of the term stored in \a a_buf
+     * in Erlang external format without decoding it.
+     * The buffer may start with the version byte.
+     */
+    static uint32_t phash2(const char* a_buf, size_t a_size,
+                           uint64_t a_range = eixx::marshal::phash2::DEF_RANGE)
+        throw (err_decode_exception, err_bad_argument)
+    {
+        return eixx::marshal::phash2::hash(a_buf, a_size, a_range);
+    }
+
     /**
      * Return true if the term was default constructed and not initialized.
      */
@@ -378,10 +463,21 @@ public:
             case TUPLE: { return vt.t.initialized(); }
             case LIST:  { return vt.l.initialized(); }
             case TRACE: { return vt.trc.initialized(); }
+            case MAP:   { return vt.m.initialized(); }
             default:    return true;
         }
     }
 
+    /**
+     * Make this term and all of its sub-terms immortal. Copying and
+     * destroying a frozen term never touches its reference count, and its
+     * storage is never freed. This is meant for constant terms, such as
+     * patterns, that are created once and then copied by many threads.
+     * Freeze a term before sharing it with other threads.
+     * @return this term.
+     */
+    const eterm<Alloc>& freeze() const;
+
     /**
      * Quick way to check that two eterms are equal. The function returns true
      * if the terms are of the same type and their simple type values match or
@@ -427,11 +523,16 @@ public:
     list<Alloc>&         to_list()         { check(LIST);   return vt.l; }
     const trace<Alloc>&  to_trace()  const { check(TRACE);  return vt.trc; }
     trace<Alloc>&        to_trace()        { check(TRACE);  return vt.trc; }
+    const map<Alloc>&    to_map()    const { check(MAP);    return vt.m; }
+
+    /// View of a list, or of a string as the list of its characters' codes
+    /// (see list_view). The string is not copied.
+    list_view<Alloc>     to_list_view() const { return list_view<Alloc>(*this); }
 
     // Try to decode the value as a pair containing atom
     // option name and any value
     bool to_pair(atom& a_opt, eterm<Alloc>& a_val) {
-        static const eterm<Alloc> s_pair = eterm<Alloc>::format("{A::atom(), V}");
+        static const eterm<Alloc> s_pair = eterm<Alloc>::format("{A::atom(), V}").freeze();
         static const atom         s_am_opt = atom("A");
         static const atom         s_am_val = atom("V");
 
@@ -457,6 +558,12 @@ public:
     bool is_tuple()  const { return m_type == TUPLE ; }
     bool is_list()   const { return m_type == LIST  ; }
     bool is_trace()  const { return m_type == TRACE ; }
+    bool is_map()    const { return m_type == MAP   ; }
+
+    /// True for an integer in the range 0..255. Such integers are the
+    /// elements of lists that are encoded as strings. Both sides of the
+    /// conjunction are evaluated to keep scans over lists branchless.
+    bool is_byte()   const { return (m_type == LONG) & ((unsigned long)vt.i <= 255); }
 
     /**
      * Perform pattern matching.
@@ -603,11 +710,12 @@ public:
             case TUPLE:  return wrapper(v, vt.t);
             case LIST:   return wrapper(v, vt.l);
             case TRACE:  return wrapper(v, vt.trc);
+            case MAP:    return wrapper(v, vt.m);
             default: {
-                std::stringstream s; s << "Undefined term_type (" << m_type << ')';
+                std::stringstream s; s << "Undefined term_type (" << int(m_type) << ')';
                 throw err_invalid_term(s.str());
             }
-            BOOST_STATIC_ASSERT(MAX_ETERM_TYPE == 13);
+            BOOST_STATIC_ASSERT(MAX_ETERM_TYPE == 14);
         }
     }
 };
@@ -626,6 +734,17 @@ namespace std {
     }
 }
 
+namespace std {
+    /// Allows eterm to be used as a key of std::unordered_map.
+    template <typename Alloc>
+    struct hash<eixx::marshal::eterm<Alloc>> {
+        size_t operator()(const eixx::marshal::eterm<Alloc>& a_term) const {
+            return a_term.hash();
+        }
+    };
+}
+
+#include <eixx/marshal/list_view.hpp>
 #include <eixx/marshal/eterm.hxx>
 
 #endif
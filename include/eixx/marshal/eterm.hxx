@@ -28,6 +28,7 @@ limitations under the License.
 #include <stdarg.h>
 #include <eixx/marshal/visit.hpp>
 #include <eixx/marshal/visit_encode_size.hpp>
+#include <eixx/marshal/visit_hash.hpp>
 #include <eixx/marshal/visit_encoder.hpp>
 #include <eixx/marshal/visit_to_string.hpp>
 #include <eixx/marshal/visit_subst.hpp>
@@ -88,6 +89,9 @@ inline eterm_type type_string_to_type(const char* s, size_t n) {
          case 'l':
              if (strncmp(p,"ist",m) == 0)        r = LIST;
              break;
+         case 'm':
+             if (strncmp(p,"ap",m) == 0)         r = MAP;
+             break;
          default:
              break;
      }
@@ -113,14 +117,42 @@ const char* eterm<Alloc>::type_string() const {
         case TUPLE:     return "tuple";
         case LIST:      return "list";
         case TRACE:     return "trace";
+        case MAP:       return "map";
     }
-    BOOST_STATIC_ASSERT(MAX_ETERM_TYPE == 13);
+    BOOST_STATIC_ASSERT(MAX_ETERM_TYPE == 14);
+}
+
+template <typename Alloc>
+uint32_t eterm<Alloc>::phash2(uint64_t a_range) const {
+    size_t n = encode_size(0, false);
+    char   stack_buf[256];
+    std::unique_ptr<char[]> heap_buf(n > sizeof(stack_buf) ? new char[n] : nullptr);
+    char*  buf = heap_buf ? heap_buf.get() : stack_buf;
+    encode(buf, n, 0, false);
+    int idx = 0;
+    return eixx::marshal::phash2::hash(buf, idx, n, a_range);
+}
+
+template <typename Alloc>
+size_t eterm<Alloc>::hash() const {
+    if (m_type == UNDEFINED)
+        return 0;
+    // A string is hashed like the list of its characters' codes it's equal to
+    return eixx::detail::hash_combine(m_type == STRING ? LIST : m_type,
+                                      visit_eterm_hash<Alloc>().apply_visitor(*this));
 }
 
 template <typename Alloc>
 inline bool eterm<Alloc>::operator== (const eterm<Alloc>& rhs) const {
-    if (m_type != rhs.type())
-        return false;
+    if (m_type != rhs.type()) {
+        // A string is equal to the list of its characters' codes
+        bool chars = (m_type == STRING && rhs.m_type == LIST)
+                  || (m_type == LIST   && rhs.m_type == STRING);
+        return chars && compare(rhs) == 0;
+    }
+    // Compound terms sharing the same storage are equal
+    if (m_type >= STRING && vt.value == rhs.vt.value)
+        return true;
     switch (m_type) {
         case LONG:   return vt.i    == rhs.vt.i;
         case DOUBLE: return vt.d    == rhs.vt.d;
@@ -135,12 +167,137 @@ inline bool eterm<Alloc>::operator== (const eterm<Alloc>& rhs) const {
         case TUPLE:  return vt.t    == rhs.vt.t;
         case LIST:   return vt.l    == rhs.vt.l;
         case TRACE:  return vt.trc  == rhs.vt.trc;
+        case MAP:    return vt.m    == rhs.vt.m;
         default: {
-            std::stringstream s; s << "Undefined term_type (" << m_type << ')';
+            std::stringstream s; s << "Undefined term_type (" << int(m_type) << ')';
             throw err_invalid_term(s.str());
         }
     }
-    BOOST_STATIC_ASSERT(MAX_ETERM_TYPE == 13);
+    BOOST_STATIC_ASSERT(MAX_ETERM_TYPE == 14);
+}
+
+namespace detail {
+
+    /// Position of a term type in the Erlang term order.
+    inline int type_order(eterm_type a_type) {
+        switch (a_type) {
+            case LONG:
+            case DOUBLE: return 1;
+            case BOOL:
+            case ATOM:   return 2;
+            case REF:    return 3;
+            case PORT:   return 4;
+            case PID:    return 5;
+            case TUPLE:
+            case TRACE:  return 6;
+            case MAP:    return 7;
+            case STRING:
+            case LIST:   return 8;
+            case BINARY: return 9;
+            case VAR:    return 10;
+            default:     return 0;
+        }
+    }
+
+    template <typename T>
+    inline int compare_values(T a, T b) { return a < b ? -1 : (b < a ? 1 : 0); }
+
+    inline int compare_bytes(const char* a, size_t na, const char* b, size_t nb) {
+        int n = memcmp(a, b, std::min(na, nb));
+        return n ? n : compare_values(na, nb);
+    }
+
+    /// Compare two sequences of terms (e.g. list elements) lexicographically.
+    template <typename It1, typename It2>
+    inline int compare_seq(It1 i1, It1 e1, It2 i2, It2 e2, bool key_order) {
+        for (; i1 != e1 && i2 != e2; ++i1, ++i2)
+            if (int n = (*i1).compare(*i2, key_order))
+                return n;
+        return (i1 == e1) ? (i2 == e2 ? 0 : -1) : 1;
+    }
+
+} // namespace detail
+
+template <typename Alloc>
+int eterm<Alloc>::compare(const eterm<Alloc>& rhs, bool a_key_order) const {
+    using namespace detail;
+
+    if (m_type == rhs.m_type && vt.value == rhs.vt.value && m_type != DOUBLE)
+        return 0;
+
+    int t1 = type_order(m_type), t2 = type_order(rhs.m_type);
+    if (t1 != t2)
+        return t1 - t2;
+
+    switch (m_type) {
+        case LONG:
+        case DOUBLE: {
+            if (m_type == LONG && rhs.m_type == LONG)
+                return compare_values(vt.i, rhs.vt.i);
+            if (a_key_order && m_type != rhs.m_type)
+                return m_type == LONG ? -1 : 1;
+            double d1 = m_type     == LONG ? (double)vt.i     : vt.d;
+            double d2 = rhs.m_type == LONG ? (double)rhs.vt.i : rhs.vt.d;
+            int n = compare_values(d1, d2);
+            return n ? n : (int)m_type - (int)rhs.m_type;
+        }
+        case BOOL:
+        case ATOM: {
+            const char* a = m_type     == BOOL ? (vt.b     ? "true" : "false") : vt.a.c_str();
+            const char* b = rhs.m_type == BOOL ? (rhs.vt.b ? "true" : "false") : rhs.vt.a.c_str();
+            return strcmp(a, b);
+        }
+        case REF: {
+            if (int n = vt.r.node().compare(rhs.vt.r.node())) return n;
+            for (int i = 2; i >= 0; --i)
+                if (int n = compare_values(vt.r.ids()[i], rhs.vt.r.ids()[i])) return n;
+            return compare_values(vt.r.creation(), rhs.vt.r.creation());
+        }
+        case PORT: {
+            if (int n = vt.prt.node().compare(rhs.vt.prt.node())) return n;
+            if (int n = compare_values(vt.prt.id(), rhs.vt.prt.id())) return n;
+            return compare_values(vt.prt.creation(), rhs.vt.prt.creation());
+        }
+        case PID: {
+            if (int n = vt.pid.node().compare(rhs.vt.pid.node())) return n;
+            if (int n = compare_values(vt.pid.serial(), rhs.vt.pid.serial())) return n;
+            if (int n = compare_values(vt.pid.id(), rhs.vt.pid.id())) return n;
+            return compare_values(vt.pid.creation(), rhs.vt.pid.creation());
+        }
+        case TUPLE:
+        case TRACE: {
+            if (int n = compare_values(vt.t.size(), rhs.vt.t.size())) return n;
+            return compare_seq(vt.t.begin(), vt.t.end(), rhs.vt.t.begin(), rhs.vt.t.end(), a_key_order);
+        }
+        case MAP: {
+            const map<Alloc>& m1 = vt.m, &m2 = rhs.vt.m;
+            if (int n = compare_values(m1.size(), m2.size())) return n;
+            for (size_t i=0, e=m1.size(); i < e; ++i)
+                if (int n = m1.key(i).compare(m2.key(i), true)) return n;
+            for (size_t i=0, e=m1.size(); i < e; ++i)
+                if (int n = m1.value(i).compare(m2.value(i), a_key_order)) return n;
+            return 0;
+        }
+        case STRING:
+        case LIST: {
+            if (m_type == STRING && rhs.m_type == STRING)
+                return compare_bytes(vt.s.c_str(), vt.s.size(),
+                                     rhs.vt.s.c_str(), rhs.vt.s.size());
+            if (m_type == LIST && rhs.m_type == LIST)
+                return compare_seq(vt.l.begin(), vt.l.end(), rhs.vt.l.begin(), rhs.vt.l.end(), a_key_order);
+            // A string compares like the list of its characters' codes
+            const list_view<Alloc> l1(*this), l2(rhs);
+            return compare_seq(l1.begin(), l1.end(), l2.begin(), l2.end(), a_key_order);
+        }
+        case BINARY:
+            return compare_bytes(vt.bin.data(), vt.bin.size(),
+                                 rhs.vt.bin.data(), rhs.vt.bin.size());
+        case VAR:
+            return vt.v.name().compare(rhs.vt.v.name());
+        default:
+            return 0;
+    }
+    BOOST_STATIC_ASSERT(MAX_ETERM_TYPE == 14);
 }
 
 template <typename Alloc>
@@ -173,6 +330,34 @@ void eterm<Alloc>::decode(const char* a_buf, int& idx, size_t a_size, const Allo
     if ((size_t)idx == a_size)
         throw err_decode_exception("Empty term", idx);
 
+    // Atoms of any tag, including atom cache references of a distribution
+    // header (see atom_cache_scope), which ei_get_type() doesn't know
+    switch ((uint8_t)a_buf[idx]) {
+        case ERL_ATOM_EXT:
+        case ERL_SMALL_ATOM_EXT:
+        case ERL_ATOM_UTF8_EXT:
+        case ERL_SMALL_ATOM_UTF8_EXT:
+        case ERL_ATOM_CACHE_REF: {
+            // A transient atom may be evicted before the term references
+            // it, in which case it's looked up again
+            int  i;
+            atom a;
+            do {
+                i = idx;
+                a = atom(a_buf, i, a_size);
+            } while (a.index() < 0 && !atom::atom_table().acquire(a.index()));
+            idx = i;
+            if (a.index() == am::true_ || a.index() == am::false_)
+                new (this) eterm<Alloc>(a.index() == am::true_);
+            else {
+                // The reference was acquired above
+                m_type = ATOM;
+                vt.a   = a;
+            }
+            return;
+        }
+    }
+
     // check the type of next term:
     int type, sz;
 
@@ -180,17 +365,6 @@ void eterm<Alloc>::decode(const char* a_buf, int& idx, size_t a_size, const Allo
         throw err_decode_exception("Cannot determine term type", idx);
 
     switch (type) {
-    case ERL_ATOM_EXT: {
-        int b;
-        int i = idx; // TODO: Eliminate this variable when there's is a fix for the bug in ei_decode_boolean
-        if (ei_decode_boolean(a_buf, &i, &b) < 0)
-            new (this) eterm<Alloc>(atom(a_buf, idx, a_size));
-        else {
-            idx = i;
-            new (this) eterm<Alloc>((bool)b);
-        }
-        break;
-    }
     case ERL_LARGE_TUPLE_EXT:
     case ERL_SMALL_TUPLE_EXT: {
         new (this) eterm<Alloc>(tuple<Alloc>(a_buf, idx, a_size, a_alloc));
@@ -240,6 +414,10 @@ void eterm<Alloc>::decode(const char* a_buf, int& idx, size_t a_size, const Allo
         new (this) eterm<Alloc>(port<Alloc>(a_buf, idx, a_size, a_alloc));
         break;
 
+    case ERL_MAP_EXT:
+        new (this) eterm<Alloc>(map<Alloc>(a_buf, idx, a_size, a_alloc));
+        break;
+
     default:
         std::ostringstream oss;
         oss << "Unknown message content type " << type;
@@ -335,6 +513,32 @@ bool eterm<Alloc>::subst(eterm<Alloc>& out, const varbind<Alloc>* binding) const
     return visitor.apply_visitor(*this);
 }
 
+template <typename Alloc>
+const eterm<Alloc>& eterm<Alloc>::freeze() const
+{
+    switch (m_type) {
+        case TUPLE:
+        case TRACE:
+            for (auto& e : vt.t) e.freeze();
+            break;
+        case LIST:
+            for (auto& e : vt.l) e.freeze();
+            break;
+        case MAP:
+            for (size_t i=0, n=vt.m.size(); i < n; i++) {
+                vt.m.key(i).freeze();
+                vt.m.value(i).freeze();
+            }
+            break;
+        default:
+            break;
+    }
+    if (m_type >= STRING)
+        if (blob_base<Alloc>* p = shared_blob())
+            p->freeze();
+    return *this;
+}
+
 template <typename Alloc>
 eterm<Alloc> eterm<Alloc>::apply(const varbind<Alloc>& binding) const
     throw (err_invalid_term, err_unbound_variable)
@@ -75,6 +75,11 @@ namespace marshal {
                 return eterm<Alloc>(t);
             }
 
+            eterm<Alloc> to_map(Alloc& a_alloc) {
+                const eterm<Alloc>* items = (const eterm<Alloc>*)this->data();
+                return eterm<Alloc>(map<Alloc>(items, this->size() / 2, a_alloc));
+            }
+
             const eterm<Alloc>& operator[] (size_t idx) const {
                 return (const eterm<Alloc>&)*(base::begin()+idx);
             }
@@ -340,6 +345,38 @@ namespace marshal {
 
     } /* plist */
 
+    /// Parse the "K => V, ..." associations of a map following the opening
+    /// "#{". The ":=" operator is accepted as a synonym of "=>".
+    template <class Alloc>
+    static bool pmap(const char** fmt, va_list* pap,
+                     vector<Alloc>& v, Alloc& a_alloc)
+    {
+        while (true) {
+            skip_ws_and_comments(fmt);
+
+            if (**fmt == '}') {
+                (*fmt)++;
+                return true;
+            }
+            if (!v.empty()) {
+                if (**fmt != ',')
+                    return false;
+                (*fmt)++;
+            }
+
+            v.push_back(eformat(fmt, pap, a_alloc));
+            skip_ws_and_comments(fmt);
+
+            const char* p = *fmt;
+            if ((p[0] == '=' && p[1] == '>') || (p[0] == ':' && p[1] == '='))
+                *fmt += 2;
+            else
+                return false;
+
+            v.push_back(eformat(fmt, pap, a_alloc));
+        }
+    } /* pmap */
+
     template <class Alloc>
     static eterm<Alloc> eformat(const char** fmt, va_list* pap, const Alloc& a_alloc)
         throw (err_format_exception)
@@ -407,6 +444,12 @@ namespace marshal {
                 break;
             }
 
+            case '#':
+                if (*(*fmt)++ != '{' || !pmap(fmt, pap, v, alloc))
+                    throw err_format_exception("Error parsing map", *fmt);
+                ret = v.to_map(alloc);
+                break;
+
             case '$': /* char-value? */
                 ret = eterm<Alloc>((int)(*(*fmt)++));
                 break;
@@ -0,0 +1,246 @@
+//----------------------------------------------------------------------------
+/// \file  eterm_view.hpp
+//----------------------------------------------------------------------------
+/// \brief A read-only view of a term in Erlang external format that decodes
+///        its parts on demand.
+//----------------------------------------------------------------------------
+// Copyright (c) 2010 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+Copyright 2010 Serge Aleynikov <saleyn at gmail dot com>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+***** END LICENSE BLOCK *****
+*/
+
+#ifndef _EIXX_ETERM_VIEW_HPP_
+#define _EIXX_ETERM_VIEW_HPP_
+
+#include <iterator>
+#include <eixx/marshal/eterm.hpp>
+#include <eixx/marshal/packed_list.hpp>
+#include <ei.h>
+
+namespace eixx {
+namespace marshal {
+
+/**
+ * Read-only view of a term stored in Erlang external format.
+ *
+ * The view references the encoded bytes kept in a reference-counted
+ * binary, so it is cheap to copy and may outlive the buffer it was
+ * created from. Nothing is decoded until it is accessed: operator[] and
+ * iteration skip over the preceding siblings without decoding them, and
+ * the to_*() accessors decode only the term they are called on. Use
+ * to_eterm() to decode the whole term.
+ *
+ * Element access is O(N) in the index of the element, so a handler that
+ * reads most of a large term is better off converting it with to_eterm().
+ *
+ * Erlang encodes lists of bytes as strings (STRING_EXT), so the list
+ * accessors (operator[], iteration, to_list() and to_packed_list())
+ * accept a string too. Its elements are integer views of its bytes,
+ * which reference the buffer like any other view. Access to them is O(1).
+ */
+template <typename Alloc>
+class eterm_view {
+    binary<Alloc> m_buf;
+    uint32_t      m_offset;
+    eterm_type    m_type;
+    bool          m_byte;   // Element of a string: m_offset is that of the byte
+
+    struct byte_tag {};
+
+    /// View of the byte at \a a_offset of a string viewed as a list.
+    eterm_view(const binary<Alloc>& a_buf, size_t a_offset, byte_tag)
+        : m_buf(a_buf), m_offset(a_offset), m_type(LONG), m_byte(true)
+    {}
+
+    const char* buf() const { return m_buf.data(); }
+
+    void check(eterm_type tp) const {
+        if (unlikely(m_type != tp)) throw err_wrong_type(m_type, tp);
+    }
+
+    /// Type of the term at m_offset as it would be decoded into an eterm.
+    eterm_type decode_type() const throw(err_decode_exception);
+
+    /// Offset of the first element of a tuple, a list or a string.
+    int first() const;
+
+    /// Offset past the term starting at \a idx.
+    int skip(int idx) const throw(err_decode_exception) {
+        if (ei_skip_term(buf(), &idx) < 0 || (size_t)idx > m_buf.size())
+            throw err_decode_exception("Error skipping term", idx);
+        return idx;
+    }
+
+public:
+    class const_iterator;
+    typedef const_iterator iterator;
+
+    eterm_view() : m_offset(0), m_type(UNDEFINED), m_byte(false) {}
+
+    /**
+     * Create a view of the term located at \a a_offset in \a a_buf.
+     * The buffer is shared rather than copied.
+     */
+    explicit eterm_view(const binary<Alloc>& a_buf, size_t a_offset = 0)
+        throw(err_decode_exception)
+        : m_buf(a_buf), m_offset(a_offset), m_type(decode_type()), m_byte(false)
+    {}
+
+    /**
+     * Create a view of the term encoded in \a a_buf, which may start with
+     * the version byte. The bytes are referenced rather than copied when
+     * they are covered by a binary_slice_scope (whatever its threshold),
+     * or else copied.
+     */
+    eterm_view(const char* a_buf, size_t a_size, const Alloc& a_alloc = Alloc())
+        throw(err_decode_exception)
+        : eterm_view(binary_slice_scope<Alloc>::share(a_buf, a_size, a_alloc),
+            a_size > 0 && (uint8_t)a_buf[0] == ERL_VERSION_MAGIC ? 1 : 0)
+    {}
+
+    /// Create a view of the encoded term \a a_term.
+    explicit eterm_view(const eterm<Alloc>& a_term, const Alloc& a_alloc = Alloc())
+        : m_offset(0), m_type(a_term.type()), m_byte(false)
+    {
+        string<Alloc> s = a_term.encode(0, false);
+        m_buf = binary<Alloc>(s.c_str(), s.size(), a_alloc);
+    }
+
+    bool        empty()     const { return m_type == UNDEFINED; }
+    eterm_type  type()      const { return m_type; }
+
+    bool is_double() const { return m_type == DOUBLE; }
+    bool is_long()   const { return m_type == LONG  ; }
+    bool is_bool()   const { return m_type == BOOL  ; }
+    bool is_atom()   const { return m_type == ATOM  ; }
+    bool is_str()    const { return m_type == STRING; }
+    bool is_binary() const { return m_type == BINARY; }
+    bool is_pid()    const { return m_type == PID   ; }
+    bool is_port()   const { return m_type == PORT  ; }
+    bool is_ref()    const { return m_type == REF   ; }
+    bool is_tuple()  const { return m_type == TUPLE ; }
+    bool is_list()   const { return m_type == LIST  ; }
+    bool is_map()    const { return m_type == MAP   ; }
+
+    /// Pointer to the encoded term (without the version byte). For an element
+    /// of a string it's the byte itself.
+    const char* data()          const { return buf() + m_offset; }
+    /// Size of the encoded term in bytes.
+    size_t      encoded_size()  const {
+        return empty() ? 0 : m_byte ? 1 : skip(m_offset) - m_offset;
+    }
+
+    /// Arity of a tuple or a map, length of a list, or size of a string
+    /// or a binary.
+    size_t size() const;
+
+    /**
+     * Get the \a i-th element of a tuple, a list or a string.
+     * @throw err_wrong_type if the term is neither a tuple, a list nor a string.
+     * @throw err_bad_argument if \a i is out of range.
+     */
+    eterm_view operator[] (size_t i) const;
+
+    /// Iterate over the elements of a tuple, a list or a string.
+    const_iterator begin() const;
+    const_iterator end()   const { return const_iterator(); }
+
+    long            to_long()   const;
+    double          to_double() const;
+    bool            to_bool()   const;
+    atom            to_atom()   const;
+    string<Alloc>   to_str()    const { return to_eterm().to_str(); }
+    binary<Alloc>   to_binary() const;
+    epid<Alloc>     to_pid()    const { check(PID);   return to_eterm().to_pid();   }
+    port<Alloc>     to_port()   const { check(PORT);  return to_eterm().to_port();  }
+    ref<Alloc>      to_ref()    const { check(REF);   return to_eterm().to_ref();   }
+    tuple<Alloc>    to_tuple()  const { check(TUPLE); return to_eterm().to_tuple(); }
+    list<Alloc>     to_list()   const;
+    map<Alloc>      to_map()    const { check(MAP);   return to_eterm().to_map();   }
+
+    /// Decode a list of numbers without converting its elements to eterms.
+    /// Erlang sends lists of bytes as strings, which are accepted as well.
+    template <typename T>
+    packed_list<T, Alloc> to_packed_list() const throw(err_decode_exception) {
+        if (m_type != STRING) check(LIST);
+        int idx = m_offset;
+        return packed_list<T, Alloc>(buf(), idx, m_buf.size(), m_buf.get_allocator());
+    }
+
+    /// Decode the term using the allocator of the underlying buffer.
+    eterm<Alloc> to_eterm() const throw(err_decode_exception) {
+        return to_eterm(m_buf.get_allocator());
+    }
+
+    /// Decode the term using \a a_alloc. Large binaries contained in the
+    /// term reference the view's storage instead of copying it.
+    eterm<Alloc> to_eterm(const Alloc& a_alloc) const throw(err_decode_exception);
+
+    std::string to_string() const { return empty() ? std::string() : to_eterm().to_string(); }
+};
+
+template <typename Alloc>
+class eterm_view<Alloc>::const_iterator
+    : public std::iterator<std::forward_iterator_tag, eterm_view<Alloc>>
+{
+    eterm_view<Alloc> m_cur;
+    size_t            m_left;
+
+    friend class eterm_view<Alloc>;
+
+    const_iterator(const eterm_view<Alloc>& a_first, size_t a_count)
+        : m_cur(a_first), m_left(a_count) {}
+public:
+    const_iterator() : m_left(0) {}
+
+    const eterm_view<Alloc>& operator*()  const { return m_cur;  }
+    const eterm_view<Alloc>* operator->() const { return &m_cur; }
+
+    const_iterator& operator++() {
+        if (--m_left > 0) {
+            if (m_cur.m_byte)
+                m_cur.m_offset++;
+            else
+                m_cur = eterm_view<Alloc>(m_cur.m_buf, m_cur.skip(m_cur.m_offset));
+        }
+        return *this;
+    }
+    const_iterator operator++(int) { const_iterator it(*this); ++*this; return it; }
+
+    bool operator==(const const_iterator& rhs) const {
+        return m_left == rhs.m_left && (m_left == 0 || m_cur.m_offset == rhs.m_cur.m_offset);
+    }
+    bool operator!=(const const_iterator& rhs) const { return !(*this == rhs); }
+};
+
+} // namespace marshal
+} // namespace eixx
+
+namespace std {
+    template <typename Alloc>
+    ostream& operator<< (ostream& out, const eixx::marshal::eterm_view<Alloc>& a_view) {
+        return out << a_view.to_string();
+    }
+}
+
+#include <eixx/marshal/eterm_view.hxx>
+
+#endif // _EIXX_ETERM_VIEW_HPP_
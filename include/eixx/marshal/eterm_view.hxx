@@ -0,0 +1,233 @@
+//----------------------------------------------------------------------------
+/// \file  eterm_view.hxx
+//----------------------------------------------------------------------------
+/// \brief Implementation of eterm_view member functions.
+//----------------------------------------------------------------------------
+// Copyright (c) 2010 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+Copyright 2010 Serge Aleynikov <saleyn at gmail dot com>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+***** END LICENSE BLOCK *****
+*/
+#include <string.h>
+#include <sstream>
+#include <ei.h>
+
+namespace eixx {
+namespace marshal {
+
+template <typename Alloc>
+eterm_type eterm_view<Alloc>::decode_type() const throw(err_decode_exception)
+{
+    int type, sz, idx = m_offset;
+    if (m_offset >= m_buf.size())
+        throw err_decode_exception("Cannot determine term type", idx);
+
+    // Atoms are told from booleans by their name, so that the type of
+    // a view is known without adding the atom to the atom table
+    const char* s   = buf() + idx;
+    size_t      len = 0;
+    switch ((uint8_t)*s) {
+        case ERL_ATOM_EXT:
+        case ERL_ATOM_UTF8_EXT:
+            if (m_offset + 3 > m_buf.size())
+                throw err_decode_exception("Error decoding atom", idx);
+            s++; len = get16be(s);
+            break;
+        case ERL_SMALL_ATOM_EXT:
+        case ERL_SMALL_ATOM_UTF8_EXT:
+            if (m_offset + 2 > m_buf.size())
+                throw err_decode_exception("Error decoding atom", idx);
+            s++; len = get8(s);
+            break;
+        case ERL_ATOM_CACHE_REF: {
+            // Cached atoms are already in the atom table
+            int n = atom(buf(), idx, m_buf.size()).index();
+            return n == am::true_ || n == am::false_ ? BOOL : ATOM;
+        }
+        default:
+            s = NULL;
+    }
+    if (s) {
+        if (s + len > buf() + m_buf.size())
+            throw err_decode_exception("Error decoding atom", idx);
+        return (len == 4 && memcmp(s, "true",  4) == 0) ||
+               (len == 5 && memcmp(s, "false", 5) == 0) ? BOOL : ATOM;
+    }
+
+    if (ei_get_type(buf(), &idx, &type, &sz) < 0)
+        throw err_decode_exception("Cannot determine term type", idx);
+
+    switch (type) {
+        case ERL_SMALL_INTEGER_EXT:
+        case ERL_INTEGER_EXT:
+        case ERL_SMALL_BIG_EXT:
+        case ERL_LARGE_BIG_EXT:     return LONG;
+        case NEW_FLOAT_EXT:
+        case ERL_FLOAT_EXT:         return DOUBLE;
+        case ERL_SMALL_TUPLE_EXT:
+        case ERL_LARGE_TUPLE_EXT:   return TUPLE;
+        case ERL_STRING_EXT:        return STRING;
+        case ERL_LIST_EXT:
+        case ERL_NIL_EXT:           return LIST;
+        case ERL_BINARY_EXT:        return BINARY;
+        case ERL_PID_EXT:           return PID;
+        case ERL_PORT_EXT:          return PORT;
+        case ERL_REFERENCE_EXT:
+        case ERL_NEW_REFERENCE_EXT: return REF;
+        case ERL_MAP_EXT:           return MAP;
+        default: {
+            std::ostringstream oss;
+            oss << "Unknown message content type " << type;
+            throw err_decode_exception(oss.str(), idx);
+        }
+    }
+}
+
+template <typename Alloc>
+int eterm_view<Alloc>::first() const
+{
+    int idx = m_offset, arity;
+    if (m_type == STRING)
+        return idx + 3;
+    if (m_type == TUPLE)
+        ei_decode_tuple_header(buf(), &idx, &arity);
+    else
+        ei_decode_list_header(buf(), &idx, &arity);
+    return idx;
+}
+
+template <typename Alloc>
+size_t eterm_view<Alloc>::size() const
+{
+    int type, sz, idx = m_offset;
+    switch (m_type) {
+        case TUPLE:
+        case LIST:
+        case MAP:
+        case STRING:
+        case BINARY:
+            ei_get_type(buf(), &idx, &type, &sz);
+            return type == ERL_NIL_EXT ? 0 : sz;
+        default:
+            throw err_wrong_type(m_type, "TUPLE|LIST|MAP|STRING|BINARY");
+    }
+}
+
+template <typename Alloc>
+eterm_view<Alloc> eterm_view<Alloc>::operator[] (size_t i) const
+{
+    if (m_type != TUPLE && m_type != LIST && m_type != STRING)
+        throw err_wrong_type(m_type, "TUPLE|LIST|STRING");
+    if (i >= size())
+        throw err_bad_argument("Index out of bounds", i);
+    if (m_type == STRING)
+        return eterm_view<Alloc>(m_buf, first() + i, byte_tag());
+    int idx = first();
+    while (i--)
+        idx = skip(idx);
+    return eterm_view<Alloc>(m_buf, idx);
+}
+
+template <typename Alloc>
+typename eterm_view<Alloc>::const_iterator eterm_view<Alloc>::begin() const
+{
+    if (m_type != TUPLE && m_type != LIST && m_type != STRING)
+        throw err_wrong_type(m_type, "TUPLE|LIST|STRING");
+    size_t n = size();
+    if (!n)
+        return end();
+    return m_type == STRING
+         ? const_iterator(eterm_view<Alloc>(m_buf, first(), byte_tag()), n)
+         : const_iterator(eterm_view<Alloc>(m_buf, first()), n);
+}
+
+template <typename Alloc>
+long eterm_view<Alloc>::to_long() const
+{
+    check(LONG);
+    if (m_byte)
+        return (uint8_t)buf()[m_offset];
+    int idx = m_offset;
+    long long n;
+    if (ei_decode_longlong(buf(), &idx, &n) < 0)
+        throw err_decode_exception("Failed decoding long value", idx);
+    return n;
+}
+
+template <typename Alloc>
+double eterm_view<Alloc>::to_double() const
+{
+    check(DOUBLE);
+    int idx = m_offset;
+    double d;
+    if (ei_decode_double(buf(), &idx, &d) < 0)
+        throw err_decode_exception("Failed decoding double value", idx);
+    return d;
+}
+
+template <typename Alloc>
+bool eterm_view<Alloc>::to_bool() const
+{
+    check(BOOL);
+    int idx = m_offset;
+    return atom(buf(), idx, m_buf.size()).index() == am::true_;
+}
+
+template <typename Alloc>
+atom eterm_view<Alloc>::to_atom() const
+{
+    check(ATOM);
+    int idx = m_offset;
+    return atom(buf(), idx, m_buf.size());
+}
+
+template <typename Alloc>
+list<Alloc> eterm_view<Alloc>::to_list() const
+{
+    if (m_type != STRING) {
+        check(LIST);
+        return to_eterm().to_list();
+    }
+    return list<Alloc>::from_chars(buf() + first(), size(), m_buf.get_allocator());
+}
+
+template <typename Alloc>
+binary<Alloc> eterm_view<Alloc>::to_binary() const
+{
+    check(BINARY);
+    int idx = m_offset;
+    binary_slice_scope<Alloc> scope(m_buf);
+    return binary<Alloc>(buf(), idx, m_buf.size(), m_buf.get_allocator());
+}
+
+template <typename Alloc>
+eterm<Alloc> eterm_view<Alloc>::to_eterm(const Alloc& a_alloc) const throw(err_decode_exception)
+{
+    if (empty())
+        return eterm<Alloc>();
+    if (m_byte)
+        return eterm<Alloc>(to_long());
+    int idx = m_offset;
+    binary_slice_scope<Alloc> scope(m_buf);
+    return eterm<Alloc>(buf(), idx, m_buf.size(), a_alloc);
+}
+
+} // namespace marshal
+} // namespace eixx
@@ -29,6 +29,8 @@ limitations under the License.
 #ifndef _IMPL_LIST_HPP_
 #define _IMPL_LIST_HPP_
 
+#include <cstddef>
+#include <iterator>
 #include <list>
 #include <boost/static_assert.hpp>
 #include <eixx/marshal/defaults.hpp>
@@ -58,80 +60,188 @@ private:
             , alloc_size (0)
             , size       (0)
             , tail       (nullptr)
+            , chunks     (nullptr)
+            , free_cell  (nullptr)
+            , end_cell   (nullptr)
         {}
         bool            initialized;
         unsigned int    alloc_size;
         unsigned int    size;
         cons_t*         tail;
+        blob<char, Alloc>* chunks;  // Overflow chunks, the newest first
+        cons_t*         free_cell;  // Next unused cell of the newest chunk
+        cons_t*         end_cell;   // End of the newest chunk
         cons_t          head[0];
     };
 
     typedef blob<char, Alloc> blob_t;
 
+    /// Overflow cells appended after the header's array is filled up are
+    /// allocated in chunks that grow geometrically.
+    struct chunk_t {
+        blob_t*         next;
+        cons_t          cells[0];
+    };
+
+    static chunk_t* chunk(blob_t* p) { return reinterpret_cast<chunk_t*>(p->data()); }
+
+    /// Allocate a header for an open list with room for \a n cells.
+    void create(size_t n, const Alloc& alloc) {
+        m_blob = blob_t::create(sizeof(header_t) + n*sizeof(cons_t), alloc);
+        header_t* hdr      = header();
+        hdr->initialized   = false;
+        hdr->alloc_size    = n;
+        hdr->size          = 0;
+        hdr->tail          = NULL;
+        hdr->chunks        = NULL;
+        hdr->free_cell     = NULL;
+        hdr->end_cell      = NULL;
+    }
+
+    /// Number of cells that can be appended without an allocation.
+    size_t room() const {
+        const header_t* hd = header();
+        return head_room() + (hd->end_cell - hd->free_cell);
+    }
+
+    /// Number of unused cells in the header's array.
+    size_t head_room() const {
+        const header_t* hd = header();
+        return hd->size < hd->alloc_size ? hd->alloc_size - hd->size : 0;
+    }
+
+    /// Add an overflow chunk of \a n cells that the following push_back()
+    /// calls take their cells from.
+    void add_chunk(size_t n);
+
+    /// A tail of another list. It references the cells of the list that
+    /// owns them, which is kept alive while the view is referenced.
+    struct view_t {
+        blob_t*         parent;
+        const cons_t*   head;
+        unsigned int    size;
+    };
+
+    typedef blob<view_t, Alloc> view_blob_t;
+
+    /// Blobs are aligned, so the lowest bits of a blob pointer are clear.
+    /// When the VIEW bit is set, the pointer refers to a view_blob_t.
+    /// The lowest bit is never set (see eterm::shared_blob()).
+    enum { VIEW = 2, TAG_MASK = 3 };
+
     blob_t* m_blob;
 
+    bool is_view() const { return reinterpret_cast<uintptr_t>(m_blob) & VIEW; }
+    view_blob_t* view_ptr() const {
+        return reinterpret_cast<view_blob_t*>(
+            reinterpret_cast<uintptr_t>(m_blob) & ~uintptr_t(TAG_MASK));
+    }
+    const view_t& view() const { return *view_ptr()->data(); }
+
+    /// Reference-counted storage of this list or NULL.
+    blob_base<Alloc>* shared() const {
+        return is_view() ? static_cast<blob_base<Alloc>*>(view_ptr()) : m_blob;
+    }
+    /// Blob owning the list's cells.
+    blob_t* owner() const { return is_view() ? view().parent : m_blob; }
+
     /// Returns a pointer to a singleton empty list
     static blob_t* empty_list() {
         auto creator = []() {
-            auto p = new blob_t(sizeof(header_t));
+            auto p = blob_t::create(sizeof(header_t));
             auto h = reinterpret_cast<header_t*>(p->data());
             new (h) header_t(nullptr);
+            p->freeze();
             return p;
         };
-        static std::unique_ptr<blob_t> s_empty(creator());
-        return s_empty.get();
+        static blob_t* s_empty = creator();
+        return s_empty;
     }
 
+    /// Returns a new reference to the singleton empty list
+    static blob_t* acquire_empty_list() {
+        blob_t* p = empty_list();
+        p->inc_rc();
+        return p;
+    }
+
+    /// Header of the list owning the cells, which for a view is the header
+    /// of the list it's a tail of.
     header_t* header() {
-        BOOST_ASSERT(m_blob); return reinterpret_cast<header_t*>(m_blob->data());
+        BOOST_ASSERT(m_blob); return reinterpret_cast<header_t*>(owner()->data());
     }
     const header_t* header() const {
-        BOOST_ASSERT(m_blob); return reinterpret_cast<const header_t*>(m_blob->data());
+        BOOST_ASSERT(m_blob); return reinterpret_cast<const header_t*>(owner()->data());
     }
-    const cons_t* head() const    { return header()->head; }
-    cons_t*       head()          { return header()->head; }
+    const cons_t* head() const    { return is_view() ? view().head : header()->head; }
+    cons_t*       head()          { return const_cast<cons_t*>(static_cast<const list*>(this)->head()); }
     cons_t*       tail()          { return header()->tail; }
 
     void release() {
-        if (!m_blob || m_blob == empty_list())
-           return;
-        if (m_blob->release(false)) {
-            header_t* l_header = header();
-            if (l_header->size > 0) {
-                for (cons_t* p = head(); p; p = p->next)
-                    p->node.~eterm();
-                // If there were any allocations after the original 
-                // construction of the list head descriptor, deallocate
-                // all the following cons.
-                if (l_header->alloc_size > 0 && l_header->size > l_header->alloc_size) 
-                    for (cons_t* p = (l_header->head + l_header->alloc_size - 1)->next, *q; p; p = q) {
-                        q = p->next;
-                        this->get_t_allocator().deallocate(p, 1);
-                    }
-            }
-            m_blob->free();
+        blob_base<Alloc>* p = shared();
+        if (p && p->dec_rc())
+            free_blob();
+    }
+
+    /// Destroy the list's content and free its storage after the reference
+    /// count dropped to 0. A view releases the list it's a tail of.
+    void free_blob() {
+        if (is_view()) {
+            view_blob_t* v = view_ptr();
+            blob_t* parent = v->data()->parent;
+            if (parent->dec_rc())
+                free_cells(parent);
+            v->free();
+        } else
+            free_cells(m_blob);
+    }
+
+    static void free_cells(blob_t* a_blob) {
+        header_t* l_header = reinterpret_cast<header_t*>(a_blob->data());
+        if (l_header->size > 0)
+            for (cons_t* p = l_header->head; p; p = p->next)
+                p->node.~eterm();
+        // Cells allocated after the original construction of the list
+        // head descriptor are freed chunk by chunk.
+        for (blob_t* p = l_header->chunks, *q; p; p = q) {
+            q = chunk(p)->next;
+            p->release();
         }
+        a_blob->free();
     }
 
+    friend class eterm<Alloc>;
+
     // For use only from constructors.
     void init(const eterm<Alloc> items[], size_t a_size, const Alloc& alloc);
 public:
     class iterator;
     typedef const iterator const_iterator;
+    class contiguous_iterator;
 
-    iterator begin()             { iterator it(empty() ? NULL : head()); return it; }
+    iterator begin()             {
+        // The elements may be modified through the iterator
+        if (m_blob) { shared()->reset_hash(); owner()->reset_hash(); }
+        iterator it(empty() ? NULL : head()); return it;
+    }
     iterator end()               { return iterator::end(); }
 
     const_iterator begin() const { const_iterator it(empty() ? NULL : head()); return it; }
     const_iterator end()   const { return iterator::end(); }
 
+    /// Random access iterators over the elements of a contiguous() list.
+    /// @throws err_bad_argument if the list isn't contiguous.
+    contiguous_iterator contiguous_begin() const throw(err_bad_argument);
+    /// @copydoc list::contiguous_begin
+    contiguous_iterator contiguous_end()   const throw(err_bad_argument);
+
     explicit list(const Alloc& alloc = Alloc())
         : base_t(alloc)
         , m_blob(NULL)
     {}
 
     /// Construct an NIL list (initialized list with no elements)
-    explicit list(std::nullptr_t) : m_blob(empty_list()) {}
+    explicit list(std::nullptr_t) : m_blob(acquire_empty_list()) {}
 
     /// Construct a list with a given estimated size.
     ///
@@ -141,20 +251,14 @@ public:
         : base_t(alloc)
     {
         if (a_estimated_size == 0)
-            m_blob = empty_list();
-        else {
-            m_blob = new blob_t(sizeof(header_t) + a_estimated_size*sizeof(cons_t), alloc);
-            header_t* hdr      = header();
-            hdr->initialized   = a_estimated_size == 0;
-            hdr->alloc_size    = a_estimated_size;
-            hdr->size          = 0;
-            hdr->tail          = NULL;
-        }
+            m_blob = acquire_empty_list();
+        else
+            create(a_estimated_size, alloc);
     }
 
     list(const list<Alloc>& a) : base_t(a.get_allocator()), m_blob(a.m_blob) {
         BOOST_ASSERT(a.initialized());
-        if (m_blob) m_blob->inc_rc();
+        if (m_blob) shared()->inc_rc();
     } 
 
     list(list<Alloc>&& a) : base_t(a.get_allocator()), m_blob(a.m_blob) {
@@ -196,42 +300,71 @@ public:
         push_back(t);
     }
 
+    /**
+     * Make room for appending terms to an open list, so that it can hold
+     * \a n elements without further allocations.
+     */
+    void reserve(size_t n) throw(err_bad_argument);
+
     /**
      * Closes the list.
      * A list must be closed before it can be copied or included into other terms.
      */
     void    close() {
-        if (!m_blob || m_blob == empty_list()) return;
+        if (!m_blob || m_blob == empty_list() || is_view()) return;
         header()->initialized = true;
     }
 
     /// Return list length. This method has O(1) complexity.
-    size_t  length()        const { return  m_blob ?  header()->size :  0; }
-    bool    empty()         const { return !m_blob || header()->size == 0; }
+    size_t  length()        const {
+        return !m_blob ? 0 : is_view() ? view().size : header()->size;
+    }
+    bool    empty()         const { return length() == 0; }
     bool    initialized()   const { return  m_blob && header()->initialized; }
 
+    /// True if all cells of the list are stored in one array, which is the
+    /// case for decoded lists, lists that didn't grow past the size
+    /// they were created with, and tails of such lists. Elements of such a list are accessed in
+    /// constant time.
+    bool    contiguous()    const { return !m_blob || header()->size <= header()->alloc_size; }
+
     /// Return pointer to the N'th element in the list. This method has
-    /// O(N) complexity.
+    /// O(1) complexity if the list is contiguous() and O(N) otherwise.
     const eterm<Alloc>& nth(size_t n) const throw(err_bad_argument) {
-        if (n > length())
+        if (n >= length())
             throw err_bad_argument("Index out of bounds", n);
+        if (contiguous())
+            return head()[n].node;
         size_t i = 0;
         auto it = begin();
         for(auto endit = end(); it != endit && i < n; ++it, ++i);
         return *it;
     }
 
+    /// @copydoc list::nth
+    const eterm<Alloc>& operator[] (size_t n) const throw(err_bad_argument) {
+        return nth(n);
+    }
+
+    /// Return the list of elements following the \a idx'th one. The result
+    /// shares the cells of this list, so this method has O(1) complexity
+    /// if the list is contiguous() and O(idx) otherwise.
+    /// @throws err_bad_argument if the list is not closed.
     list<Alloc> tail(size_t idx) const throw(err_bad_argument);
 
     list<Alloc>& operator= (const list<Alloc>& rhs) {
         BOOST_ASSERT(rhs.initialized());
         release();
         m_blob = rhs.m_blob;
-        if (m_blob) m_blob->inc_rc();
+        if (m_blob) shared()->inc_rc();
         return *this;
     }
 
     bool operator== (const list<Alloc>& rhs) const {
+        if (m_blob == rhs.m_blob)
+            return true;
+        if (length() != rhs.length())
+            return false;
         const_iterator it1  = begin(), it2  = rhs.begin(),
                        end1 = end(),   end2 = rhs.end();
         for(; it1 != end1 && it2 != end2; ++it1, ++it2) {
@@ -241,13 +374,38 @@ public:
         return it1 == end1 && it2 == end2;
     }
 
+    /// Hash value of the list's elements. It is cached in the list's
+    /// storage once the list is closed, unless an element can be changed
+    /// in place through another term sharing it. The hash of a tail isn't
+    /// cached, since its cells can be changed through the parent list.
+    uint32_t hash() const {
+        if (m_blob)
+            if (uint32_t h = shared()->cached_hash())
+                return h;
+        uint32_t h = length();
+        bool cache = initialized() && !is_view();
+        for (const_iterator it = begin(), iend = end(); it != iend; ++it) {
+            h = eixx::detail::hash_combine(h, it->hash());
+            cache &= !is_mutable_type(it->type());
+        }
+        h = detail::nonzero_hash(h);
+        if (cache)
+            shared()->cache_hash(h);
+        return h;
+    }
+
+    /// True if the list is encoded as a STRING_EXT, which is the case for
+    /// lists of up to 65535 integers in the range 0..255 (see eterm::is_byte()).
+    bool is_byte_list() const;
+
     size_t encode_size() const {
         if (length() == 0)
             return 1;
+        if (is_byte_list())
+            return 3 + length();
         size_t result = 5 + 1 /* 1 byte for ERL_NIL_EXT */;
-        const header_t* hd = header();
-        BOOST_ASSERT(hd->initialized);
-        for (const cons_t* it=hd->head; it != NULL; it = it->next) {
+        BOOST_ASSERT(initialized());
+        for (const cons_t* it=head(); it != NULL; it = it->next) {
             visit_eterm_encode_size_calc<Alloc> visitor;
             result += visitor.apply_visitor(it->node);
         }
@@ -268,6 +426,10 @@ public:
         return list<Alloc>(0, a);
     }
 
+    /// List of the codes of the \a n characters at \a s, which is the list
+    /// a string of these characters is equal to.
+    static list<Alloc> from_chars(const char* s, size_t n, const Alloc& a = Alloc());
+
     template <class T1>
     static list<Alloc> make(T1 t1, const Alloc& a = Alloc()) {
         eterm<Alloc> l[] = { eterm<Alloc>::cast(t1) };
@@ -352,10 +514,17 @@ public:
     }
 };
 
+/// List iterator, which moves forward by following the cells.
 template <typename Alloc>
 class list<Alloc>::iterator {
     mutable cons_t* cursor;
 public:
+    typedef std::forward_iterator_tag   iterator_category;
+    typedef eterm<Alloc>                value_type;
+    typedef ptrdiff_t                   difference_type;
+    typedef eterm<Alloc>*               pointer;
+    typedef eterm<Alloc>&               reference;
+
     iterator(const cons_t* a_cur) : cursor(const_cast<cons_t*>(a_cur)) {}
     static iterator end() { iterator it(NULL); return it; }
     iterator&       operator++()        { cursor = cursor->next; return *this; }
@@ -370,6 +539,61 @@ public:
     bool            operator!=(const iterator& rhs) const { return cursor != rhs.cursor; }
 };
 
+/// Iterator over the elements of a contiguous list (see list::contiguous()),
+/// whose cells are stored in one array, so that it moves by any distance
+/// in constant time.
+template <typename Alloc>
+class list<Alloc>::contiguous_iterator {
+    const cons_t* m_cell;
+public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef eterm<Alloc>                    value_type;
+    typedef ptrdiff_t                       difference_type;
+    typedef const eterm<Alloc>*             pointer;
+    typedef const eterm<Alloc>&             reference;
+
+    contiguous_iterator() : m_cell(NULL) {}
+    explicit contiguous_iterator(const cons_t* a_cell) : m_cell(a_cell) {}
+
+    reference operator*()               const { return m_cell->node; }
+    pointer   operator->()              const { return &m_cell->node; }
+    reference operator[](ptrdiff_t n)   const { return m_cell[n].node; }
+
+    contiguous_iterator& operator++()         { ++m_cell; return *this; }
+    contiguous_iterator& operator--()         { --m_cell; return *this; }
+    contiguous_iterator  operator++(int)      { contiguous_iterator it(*this); ++m_cell; return it; }
+    contiguous_iterator  operator--(int)      { contiguous_iterator it(*this); --m_cell; return it; }
+    contiguous_iterator& operator+=(ptrdiff_t n) { m_cell += n; return *this; }
+    contiguous_iterator& operator-=(ptrdiff_t n) { m_cell -= n; return *this; }
+    contiguous_iterator  operator+ (ptrdiff_t n) const { return contiguous_iterator(m_cell + n); }
+    contiguous_iterator  operator- (ptrdiff_t n) const { return contiguous_iterator(m_cell - n); }
+    friend contiguous_iterator operator+(ptrdiff_t n, const contiguous_iterator& it) { return it + n; }
+    ptrdiff_t operator-(const contiguous_iterator& rhs) const { return m_cell - rhs.m_cell; }
+
+    bool operator==(const contiguous_iterator& rhs) const { return m_cell == rhs.m_cell; }
+    bool operator!=(const contiguous_iterator& rhs) const { return m_cell != rhs.m_cell; }
+    bool operator< (const contiguous_iterator& rhs) const { return m_cell <  rhs.m_cell; }
+    bool operator> (const contiguous_iterator& rhs) const { return m_cell >  rhs.m_cell; }
+    bool operator<=(const contiguous_iterator& rhs) const { return m_cell <= rhs.m_cell; }
+    bool operator>=(const contiguous_iterator& rhs) const { return m_cell >= rhs.m_cell; }
+};
+
+template <typename Alloc>
+typename list<Alloc>::contiguous_iterator list<Alloc>::contiguous_begin() const
+    throw(err_bad_argument)
+{
+    if (!contiguous())
+        throw err_bad_argument("List is not contiguous");
+    return contiguous_iterator(empty() ? NULL : head());
+}
+
+template <typename Alloc>
+typename list<Alloc>::contiguous_iterator list<Alloc>::contiguous_end() const
+    throw(err_bad_argument)
+{
+    return contiguous_begin() + length();
+}
+
 } // namespace marshal
 } // namespace eixx
 
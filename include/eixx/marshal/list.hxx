@@ -27,6 +27,7 @@ limitations under the License.
 */
 #pragma once
 
+#include <algorithm>
 #include <eixx/marshal/endian.hpp>
 #include <eixx/marshal/visit_to_string.hpp>
 #include <eixx/marshal/visit_encode_size.hpp>
@@ -40,7 +41,7 @@ namespace marshal {
 template <class Alloc>
 void list<Alloc>::init(const eterm<Alloc>* items, size_t N, const Alloc& alloc) {
     size_t n = N > 0 ? N : 1;
-    m_blob = new blob_t(sizeof(header_t) + n*sizeof(cons_t), alloc);
+    m_blob = blob_t::create(sizeof(header_t) + n*sizeof(cons_t), alloc);
 
     header_t* l_header      = header();
     cons_t*   hd            = l_header->head;
@@ -48,6 +49,7 @@ void list<Alloc>::init(const eterm<Alloc>* items, size_t N, const Alloc& alloc)
     l_header->initialized   = true;
     l_header->alloc_size    = n;
     l_header->size          = N;
+    l_header->chunks        = NULL;
 
     for(auto p = items, end = items+N; p != end; ++p, ++hd) {
         BOOST_ASSERT(p->initialized());
@@ -81,15 +83,16 @@ list<Alloc>::list(const cons_t* a_head, int a_len, const Alloc& alloc)
 
     // If this is an empty list - no allocation is needed
     if (alloc_size == 0) {
-        m_blob = empty_list();
+        m_blob = acquire_empty_list();
         return;
     }
 
-    m_blob = new blob_t(sizeof(header_t) + alloc_size*sizeof(cons_t), alloc);
+    m_blob = blob_t::create(sizeof(header_t) + alloc_size*sizeof(cons_t), alloc);
     header_t* l_header      = header();
     l_header->initialized   = true;
     l_header->alloc_size    = alloc_size;
     l_header->size          = alloc_size;
+    l_header->chunks        = NULL;
     if (alloc_size == 0)
         l_header->tail = NULL;
     else {
@@ -113,15 +116,16 @@ list<Alloc>::list(const char *buf, int& idx, size_t size, const Alloc& a_alloc)
 
     // If this is an empty list - no allocation is needed
     if (arity == 0) {
-        m_blob = empty_list();
+        m_blob = acquire_empty_list();
         return;
     }
 
-    m_blob = new blob_t(sizeof(header_t) + arity*sizeof(cons_t), a_alloc);
+    m_blob = blob_t::create(sizeof(header_t) + arity*sizeof(cons_t), a_alloc);
     header_t* l_header = header();
     l_header->initialized = true;
     l_header->alloc_size  = arity;
     l_header->size        = arity;
+    l_header->chunks      = NULL;
 
     cons_t* hd = l_header->head;
     for (cons_t* end = hd+arity; hd != end; ++hd) {
@@ -141,6 +145,43 @@ list<Alloc>::list(const char *buf, int& idx, size_t size, const Alloc& a_alloc)
     BOOST_ASSERT((size_t)idx <= size);
 }
 
+template <class Alloc>
+list<Alloc> list<Alloc>::from_chars(const char* s, size_t n, const Alloc& a)
+{
+    list<Alloc> l((int)n, a);
+    for (const char* end = s + n; s != end; ++s)
+        l.push_back(eterm<Alloc>((long)(unsigned char)*s));
+    if (n)
+        l.close();
+    return l;
+}
+
+template <class Alloc>
+bool list<Alloc>::is_byte_list() const
+{
+    size_t n = length();
+    if (n == 0 || n > 0xFFFF)
+        return false;
+    const cons_t* p = head();
+    if (contiguous()) {
+        // The cells are scanned in blocks without branching on each
+        // element, so that the compiler can vectorize the scan.
+        const size_t block = 16;
+        for (size_t i=0; i < n; i += block) {
+            bool bytes = true;
+            for (size_t j=i, e = std::min(n, i+block); j < e; j++)
+                bytes &= p[j].node.is_byte();
+            if (!bytes)
+                return false;
+        }
+        return true;
+    }
+    for (; p; p = p->next)
+        if (!p->node.is_byte())
+            return false;
+    return true;
+}
+
 template <class Alloc>
 void list<Alloc>::encode(char* buf, int& idx, size_t size) const
 {
@@ -148,12 +189,18 @@ void list<Alloc>::encode(char* buf, int& idx, size_t size) const
     char* s = buf + idx;
     if (empty()) {
         put8(s,ERL_NIL_EXT);
+    } else if (is_byte_list()) {
+        // Erlang encodes lists of bytes as strings
+        put8(s,ERL_STRING_EXT);
+        put16be(s,length());
+        for(const cons_t* p = head(); p; p = p->next)
+            put8(s,p->node.to_long());
+        idx += 2 + length();
     } else {
         put8(s,ERL_LIST_EXT);
-        const header_t* l_header = header();
-        put32be(s,l_header->size);
+        put32be(s,length());
         idx += 5;
-        for(const cons_t* p = l_header->head; p; p = p->next) {
+        for(const cons_t* p = head(); p; p = p->next) {
             visit_eterm_encoder visitor(buf, idx, size);
             visitor.apply_visitor(p->node);
         }
@@ -167,37 +214,59 @@ void list<Alloc>::encode(char* buf, int& idx, size_t size) const
 template <class Alloc>
 list<Alloc> list<Alloc>::tail(size_t idx) const throw(err_bad_argument)
 {
-    const header_t* l_header = header();
-    const cons_t* p = l_header->head;
-    int len = (int)l_header->size - (int)idx - 1;
-    if (len < 0)
+    // Cells appended to an open list would be chained past the tail's end
+    if (unlikely(!initialized()))
+        throw err_bad_argument("List not initialized!");
+    size_t n = length();
+    if (idx >= n)
         throw err_bad_argument("List too short");
-    for (size_t i=0; i <= idx; i++)
-        p = p->next;
-    list<Alloc> l(p, len, this->get_allocator());
+    list<Alloc> l(this->get_allocator());
+    if (idx + 1 == n) {
+        l.m_blob = acquire_empty_list();
+        return l;
+    }
+    const cons_t* p = head();
+    if (contiguous())
+        p += idx + 1;
+    else
+        for (size_t i=0; i <= idx; i++)
+            p = p->next;
+    blob_t*      parent = owner();
+    view_blob_t* v      = view_blob_t::create(1, this->get_allocator());
+    new (v->data()) view_t{parent, p, (unsigned int)(n - idx - 1)};
+    parent->inc_rc();
+    l.m_blob = reinterpret_cast<blob_t*>(reinterpret_cast<uintptr_t>(v) | VIEW);
     return l;
 }
 
+template <class Alloc>
+void list<Alloc>::add_chunk(size_t n)
+{
+    header_t* hd = header();
+    blob_t*   p  = blob_t::create(sizeof(chunk_t) + n*sizeof(cons_t), this->get_allocator());
+    chunk(p)->next = hd->chunks;
+    hd->chunks     = p;
+    hd->free_cell  = chunk(p)->cells;
+    hd->end_cell   = chunk(p)->cells + n;
+}
+
 template <class Alloc>
 void list<Alloc>::push_back(const eterm<Alloc>& a)
 {
     BOOST_ASSERT(a.initialized());
-    if (unlikely(!m_blob)) {
-        m_blob = new blob_t(sizeof(header_t) + sizeof(cons_t), this->get_allocator());
-        header_t* hd = header();
-        hd->initialized = false;
-        hd->tail = hd->head;
-        hd->size = 1;
-        hd->alloc_size = 1;
-        cons_t* p = hd->tail;
-        p->node.set(a);
-        p->next = NULL;
-        return;
-    }
+    if (unlikely(!m_blob))
+        create(1, this->get_allocator());
     BOOST_ASSERT(!initialized());
     header_t* hd = header();
-    bool has_space = hd->size < hd->alloc_size;
-    cons_t* p = has_space ? &hd->head[hd->size] : this->get_t_allocator().allocate(1);
+    cons_t* p;
+    if (hd->size < hd->alloc_size)
+        p = &hd->head[hd->size];
+    else {
+        // Each chunk doubles the list's capacity
+        if (hd->free_cell == hd->end_cell)
+            add_chunk(hd->size);
+        p = hd->free_cell++;
+    }
     new (&p->node) eterm<Alloc>(a);
     p->next  = NULL;
     if (likely(hd->size > 0))
@@ -206,21 +275,36 @@ void list<Alloc>::push_back(const eterm<Alloc>& a)
     hd->size++;
 }
 
+template <class Alloc>
+void list<Alloc>::reserve(size_t n) throw(err_bad_argument)
+{
+    if (initialized())
+        throw err_bad_argument("Cannot reserve space in a closed list");
+    if (!m_blob || (header()->size == 0 && header()->alloc_size < n)) {
+        // Nothing was added yet, so the header is reallocated
+        release();
+        create(n, this->get_allocator());
+        return;
+    }
+    // Unused cells of the current chunk are skipped once a new one is added
+    size_t size = header()->size;
+    if (n > size + room())
+        add_chunk(n - size - head_room());
+}
+
 template <class Alloc>
 bool list<Alloc>::subst(eterm<Alloc>& out, const varbind<Alloc>* binding) const
     throw (err_unbound_variable)
 {
     // We check if any contained term changes.
     bool changed = false;
-    const header_t* l_header = header();
-
-    if (l_header->size == 0)
+    if (empty())
         return false;
 
     Alloc alloc = this->get_allocator();
-    list<Alloc> l_new(l_header->size, alloc);
+    list<Alloc> l_new(length(), alloc);
 
-    for (const cons_t* p=l_header->head; p; p = p->next) {
+    for (const cons_t* p=head(); p; p = p->next) {
         eterm<Alloc> l_ele;
         visit_eterm_subst<Alloc> visitor(l_ele, binding);
         if (!visitor.apply_visitor(p->node))
@@ -245,8 +329,9 @@ bool list<Alloc>::match(const eterm<Alloc>& pattern, varbind<Alloc>* binding) co
     throw (err_invalid_term, err_unbound_variable)
 {
     switch (pattern.type()) {
-        case VAR:  return pattern.match(eterm<Alloc>(*this), binding);
-        case LIST: break;
+        case VAR:    return pattern.match(eterm<Alloc>(*this), binding);
+        case STRING: return eterm<Alloc>(*this) == pattern;
+        case LIST:   break;
         default:   return false;
     }
 
@@ -254,9 +339,8 @@ bool list<Alloc>::match(const eterm<Alloc>& pattern, varbind<Alloc>* binding) co
     if (unlikely(!initialized() || !pl.initialized()))
         throw err_invalid_term("List not initialized!");
 
-    const header_t* l_header = header();
     // Do a quick check on the size.
-    if (l_header->size != pl.length())
+    if (length() != pl.length())
         return false;
 
     const_iterator it1  = begin(), it2  = pl.begin(),
@@ -273,7 +357,7 @@ template <class Alloc>
 std::ostream& list<Alloc>::dump(std::ostream& out, const varbind<Alloc>* vars) const
 {
     out << '[';
-    const cons_t* hd = empty() ? NULL : header()->head;
+    const cons_t* hd = empty() ? NULL : head();
     for(const cons_t* p = hd; p; p = p->next) {
         out << (p != hd ? "," : "");
         const visit_eterm_stringify<Alloc> visitor(out, vars);
@@ -0,0 +1,169 @@
+//----------------------------------------------------------------------------
+/// \file  list_view.hpp
+//----------------------------------------------------------------------------
+/// \brief Read-only view of a list or a string term as a list.
+//----------------------------------------------------------------------------
+// Copyright (c) 2010 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+Copyright 2010 Serge Aleynikov <saleyn at gmail dot com>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+***** END LICENSE BLOCK *****
+*/
+#ifndef _IMPL_LIST_VIEW_HPP_
+#define _IMPL_LIST_VIEW_HPP_
+
+#include <iterator>
+#include <eixx/marshal/list.hpp>
+
+namespace eixx {
+namespace marshal {
+
+/**
+ * Read-only view of a list term, or of a string term as the list of its
+ * characters' codes.
+ *
+ * Erlang encodes lists of bytes as strings (STRING_EXT), which decode
+ * into string terms, so code that reads a list may be given a string.
+ * The view lets it read either without converting the string: it shares
+ * the term's storage, and the elements of a string are integer terms made
+ * from its bytes as they are accessed.
+ */
+template <typename Alloc>
+class list_view {
+    eterm<Alloc> m_term;
+
+public:
+    class const_iterator;
+    typedef const_iterator iterator;
+
+    /// @throws err_wrong_type if \a a_term is neither a list nor a string.
+    explicit list_view(const eterm<Alloc>& a_term) throw(err_wrong_type)
+        : m_term(a_term)
+    {
+        if (unlikely(!a_term.is_list() && !a_term.is_str()))
+            throw err_wrong_type(a_term.type(), LIST);
+    }
+
+    /// True if the term viewed is a string.
+    bool is_str() const { return m_term.is_str(); }
+
+    size_t length() const {
+        return is_str() ? m_term.to_str().size() : m_term.to_list().length();
+    }
+    bool empty() const {
+        return is_str() ? m_term.to_str().empty() : m_term.to_list().empty();
+    }
+
+    /// Get the \a n-th element. It takes O(1) for a string and is
+    /// list::nth() for a list.
+    /// @throws err_bad_argument if \a n is out of range.
+    eterm<Alloc> nth(size_t n) const throw(err_bad_argument) {
+        if (!is_str())
+            return m_term.to_list().nth(n);
+        const string<Alloc>& s = m_term.to_str();
+        if (n >= s.size())
+            throw err_bad_argument("Index out of bounds", n);
+        return eterm<Alloc>((long)(unsigned char)s.c_str()[n]);
+    }
+
+    /// @copydoc list_view::nth
+    eterm<Alloc> operator[] (size_t n) const throw(err_bad_argument) { return nth(n); }
+
+    const_iterator begin() const;
+    const_iterator end()   const;
+
+    /// Match the elements against the elements of a list \a pattern.
+    bool match(const eterm<Alloc>& pattern, varbind<Alloc>* binding) const
+        throw (err_invalid_term, err_unbound_variable);
+};
+
+/// Iterator over the elements of a list_view. The elements of a string
+/// are returned by value, so the iterator has no operator->().
+template <typename Alloc>
+class list_view<Alloc>::const_iterator {
+    typedef typename list<Alloc>::iterator cell_iterator;
+
+    const char*     m_char; // Next character of a string, NULL for a list
+    cell_iterator   m_cell;
+
+public:
+    typedef std::forward_iterator_tag   iterator_category;
+    typedef eterm<Alloc>                value_type;
+    typedef ptrdiff_t                   difference_type;
+    typedef const eterm<Alloc>*         pointer;
+    typedef eterm<Alloc>                reference;
+
+    explicit const_iterator(const char* a_char)
+        : m_char(a_char), m_cell(cell_iterator::end()) {}
+    explicit const_iterator(const cell_iterator& a_cell)
+        : m_char(NULL), m_cell(a_cell) {}
+
+    eterm<Alloc> operator*() const {
+        return m_char ? eterm<Alloc>((long)(unsigned char)*m_char) : *m_cell;
+    }
+    const_iterator& operator++()    { if (m_char) ++m_char; else ++m_cell; return *this; }
+    const_iterator  operator++(int) { const_iterator it(*this); ++*this; return it; }
+    bool operator==(const const_iterator& rhs) const {
+        return m_char == rhs.m_char && m_cell == rhs.m_cell;
+    }
+    bool operator!=(const const_iterator& rhs) const { return !(*this == rhs); }
+};
+
+template <typename Alloc>
+typename list_view<Alloc>::const_iterator list_view<Alloc>::begin() const {
+    if (is_str())
+        return const_iterator(m_term.to_str().c_str());
+    return const_iterator(m_term.to_list().begin());
+}
+
+template <typename Alloc>
+typename list_view<Alloc>::const_iterator list_view<Alloc>::end() const {
+    if (is_str()) {
+        const string<Alloc>& s = m_term.to_str();
+        return const_iterator(s.c_str() + s.size());
+    }
+    return const_iterator(m_term.to_list().end());
+}
+
+template <typename Alloc>
+bool list_view<Alloc>::match(const eterm<Alloc>& pattern, varbind<Alloc>* binding) const
+    throw (err_invalid_term, err_unbound_variable)
+{
+    if (!is_str())
+        return m_term.to_list().match(pattern, binding);
+    if (pattern.type() != LIST)
+        return m_term.match(pattern, binding);
+
+    const list<Alloc>& pl = pattern.to_list();
+    if (unlikely(!pl.initialized()))
+        throw err_invalid_term("List not initialized!");
+    if (length() != pl.length())
+        return false;
+
+    typename list<Alloc>::const_iterator it2 = pl.begin();
+    for (const_iterator it1 = begin(), end1 = end(); it1 != end1; ++it1, ++it2)
+        if (!(*it1).match(*it2, binding))
+            return false;
+    return true;
+}
+
+} // namespace marshal
+} // namespace eixx
+
+#endif // _IMPL_LIST_VIEW_HPP_
@@ -0,0 +1,217 @@
+//----------------------------------------------------------------------------
+/// \file  map.hpp
+//----------------------------------------------------------------------------
+/// \brief A class implementing a map object of Erlang external
+///        term format. It is a sorted flat array of key/value eterm pairs.
+//----------------------------------------------------------------------------
+// Copyright (c) 2010 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+Copyright 2010 Serge Aleynikov <saleyn at gmail dot com>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+***** END LICENSE BLOCK *****
+*/
+#ifndef _IMPL_MAP_HPP_
+#define _IMPL_MAP_HPP_
+
+#include <ostream>
+#include <utility>
+#include <initializer_list>
+#include <eixx/marshal/alloc_base.hpp>
+#include <eixx/marshal/varbind.hpp>
+#include <eixx/marshal/visit.hpp>
+#include <eixx/marshal/visit_encode_size.hpp>
+#include <ei.h>
+
+namespace eixx {
+namespace marshal {
+
+template <typename Alloc> class eterm;
+
+/// Erlang map. The keys are kept sorted in the order of map keys, in
+/// which integers precede floats (see eterm::compare()), in a single blob holding all keys followed by
+/// all values, so that a lookup is a binary search over adjacent keys.
+template <typename Alloc>
+class map {
+    typedef blob<eterm<Alloc>, Alloc> blob_t;
+
+    blob_t* m_blob;
+
+    eterm<Alloc>*       keys()         { return m_blob->data(); }
+    eterm<Alloc>*       values()       { return m_blob->data() + size(); }
+    const eterm<Alloc>* keys()   const { return m_blob->data(); }
+    const eterm<Alloc>* values() const { return m_blob->data() + size(); }
+
+    void release() { release(m_blob); m_blob = nullptr; }
+
+    void release(blob_t* p) {
+        if (p && p->dec_rc())
+            free_blob(p);
+    }
+
+    /// Destroy map's keys and values and free its storage after the
+    /// reference count dropped to 0.
+    static void free_blob(blob_t* p) {
+        for (size_t i=0, n=p->size(); i < n; i++)
+            p->data()[i].~eterm();
+        p->free();
+    }
+
+    /// Initialize the map from \a n keys and values returned by functors
+    /// \a key(i) and \a value(i). The pairs don't need to be sorted.
+    /// When a key is repeated, its last value is kept.
+    template <typename KeyF, typename ValF>
+    void init(size_t n, KeyF key, ValF value, const Alloc& alloc);
+
+    /// Returns true if the keys are sorted and unique.
+    bool sorted() const;
+
+    friend class eterm<Alloc>;
+
+public:
+    map() : m_blob(nullptr) {}
+
+    map(const map<Alloc>& a) : m_blob(a.m_blob) {
+        if (m_blob) m_blob->inc_rc();
+    }
+
+    map(map<Alloc>&& a) : m_blob(a.m_blob) {
+        a.m_blob = nullptr;
+    }
+
+    /// Create a map from an array of \a n interleaved keys and values
+    /// (i.e. {K1, V1, K2, V2, ...}), so \a items must hold 2*n terms.
+    map(const eterm<Alloc>* items, size_t n, const Alloc& alloc = Alloc()) {
+        init(n, [=](size_t i) -> const eterm<Alloc>& { return items[2*i];   },
+                [=](size_t i) -> const eterm<Alloc>& { return items[2*i+1]; }, alloc);
+    }
+
+    map(std::initializer_list<std::pair<eterm<Alloc>, eterm<Alloc>>> items,
+        const Alloc& alloc = Alloc())
+    {
+        auto p = items.begin();
+        init(items.size(),
+             [=](size_t i) -> const eterm<Alloc>& { return p[i].first;  },
+             [=](size_t i) -> const eterm<Alloc>& { return p[i].second; }, alloc);
+    }
+
+    /**
+     * Decode the map from a binary buffer.
+     */
+    map(const char* buf, int& idx, size_t size, const Alloc& a_alloc = Alloc())
+        throw(err_decode_exception);
+
+    ~map() {
+        release();
+    }
+
+    map<Alloc>& operator= (const map<Alloc>& rhs) {
+        if (this != &rhs) {
+            auto p = m_blob;
+            m_blob = rhs.m_blob;
+            if (m_blob) m_blob->inc_rc();
+            release(p);
+        }
+        return *this;
+    }
+
+    map<Alloc>& operator= (map<Alloc>&& rhs) {
+        if (this != &rhs) {
+            auto p = m_blob;
+            m_blob = rhs.m_blob;
+            rhs.m_blob = nullptr;
+            release(p);
+        }
+        return *this;
+    }
+
+    bool operator== (const map<Alloc>& rhs) const;
+
+    /// Number of key/value pairs in the map.
+    size_t size()        const { return m_blob ? m_blob->size() / 2 : 0; }
+    bool   empty()       const { return size() == 0; }
+    bool   initialized() const { return m_blob != nullptr; }
+
+    /// Key of the \a i-th pair in the key order.
+    const eterm<Alloc>& key(size_t i) const {
+        BOOST_ASSERT(m_blob && i < size());
+        return keys()[i];
+    }
+
+    /// Value of the \a i-th pair in the key order.
+    const eterm<Alloc>& value(size_t i) const {
+        BOOST_ASSERT(m_blob && i < size());
+        return values()[i];
+    }
+
+    /// Find the value stored under \a a_key using binary search.
+    /// @return pointer to the value or NULL if the key is not in the map.
+    const eterm<Alloc>* find(const eterm<Alloc>& a_key) const;
+
+    bool has(const eterm<Alloc>& a_key) const { return find(a_key) != NULL; }
+
+    /// Get the value stored under \a a_key.
+    /// @throws err_bad_argument if the key is not in the map.
+    const eterm<Alloc>& operator[] (const eterm<Alloc>& a_key) const {
+        const eterm<Alloc>* p = find(a_key);
+        if (!p)
+            throw err_bad_argument("Map key not found");
+        return *p;
+    }
+
+    /// Hash value of the map's keys and values. It is cached in the
+    /// map's storage.
+    uint32_t hash() const;
+
+    size_t encode_size() const {
+        BOOST_ASSERT(initialized());
+        size_t result = 5;
+        for (size_t i=0, n=m_blob->size(); i < n; i++)
+            result += visit_eterm_encode_size_calc<Alloc>().apply_visitor(m_blob->data()[i]);
+        return result;
+    }
+
+    void encode(char* buf, int& idx, size_t size) const;
+
+    bool subst(eterm<Alloc>& out, const varbind<Alloc>* binding) const
+        throw (err_unbound_variable);
+
+    /// A map pattern matches a map that holds all of the pattern's keys
+    /// with the values matching the corresponding patterns.
+    /// Keys of the pattern must not contain variables.
+    bool match(const eterm<Alloc>& pattern, varbind<Alloc>* binding) const
+        throw (err_invalid_term, err_unbound_variable);
+
+    std::ostream& dump(std::ostream& out, const varbind<Alloc>* vars = NULL) const;
+};
+
+} // namespace marshal
+} // namespace eixx
+
+namespace std {
+
+    template <class Alloc>
+    ostream& operator<< (ostream& out, const eixx::marshal::map<Alloc>& a) {
+        return a.dump(out);
+    }
+
+} // namespace std
+
+#include <eixx/marshal/map.hxx>
+
+#endif // _IMPL_MAP_HPP_
@@ -0,0 +1,239 @@
+//----------------------------------------------------------------------------
+/// \file  map.hxx
+//----------------------------------------------------------------------------
+/// \brief Implementation of map's member functions.
+//----------------------------------------------------------------------------
+// Copyright (c) 2010 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+Copyright 2010 Serge Aleynikov <saleyn at gmail dot com>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+***** END LICENSE BLOCK *****
+*/
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <eixx/marshal/visit_encode_size.hpp>
+#include <eixx/marshal/visit_encoder.hpp>
+#include <eixx/marshal/visit_to_string.hpp>
+#include <eixx/marshal/visit_subst.hpp>
+#include <ei.h>
+
+namespace eixx {
+namespace marshal {
+
+template <class Alloc>
+template <typename KeyF, typename ValF>
+void map<Alloc>::init(size_t n, KeyF key, ValF value, const Alloc& alloc)
+{
+    std::vector<size_t> idx(n);
+    for (size_t i=0; i < n; i++)
+        idx[i] = i;
+
+    // Stable sort keeps repeated keys in their original order, so that
+    // the last occurrence overrides the preceding ones.
+    std::stable_sort(idx.begin(), idx.end(),
+        [&](size_t a, size_t b) { return key(a).compare(key(b), true) < 0; });
+
+    size_t m = 0;
+    for (size_t i=0; i < n; i++) {
+        if (m > 0 && key(idx[m-1]).compare(key(idx[i]), true) == 0)
+            idx[m-1] = idx[i];
+        else
+            idx[m++] = idx[i];
+    }
+
+    m_blob = blob_t::create(2*m, alloc);
+    for (size_t i=0; i < m; i++) {
+        new (&m_blob->data()[i])   eterm<Alloc>(key(idx[i]));
+        new (&m_blob->data()[m+i]) eterm<Alloc>(value(idx[i]));
+    }
+}
+
+template <class Alloc>
+bool map<Alloc>::sorted() const
+{
+    for (size_t i=1, n=size(); i < n; i++)
+        if (keys()[i-1].compare(keys()[i], true) >= 0)
+            return false;
+    return true;
+}
+
+template <class Alloc>
+map<Alloc>::map(const char* buf, int& idx, size_t size, const Alloc& a_alloc)
+    throw(err_decode_exception)
+{
+    int arity;
+    if (ei_decode_map_header(buf, &idx, &arity) < 0)
+        throw err_decode_exception("Error decoding map header", idx);
+    m_blob = blob_t::create(2*arity, a_alloc);
+    // Default-construct the terms so that the blob can be released if
+    // decoding of one of them throws.
+    std::uninitialized_fill(m_blob->data(), m_blob->data() + m_blob->size(), eterm<Alloc>());
+    try {
+        for (int i=0; i < arity; i++) {
+            m_blob->data()[i]       = eterm<Alloc>(buf, idx, size, a_alloc);
+            m_blob->data()[arity+i] = eterm<Alloc>(buf, idx, size, a_alloc);
+        }
+    } catch (...) {
+        release();
+        throw;
+    }
+    BOOST_ASSERT((size_t)idx <= size);
+
+    // Small maps are sent by the emulator in the key order, so the sort
+    // is normally skipped.
+    if (!sorted()) {
+        blob_t* p = m_blob;
+        const eterm<Alloc>* k = p->data();
+        const eterm<Alloc>* v = p->data() + arity;
+        init(arity, [=](size_t i) -> const eterm<Alloc>& { return k[i]; },
+                    [=](size_t i) -> const eterm<Alloc>& { return v[i]; }, a_alloc);
+        release(p);
+    }
+}
+
+template <class Alloc>
+bool map<Alloc>::operator== (const map<Alloc>& rhs) const
+{
+    if (m_blob == rhs.m_blob)
+        return true;
+    if (size() != rhs.size())
+        return false;
+    for (size_t i=0, n=m_blob->size(); i < n; i++)
+        if (!(m_blob->data()[i] == rhs.m_blob->data()[i]))
+            return false;
+    return true;
+}
+
+template <class Alloc>
+uint32_t map<Alloc>::hash() const
+{
+    if (!m_blob)
+        return 1;
+    if (uint32_t h = m_blob->cached_hash())
+        return h;
+    uint32_t h = size();
+    bool cache = true;
+    for (size_t i=0, n=m_blob->size(); i < n; i++) {
+        h = eixx::detail::hash_combine(h, m_blob->data()[i].hash());
+        cache &= !is_mutable_type(m_blob->data()[i].type());
+    }
+    h = detail::nonzero_hash(h);
+    if (cache)
+        m_blob->cache_hash(h);
+    return h;
+}
+
+template <class Alloc>
+const eterm<Alloc>* map<Alloc>::find(const eterm<Alloc>& a_key) const
+{
+    if (!m_blob)
+        return NULL;
+    const eterm<Alloc>* begin = keys(), *end = begin + size();
+    const eterm<Alloc>* it = std::lower_bound(begin, end, a_key,
+        [](const eterm<Alloc>& a, const eterm<Alloc>& b) { return a.compare(b, true) < 0; });
+    if (it == end || it->compare(a_key, true) != 0)
+        return NULL;
+    return values() + (it - begin);
+}
+
+template <class Alloc>
+void map<Alloc>::encode(char* buf, int& idx, size_t size) const
+{
+    BOOST_ASSERT(initialized());
+    ei_encode_map_header(buf, &idx, this->size());
+    for (size_t i=0, n=this->size(); i < n; i++) {
+        visit_eterm_encoder visitor(buf, idx, size);
+        visitor.apply_visitor(keys()[i]);
+        visitor.apply_visitor(values()[i]);
+    }
+    BOOST_ASSERT((size_t)idx <= size);
+}
+
+template <class Alloc>
+bool map<Alloc>::subst(eterm<Alloc>& out, const varbind<Alloc>* binding) const
+    throw (err_unbound_variable)
+{
+    // We check if any contained term changes.
+    bool changed = false;
+    size_t n = m_blob->size();
+    std::vector<eterm<Alloc>> items;
+    items.reserve(n);
+
+    for (size_t i=0; i < n; i++) {
+        // Interleave keys and values
+        const eterm<Alloc>& e = m_blob->data()[(i & 1) ? size() + i/2 : i/2];
+        eterm<Alloc> l_ele;
+        visit_eterm_subst<Alloc> visitor(l_ele, binding);
+        if (!visitor.apply_visitor(e))
+            items.push_back(e);
+        else {
+            changed = true;
+            items.push_back(l_ele);
+        }
+    }
+
+    if (!changed)
+        return false;
+
+    // Substituted keys may change the order, so the map is rebuilt
+    out = map<Alloc>(items.data(), size(), m_blob->get_allocator());
+    return true;
+}
+
+template <class Alloc>
+bool map<Alloc>::match(const eterm<Alloc>& pattern, varbind<Alloc>* binding) const
+    throw (err_invalid_term, err_unbound_variable)
+{
+    switch (pattern.type()) {
+        case VAR:   return pattern.match(eterm<Alloc>(*this), binding);
+        case MAP:   break;
+        default:    return false;
+    }
+
+    const map<Alloc>& pm = pattern.to_map();
+    if (unlikely(!initialized() || !pm.initialized()))
+        throw err_invalid_term("Map not initialized!");
+    if (size() < pm.size())
+        return false;
+    for (size_t i=0, n=pm.size(); i < n; ++i) {
+        const eterm<Alloc>* v = find(pm.key(i));
+        if (!v || !v->match(pm.value(i), binding))
+            return false;
+    }
+    return true;
+}
+
+template <class Alloc>
+std::ostream& map<Alloc>::dump(std::ostream& out, const varbind<Alloc>* vars) const
+{
+    out << "#{";
+    for (size_t i=0, n=size(); i < n; i++) {
+        out << (i ? "," : "");
+        visit_eterm_stringify<Alloc> visitor(out, vars);
+        visitor.apply_visitor(keys()[i]);
+        out << " => ";
+        visitor.apply_visitor(values()[i]);
+    }
+    return out << '}';
+}
+
+} // namespace marshal
+} // namespace eixx
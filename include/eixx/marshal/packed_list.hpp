@@ -0,0 +1,170 @@
+//----------------------------------------------------------------------------
+/// \file  packed_list.hpp
+//----------------------------------------------------------------------------
+/// \brief A list of numbers stored in a contiguous array.
+//----------------------------------------------------------------------------
+// Copyright (c) 2010 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+Copyright 2010 Serge Aleynikov <saleyn at gmail dot com>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+***** END LICENSE BLOCK *****
+*/
+#ifndef _IMPL_PACKED_LIST_HPP_
+#define _IMPL_PACKED_LIST_HPP_
+
+#include <initializer_list>
+#include <type_traits>
+#include <eixx/marshal/list.hpp>
+
+namespace eixx {
+namespace marshal {
+
+/**
+ * A list of numbers of type \a T (long or double) stored in a
+ * contiguous reference-counted array.
+ *
+ * A list of thousands of numbers stored as a list<Alloc> takes a cons
+ * cell per element. The packed list takes sizeof(T) bytes per element
+ * and is decoded from and encoded to the regular list encoding
+ * (LIST_EXT, or STRING_EXT for lists of bytes, like Erlang does), so
+ * that the peer can't tell the two apart. Elements are converted to
+ * eterms only when to_list() is called.
+ *
+ * Decoding a list that contains an element which is not a number of
+ * type \a T throws err_decode_exception. A packed_list<double> accepts
+ * integers, which are converted.
+ */
+template <typename T, typename Alloc>
+class packed_list {
+    BOOST_STATIC_ASSERT((std::is_same<T, long>::value || std::is_same<T, double>::value));
+
+    typedef blob<T, Alloc> blob_t;
+
+    blob_t* m_blob;
+
+    void release() {
+        if (m_blob && m_blob->dec_rc())
+            m_blob->free();
+        m_blob = NULL;
+    }
+
+    /// Decode \a n list elements starting at \a idx.
+    void decode_items(const char* buf, int& idx, size_t size, size_t n)
+        throw(err_decode_exception);
+
+    /// Decode a single element of a list in the general case.
+    static T decode_item(const char* buf, int& idx, size_t size)
+        throw(err_decode_exception);
+public:
+    typedef T           value_type;
+    typedef const T*    const_iterator;
+    typedef const T*    iterator;
+
+    packed_list() : m_blob(NULL) {}
+
+    packed_list(const T* items, size_t n, const Alloc& alloc = Alloc())
+        : m_blob(n ? blob_t::create(n, alloc) : NULL)
+    {
+        std::copy(items, items + n, data());
+    }
+
+    packed_list(std::initializer_list<T> items, const Alloc& alloc = Alloc())
+        : packed_list(items.begin(), items.size(), alloc) {}
+
+    /**
+     * Decode the list from a binary buffer.
+     */
+    packed_list(const char* buf, int& idx, size_t size, const Alloc& a_alloc = Alloc())
+        throw(err_decode_exception);
+
+    packed_list(const packed_list& a) : m_blob(a.m_blob) { if (m_blob) m_blob->inc_rc(); }
+    packed_list(packed_list&& a)      : m_blob(a.m_blob) { a.m_blob = NULL; }
+
+    ~packed_list() { release(); }
+
+    packed_list& operator= (const packed_list& rhs) {
+        if (this != &rhs) {
+            release();
+            m_blob = rhs.m_blob;
+            if (m_blob) m_blob->inc_rc();
+        }
+        return *this;
+    }
+
+    packed_list& operator= (packed_list&& rhs) {
+        if (this != &rhs) {
+            release();
+            m_blob = rhs.m_blob;
+            rhs.m_blob = NULL;
+        }
+        return *this;
+    }
+
+    size_t      size()  const { return m_blob ? m_blob->size() : 0; }
+    size_t      length()const { return size(); }
+    bool        empty() const { return !m_blob; }
+    const T*    data()  const { return m_blob ? m_blob->data() : NULL; }
+    T*          data()        { return m_blob ? m_blob->data() : NULL; }
+
+    const_iterator begin() const { return data(); }
+    const_iterator end()   const { return data() + size(); }
+
+    T operator[] (size_t i) const { BOOST_ASSERT(i < size()); return data()[i]; }
+
+    bool operator== (const packed_list& rhs) const {
+        return m_blob == rhs.m_blob ||
+              (size() == rhs.size() && std::equal(begin(), end(), rhs.begin()));
+    }
+    bool operator!= (const packed_list& rhs) const { return !(*this == rhs); }
+
+    /// Convert the elements to a list of eterms.
+    list<Alloc> to_list() const;
+
+    /// True if the list is encoded as a STRING_EXT, which is the case for
+    /// lists of up to 65535 integers in the range 0..255.
+    bool is_byte_list() const;
+
+    /// Size of the encoded list.
+    size_t encode_size() const;
+
+    void encode(char* buf, int& idx, size_t size) const;
+
+    std::ostream& dump(std::ostream& out) const {
+        out << '[';
+        for (const_iterator it = begin(), e = end(); it != e; ++it)
+            out << (it != begin() ? "," : "") << *it;
+        return out << ']';
+    }
+};
+
+} // namespace marshal
+} // namespace eixx
+
+namespace std {
+
+    template <typename T, class Alloc>
+    ostream& operator<< (ostream& out, const eixx::marshal::packed_list<T, Alloc>& a) {
+        return a.dump(out);
+    }
+
+} // namespace std
+
+#include <eixx/marshal/packed_list.hxx>
+
+#endif // _IMPL_PACKED_LIST_HPP_
@@ -0,0 +1,323 @@
+//----------------------------------------------------------------------------
+/// \file  packed_list.hxx
+//----------------------------------------------------------------------------
+/// \brief Implementation of packed_list's member functions.
+//----------------------------------------------------------------------------
+// Copyright (c) 2010 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+Copyright 2010 Serge Aleynikov <saleyn at gmail dot com>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+***** END LICENSE BLOCK *****
+*/
+#pragma once
+
+#include <cstdint>
+#include <boost/endian/conversion.hpp>
+#include <eixx/marshal/endian.hpp>
+#include <ei.h>
+
+namespace eixx    {
+namespace marshal {
+
+namespace detail {
+
+    // Elements of the lists sent by the emulator usually have the same
+    // encoding, in which case they lie at a fixed stride and the loops
+    // below are vectorized by the compiler.
+
+    /// True if each of the \a n elements at \a p that are \a stride bytes
+    /// apart starts with \a tag.
+    inline bool uniform_tags(const uint8_t* p, size_t n, size_t stride, uint8_t tag) {
+        uint8_t diff = 0;
+        for (size_t i=0; i < n; i++)
+            diff |= p[i*stride] ^ tag;
+        return diff == 0;
+    }
+
+    inline double load_double_be(const uint8_t* p) {
+        uint64_t u; double d;
+        memcpy(&u, p, sizeof(u));
+        u = boost::endian::big_to_native(u);
+        memcpy(&d, &u, sizeof(d));
+        return d;
+    }
+
+    inline void store_double_be(uint8_t* p, double d) {
+        uint64_t u;
+        memcpy(&u, &d, sizeof(u));
+        u = boost::endian::native_to_big(u);
+        memcpy(p, &u, sizeof(u));
+    }
+
+    inline int32_t load_int32_be(const uint8_t* p) {
+        uint32_t u;
+        memcpy(&u, p, sizeof(u));
+        return (int32_t)boost::endian::big_to_native(u);
+    }
+
+    inline void store_int32_be(uint8_t* p, int32_t n) {
+        uint32_t u = boost::endian::native_to_big((uint32_t)n);
+        memcpy(p, &u, sizeof(u));
+    }
+
+    inline bool is_small_int(long n) { return (unsigned long)n <= 255; }
+    inline bool is_int32(long n)     { return n >= INT32_MIN && n <= INT32_MAX; }
+
+    /// Number of bytes of the magnitude of a SMALL_BIG_EXT integer.
+    inline size_t big_bytes(long n) {
+        unsigned long u = n < 0 ? -(unsigned long)n : n;
+        return (64 - __builtin_clzl(u) + 7) / 8;
+    }
+
+    /// Encoded size of an integer.
+    inline size_t long_size(long n) {
+        return is_small_int(n) ? 2 : is_int32(n) ? 5 : 3 + big_bytes(n);
+    }
+
+} // namespace detail
+
+template <typename T, typename Alloc>
+packed_list<T, Alloc>::packed_list(const char* buf, int& idx, size_t size, const Alloc& a_alloc)
+    throw(err_decode_exception)
+    : m_blob(NULL)
+{
+    if ((size_t)idx >= size)
+        throw err_decode_exception("Error decoding list header", idx);
+    const char* s = buf + idx;
+    switch (get8(s)) {
+        case ERL_NIL_EXT:
+            idx++;
+            return;
+
+        // A list of bytes is sent as a string
+        case ERL_STRING_EXT: {
+            if ((size_t)idx + 3 > size)
+                throw err_decode_exception("Error decoding list header", idx);
+            size_t n = get16be(s);
+            if ((size_t)idx + 3 + n > size)
+                throw err_decode_exception("Truncated list", idx);
+            if (n > 0) {
+                m_blob = blob_t::create(n, a_alloc);
+                const uint8_t* p = reinterpret_cast<const uint8_t*>(s);
+                T* out = data();
+                for (size_t i=0; i < n; i++)
+                    out[i] = p[i];
+            }
+            idx += 3 + n;
+            return;
+        }
+
+        case ERL_LIST_EXT: {
+            if ((size_t)idx + 5 > size)
+                throw err_decode_exception("Error decoding list header", idx);
+            size_t n = get32be(s);
+            idx += 5;
+            // Each element takes at least two bytes
+            if (n > (size - idx) / 2)
+                throw err_decode_exception("Truncated list", idx);
+            if (n > 0) {
+                m_blob = blob_t::create(n, a_alloc);
+                try {
+                    decode_items(buf, idx, size, n);
+                } catch (...) {
+                    release();
+                    throw;
+                }
+            }
+            if ((size_t)idx >= size || buf[idx] != ERL_NIL_EXT) {
+                release();
+                throw err_decode_exception("Not a NIL list!", idx);
+            }
+            idx++;
+            return;
+        }
+
+        default:
+            throw err_decode_exception("Not a list", idx);
+    }
+}
+
+template <typename T, typename Alloc>
+void packed_list<T, Alloc>::decode_items(const char* buf, int& idx, size_t size, size_t n)
+    throw(err_decode_exception)
+{
+    const uint8_t* p    = reinterpret_cast<const uint8_t*>(buf + idx);
+    size_t         left = size - idx;
+    T*             out  = data();
+
+    if (std::is_same<T, double>::value) {
+        if (n*9 <= left && detail::uniform_tags(p, n, 9, NEW_FLOAT_EXT)) {
+            for (size_t i=0; i < n; i++)
+                out[i] = detail::load_double_be(p + 9*i + 1);
+            idx += 9*n;
+            return;
+        }
+    } else if (detail::uniform_tags(p, n, 2, ERL_SMALL_INTEGER_EXT)) {
+        for (size_t i=0; i < n; i++)
+            out[i] = p[2*i + 1];
+        idx += 2*n;
+        return;
+    } else if (n*5 <= left && detail::uniform_tags(p, n, 5, ERL_INTEGER_EXT)) {
+        for (size_t i=0; i < n; i++)
+            out[i] = detail::load_int32_be(p + 5*i + 1);
+        idx += 5*n;
+        return;
+    }
+
+    for (size_t i=0; i < n; i++)
+        out[i] = decode_item(buf, idx, size);
+}
+
+template <typename T, typename Alloc>
+T packed_list<T, Alloc>::decode_item(const char* buf, int& idx, size_t size)
+    throw(err_decode_exception)
+{
+    int i = idx;
+    if ((size_t)idx >= size)
+        throw err_decode_exception("Truncated list", idx);
+    if (std::is_same<T, double>::value &&
+            (buf[idx] == NEW_FLOAT_EXT || buf[idx] == ERL_FLOAT_EXT)) {
+        double d;
+        if (ei_decode_double(buf, &idx, &d) < 0 || (size_t)idx > size)
+            throw err_decode_exception("Error decoding double", i);
+        return d;
+    }
+    long long n;
+    if (ei_decode_longlong(buf, &idx, &n) < 0 || (size_t)idx > size)
+        throw err_decode_exception("List element is not a number", i);
+    return n;
+}
+
+template <typename T, typename Alloc>
+bool packed_list<T, Alloc>::is_byte_list() const
+{
+    size_t n = size();
+    if (std::is_same<T, double>::value || n == 0 || n > 0xFFFF)
+        return false;
+    bool bytes = true;
+    for (size_t i=0; i < n; i++)
+        bytes &= detail::is_small_int(data()[i]);
+    return bytes;
+}
+
+template <typename T, typename Alloc>
+list<Alloc> packed_list<T, Alloc>::to_list() const
+{
+    if (empty())
+        return list<Alloc>::make();
+    list<Alloc> l((int)size(), m_blob->get_allocator());
+    for (const_iterator it = begin(), e = end(); it != e; ++it)
+        l.push_back(eterm<Alloc>(*it));
+    l.close();
+    return l;
+}
+
+template <typename T, typename Alloc>
+size_t packed_list<T, Alloc>::encode_size() const
+{
+    if (empty())
+        return 1;
+    if (is_byte_list())
+        return 3 + size();
+    size_t n = 5 + 1 /* 1 byte for ERL_NIL_EXT */;
+    if (std::is_same<T, double>::value)
+        return n + 9*size();
+    for (const_iterator it = begin(), e = end(); it != e; ++it)
+        n += detail::long_size(*it);
+    return n;
+}
+
+template <typename T, typename Alloc>
+void packed_list<T, Alloc>::encode(char* buf, int& idx, size_t size) const
+{
+    char* s = buf + idx;
+    if (empty()) {
+        put8(s, ERL_NIL_EXT);
+        idx++;
+        BOOST_ASSERT((size_t)idx <= size);
+        return;
+    }
+    size_t   n = this->size();
+    const T* d = data();
+    if (is_byte_list()) {
+        put8(s, ERL_STRING_EXT);
+        put16be(s, n);
+        for (size_t i=0; i < n; i++)
+            s[i] = (char)d[i];
+        idx += 3 + n;
+        BOOST_ASSERT((size_t)idx <= size);
+        return;
+    }
+    put8(s, ERL_LIST_EXT);
+    put32be(s, n);
+    uint8_t* p = reinterpret_cast<uint8_t*>(s);
+
+    bool small = !std::is_same<T, double>::value;
+    bool int32 = small;
+    for (size_t i=0; small && i < n; i++)
+        small = detail::is_small_int(d[i]);
+    for (size_t i=0; !small && int32 && i < n; i++)
+        int32 = detail::is_int32(d[i]);
+
+    if (std::is_same<T, double>::value) {
+        for (size_t i=0; i < n; i++) {
+            p[9*i] = NEW_FLOAT_EXT;
+            detail::store_double_be(p + 9*i + 1, d[i]);
+        }
+        p += 9*n;
+    } else if (small) {
+        for (size_t i=0; i < n; i++) {
+            p[2*i]   = ERL_SMALL_INTEGER_EXT;
+            p[2*i+1] = (uint8_t)d[i];
+        }
+        p += 2*n;
+    } else if (int32) {
+        for (size_t i=0; i < n; i++) {
+            p[5*i] = ERL_INTEGER_EXT;
+            detail::store_int32_be(p + 5*i + 1, (int32_t)d[i]);
+        }
+        p += 5*n;
+    } else {
+        for (size_t i=0; i < n; i++) {
+            long v = (long)d[i];
+            if (detail::is_small_int(v)) {
+                *p++ = ERL_SMALL_INTEGER_EXT;
+                *p++ = (uint8_t)v;
+            } else if (detail::is_int32(v)) {
+                *p++ = ERL_INTEGER_EXT;
+                detail::store_int32_be(p, (int32_t)v);
+                p += 4;
+            } else {
+                unsigned long u = v < 0 ? -(unsigned long)v : v;
+                size_t  bytes = detail::big_bytes(v);
+                *p++ = ERL_SMALL_BIG_EXT;
+                *p++ = (uint8_t)bytes;
+                *p++ = v < 0;
+                for (size_t j=0; j < bytes; j++, u >>= 8)
+                    *p++ = (uint8_t)u;
+            }
+        }
+    }
+    *p++ = ERL_NIL_EXT;
+    idx  = reinterpret_cast<char*>(p) - buf;
+    BOOST_ASSERT((size_t)idx <= size);
+}
+
+} // namespace marshal
+} // namespace eixx
@@ -0,0 +1,505 @@
+//----------------------------------------------------------------------------
+/// \file  phash2.hpp
+//----------------------------------------------------------------------------
+/// \brief Hash function compatible with erlang:phash2/1,2.
+//----------------------------------------------------------------------------
+// Copyright (c) 2010 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+Copyright 2010 Serge Aleynikov <saleyn at gmail dot com>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+***** END LICENSE BLOCK *****
+*/
+
+#ifndef _EIXX_PHASH2_HPP_
+#define _EIXX_PHASH2_HPP_
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <eixx/marshal/endian.hpp>
+#include <eixx/eterm_exception.hpp>
+#include <ei.h>
+
+// Tags that are missing in older versions of ei.h
+#ifndef ERL_NEW_PID_EXT
+#define ERL_NEW_PID_EXT         'X'
+#endif
+#ifndef ERL_NEW_PORT_EXT
+#define ERL_NEW_PORT_EXT        'Y'
+#endif
+#ifndef ERL_V4_PORT_EXT
+#define ERL_V4_PORT_EXT         'x'
+#endif
+#ifndef ERL_NEWER_REFERENCE_EXT
+#define ERL_NEWER_REFERENCE_EXT 'Z'
+#endif
+#ifndef ERL_BIT_BINARY_EXT
+#define ERL_BIT_BINARY_EXT      'M'
+#endif
+
+namespace eixx {
+namespace marshal {
+
+/**
+ * Computes the value of erlang:phash2/2 of a term encoded in the Erlang
+ * external format without decoding the term.
+ *
+ * This is a transcription of make_hash2() of the Erlang emulator
+ * (erts/emulator/beam/utils.c), which mixes the leaves of the term into
+ * the running hash in the order of their appearance, the same order in
+ * which they are laid out in the external format. The only exception
+ * are maps, which hash their key/value pairs independently of each other
+ * and combine them with XOR, so that the key order doesn't matter.
+ */
+class phash2 {
+    static const uint32_t HCONST  = 0x9e3779b9u;
+    /// Hash value of the NIL tag in make_hash2().
+    static const uint32_t NIL_DEF = 2;
+
+    /// (HCONST * n) mod 2^32
+    static uint32_t hconst(uint32_t n) { return HCONST * n; }
+
+    const char* m_begin;
+    const char* m_s;
+    const char* m_end;
+    uint32_t    m_hash;
+
+    phash2(const char* buf, size_t size) : m_begin(buf), m_s(buf), m_end(buf+size), m_hash(0) {}
+
+    static void mix(uint32_t& a, uint32_t& b, uint32_t& c) {
+        a -= b; a -= c; a ^= (c>>13);
+        b -= c; b -= a; b ^= (a<<8);
+        c -= a; c -= b; c ^= (b>>13);
+        a -= b; a -= c; a ^= (c>>12);
+        b -= c; b -= a; b ^= (a<<16);
+        c -= a; c -= b; c ^= (b>>5);
+        a -= b; a -= c; a ^= (c>>3);
+        b -= c; b -= a; b ^= (a<<10);
+        c -= a; c -= b; c ^= (b>>15);
+    }
+
+    /// Bob Jenkins' lookup2 hash of \a len bytes.
+    static uint32_t block_hash(const uint8_t* k, size_t length, uint32_t initval) {
+        uint32_t a = HCONST, b = HCONST, c = initval;
+        size_t len = length;
+
+        for (; len >= 12; k += 12, len -= 12) {
+            a += k[0] + ((uint32_t)k[1]<<8) + ((uint32_t)k[2]<<16)  + ((uint32_t)k[3]<<24);
+            b += k[4] + ((uint32_t)k[5]<<8) + ((uint32_t)k[6]<<16)  + ((uint32_t)k[7]<<24);
+            c += k[8] + ((uint32_t)k[9]<<8) + ((uint32_t)k[10]<<16) + ((uint32_t)k[11]<<24);
+            mix(a, b, c);
+        }
+
+        c += (uint32_t)length;
+        switch (len) {  // All cases fall through
+            case 11: c += (uint32_t)k[10]<<24;
+            case 10: c += (uint32_t)k[9]<<16;
+            case 9 : c += (uint32_t)k[8]<<8;
+            case 8 : b += (uint32_t)k[7]<<24;
+            case 7 : b += (uint32_t)k[6]<<16;
+            case 6 : b += (uint32_t)k[5]<<8;
+            case 5 : b += k[4];
+            case 4 : a += (uint32_t)k[3]<<24;
+            case 3 : a += (uint32_t)k[2]<<16;
+            case 2 : a += (uint32_t)k[1]<<8;
+            case 1 : a += k[0];
+        }
+        mix(a, b, c);
+        return c;
+    }
+
+    /// Hash value of an atom stored in the emulator's atom table.
+    /// Atom names are kept in UTF-8, but characters below 256 are
+    /// hashed as Latin-1 bytes.
+    static uint32_t atom_hash(const uint8_t* p, size_t len, bool utf8) {
+        uint32_t h = 0;
+        while (len--) {
+            uint8_t v = *p++;
+            if (utf8 && len && (v & 0xFE) == 0xC2 && (*p & 0xC0) == 0x80) {
+                v = (v << 6) | (*p & 0x3F);
+                p++; len--;
+            }
+            h = (h << 4) + v;
+            if (uint32_t g = h & 0xf0000000) {
+                h ^= (g >> 24);
+                h ^= g;
+            }
+        }
+        return h;
+    }
+
+    void uint32_hash(uint32_t x, uint32_t y, uint32_t k) {
+        uint32_t a = k + x, b = k + y;
+        mix(a, b, m_hash);
+    }
+
+    void uint32_hash(uint32_t x, uint32_t k) { uint32_hash(x, 0, k); }
+
+    void check(size_t n) {
+        if (m_s + n > m_end)
+            throw err_decode_exception("Truncated term", int(m_s - m_begin));
+    }
+
+    uint8_t  get8()    { check(1); return eixx::get8(m_s);    }
+    uint16_t get16be() { check(2); return eixx::get16be(m_s); }
+    uint32_t get32be() { check(4); return eixx::get32be(m_s); }
+    uint64_t get64be() { check(8); return eixx::get64be(m_s); }
+
+    const uint8_t* bytes(size_t n) {
+        check(n);
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(m_s);
+        m_s += n;
+        return p;
+    }
+
+    void integer(int64_t v) {
+        // Integers that fit in 28 bits are hashed as signed 32-bit values
+        if (v >= -(1 << 27) && v < (1 << 27)) {
+            int32_t y = (int32_t)v;
+            if (y < 0)  // Negative numbers are mixed twice
+                uint32_hash((uint32_t)-y, HCONST);
+            uint32_hash((uint32_t)y, HCONST);
+        } else {
+            uint64_t t = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+            uint32_hash((uint32_t)t, (uint32_t)(t >> 32), v < 0 ? hconst(10) : hconst(11));
+        }
+    }
+
+    /// Integer of \a n little-endian magnitude bytes at \a p.
+    void big(const uint8_t* p, size_t n, bool negative) {
+        while (n > 0 && p[n-1] == 0)
+            n--;
+        if (n <= sizeof(uint64_t)) {
+            uint64_t t = 0;
+            for (size_t i=n; i > 0; i--)
+                t = (t << 8) | p[i-1];
+            if (t <= (1u << 27)) {
+                integer(negative ? -(int64_t)t : (int64_t)t);
+                return;
+            }
+        }
+        // Bignums are hashed by 64-bit digits starting with the least
+        // significant one
+        for (size_t i=0; i < n; i += sizeof(uint64_t)) {
+            uint64_t t = 0;
+            for (size_t j = std::min(n, i + sizeof(uint64_t)); j > i; j--)
+                t = (t << 8) | p[j-1];
+            uint32_hash((uint32_t)t, (uint32_t)(t >> 32), negative ? hconst(10) : hconst(11));
+        }
+    }
+
+    void floating(double d) {
+        if (d == 0.0)   // Hash -0.0 as 0.0
+            d = 0.0;
+        uint64_t n;
+        memcpy(&n, &d, sizeof(n));
+        uint32_hash((uint32_t)(n >> 32), (uint32_t)n, hconst(12));
+    }
+
+    void atom(const uint8_t* p, size_t len, bool utf8) {
+        uint32_t h = atom_hash(p, len, utf8);
+        if (m_hash == 0)
+            m_hash = h;
+        else
+            uint32_hash(h, hconst(3));
+    }
+
+    /// The emulator uses a precomputed constant (3468870702) when the
+    /// hash is 0, which is what this computes in that case.
+    void nil() { uint32_hash(NIL_DEF, hconst(2)); }
+
+    void binary(const uint8_t* p, size_t sz, uint8_t bitsize) {
+        uint32_t con = hconst(13) + m_hash;
+        if (sz == 0 && bitsize == 0) {
+            m_hash = con;
+            return;
+        }
+        m_hash = block_hash(p, sz, con);
+        if (bitsize > 0)
+            uint32_hash(bitsize, p[sz] >> (8 - bitsize), hconst(15));
+    }
+
+    void skip_atom() {
+        switch (get8()) {
+            case ERL_ATOM_EXT:
+            case ERL_ATOM_UTF8_EXT:         bytes(get16be()); break;
+            case ERL_SMALL_ATOM_EXT:
+            case ERL_SMALL_ATOM_UTF8_EXT:   bytes(get8());    break;
+            default:
+                throw err_decode_exception("Atom expected", int(m_s - m_begin - 1));
+        }
+    }
+
+    /// If the next term is an integer in the range 0..255, skip it and
+    /// store its value in \a b.
+    bool byte(uint8_t& b) {
+        check(1);
+        switch ((uint8_t)*m_s) {
+            case ERL_SMALL_INTEGER_EXT:
+                m_s++;
+                b = get8();
+                return true;
+            case ERL_INTEGER_EXT: {
+                check(5);
+                const char* s = m_s + 1;
+                uint32_t n = eixx::get32be(s);
+                if (n > 255)
+                    return false;
+                m_s = s;
+                b = n;
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    /// Lists hash their integer elements in the range 0..255 in groups
+    /// of four. A group ends at the end of the list or at an element that
+    /// isn't a byte, and a new group starts after that element.
+    void list() {
+        uint32_t sh = 0;
+        int      c  = 0;
+        auto add = [&](uint8_t b) {
+            sh = (sh << 8) + b;
+            if (c == 3) {
+                uint32_hash(sh, hconst(4));
+                c = sh = 0;
+            } else
+                c++;
+        };
+        auto flush = [&]() {
+            if (c > 0)
+                uint32_hash(sh, hconst(4));
+            c = sh = 0;
+        };
+
+        // A list tail that is a list continues the current group
+        for (;;) {
+            check(1);
+            switch ((uint8_t)*m_s) {
+                case ERL_STRING_EXT: {
+                    m_s++;
+                    size_t n = get16be();
+                    for (const uint8_t* p = bytes(n), *e = p + n; p != e; ++p)
+                        add(*p);
+                    flush();
+                    nil();
+                    return;
+                }
+                case ERL_LIST_EXT: {
+                    m_s++;
+                    for (uint32_t i=0, n=get32be(); i < n; i++) {
+                        uint8_t b;
+                        if (byte(b))
+                            add(b);
+                        else {
+                            flush();
+                            term();
+                        }
+                    }
+                    break;
+                }
+                default:    // [] or the tail of an improper list
+                    flush();
+                    term();
+                    return;
+            }
+        }
+    }
+
+    void map() {
+        uint32_t arity = get32be();
+        uint32_hash(arity, hconst(16));
+        if (arity == 0)
+            return;
+        // Pairs are hashed independently and combined, so that their
+        // order doesn't matter
+        uint32_t saved = m_hash, pairs = 0;
+        for (uint32_t i=0; i < arity; i++) {
+            m_hash = 0;
+            term();
+            term();
+            pairs ^= m_hash;
+        }
+        m_hash = saved;
+        uint32_hash(pairs, hconst(19));
+    }
+
+    void term() {
+        check(1);
+        uint8_t tag = (uint8_t)*m_s;
+        switch (tag) {
+            case ERL_STRING_EXT:
+            case ERL_LIST_EXT:
+                list();
+                return;
+            default:
+                m_s++;
+        }
+
+        switch (tag) {
+            case ERL_SMALL_INTEGER_EXT: integer(get8());                    break;
+            case ERL_INTEGER_EXT:       integer((int32_t)get32be());        break;
+            case ERL_SMALL_BIG_EXT: {
+                size_t n = get8();
+                bool   neg = get8();
+                big(bytes(n), n, neg);
+                break;
+            }
+            case ERL_LARGE_BIG_EXT: {
+                size_t n = get32be();
+                bool   neg = get8();
+                big(bytes(n), n, neg);
+                break;
+            }
+            case NEW_FLOAT_EXT: {
+                uint64_t n = get64be();
+                double   d;
+                memcpy(&d, &n, sizeof(d));
+                floating(d);
+                break;
+            }
+            case ERL_FLOAT_EXT: {
+                char s[32];
+                memcpy(s, bytes(31), 31);
+                s[31] = '\0';
+                floating(strtod(s, NULL));
+                break;
+            }
+            case ERL_ATOM_EXT:          { size_t n = get16be(); atom(bytes(n), n, false); break; }
+            case ERL_SMALL_ATOM_EXT:    { size_t n = get8();    atom(bytes(n), n, false); break; }
+            case ERL_ATOM_UTF8_EXT:     { size_t n = get16be(); atom(bytes(n), n, true);  break; }
+            case ERL_SMALL_ATOM_UTF8_EXT: { size_t n = get8();  atom(bytes(n), n, true);  break; }
+            case ERL_SMALL_TUPLE_EXT:
+            case ERL_LARGE_TUPLE_EXT: {
+                uint32_t arity = tag == ERL_SMALL_TUPLE_EXT ? get8() : get32be();
+                uint32_hash(arity, hconst(9));
+                for (uint32_t i=0; i < arity; i++)
+                    term();
+                break;
+            }
+            case ERL_NIL_EXT:
+                nil();
+                break;
+            case ERL_MAP_EXT:
+                map();
+                break;
+            case ERL_BINARY_EXT: {
+                size_t n = get32be();
+                binary(bytes(n), n, 0);
+                break;
+            }
+            case ERL_BIT_BINARY_EXT: {
+                size_t  n    = get32be();
+                uint8_t bits = get8();
+                if (n == 0 || bits == 0 || bits > 8)
+                    throw err_decode_exception("Invalid bit binary", int(m_s - m_begin));
+                const uint8_t* p = bytes(n);
+                if (bits == 8)
+                    binary(p, n, 0);
+                else
+                    binary(p, n-1, bits);
+                break;
+            }
+            // Only the pid's number, the port's number and the first word
+            // of the reference's id are hashed. The high word of a 64-bit
+            // port number is mixed in next to the low one, which leaves the
+            // hash of ports below 2^32 unchanged.
+            case ERL_PID_EXT:
+            case ERL_NEW_PID_EXT: {
+                skip_atom();
+                uint32_t id = get32be();
+                bytes(4 + (tag == ERL_PID_EXT ? 1 : 4));    // serial, creation
+                uint32_hash(id, hconst(5));
+                break;
+            }
+            case ERL_PORT_EXT:
+            case ERL_NEW_PORT_EXT:
+            case ERL_V4_PORT_EXT: {
+                skip_atom();
+                uint64_t id = tag == ERL_V4_PORT_EXT ? get64be() : get32be();
+                bytes(tag == ERL_PORT_EXT ? 1 : 4);         // creation
+                uint32_hash((uint32_t)id, (uint32_t)(id >> 32), hconst(6));
+                break;
+            }
+            case ERL_REFERENCE_EXT: {
+                skip_atom();
+                uint32_t id = get32be();
+                bytes(1);                                   // creation
+                uint32_hash(id, hconst(7));
+                break;
+            }
+            case ERL_NEW_REFERENCE_EXT:
+            case ERL_NEWER_REFERENCE_EXT: {
+                size_t n = get16be();
+                skip_atom();
+                bytes(tag == ERL_NEW_REFERENCE_EXT ? 1 : 4);// creation
+                if (n == 0)
+                    throw err_decode_exception("Invalid reference", int(m_s - m_begin));
+                uint32_t id = get32be();
+                bytes(4*(n-1));
+                uint32_hash(id, hconst(7));
+                break;
+            }
+            default:
+                throw err_decode_exception("Unsupported term type", tag);
+        }
+    }
+
+public:
+    /// Default range of erlang:phash2/1.
+    static const uint64_t DEF_RANGE = 1u << 27;
+
+    /**
+     * Compute erlang:phash2(Term, Range) of a term encoded in \a buf.
+     * @param buf    is the buffer holding the term.
+     * @param idx    is the offset of the term in the buffer. On return it
+     *               points past the term.
+     * @param size   is the size of the buffer.
+     * @param range  is the range of the hash value (1..2^32).
+     * @return a value in the range 0..range-1.
+     */
+    static uint32_t hash(const char* buf, int& idx, size_t size, uint64_t range = DEF_RANGE)
+        throw (err_decode_exception, err_bad_argument)
+    {
+        if (range == 0 || range > (1ull << 32))
+            throw err_bad_argument("Invalid phash2 range", range);
+        phash2 h(buf + idx, size - idx);
+        h.term();
+        idx += int(h.m_s - h.m_begin);
+        return range == (1ull << 32) ? h.m_hash : uint32_t(h.m_hash % range);
+    }
+
+    /**
+     * Compute erlang:phash2(Term, Range) of a term encoded in \a buf
+     * with an optional leading version byte.
+     */
+    static uint32_t hash(const char* buf, size_t size, uint64_t range = DEF_RANGE)
+        throw (err_decode_exception, err_bad_argument)
+    {
+        int idx = size > 0 && (uint8_t)buf[0] == ERL_VERSION_MAGIC ? 1 : 0;
+        return hash(buf, idx, size, range);
+    }
+};
+
+} // namespace marshal
+} // namespace eixx
+
+#endif // _EIXX_PHASH2_HPP_
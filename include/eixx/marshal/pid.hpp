@@ -88,11 +88,13 @@ class epid {
         }
     }
 
+    friend class eterm<Alloc>;
+
     // Must only be called from constructor!
     void init(const atom& node, int id, uint8_t creation, const Alloc& alloc)
         throw(err_bad_argument)
     {
-        m_blob = new blob<pid_blob, Alloc>(1, alloc);
+        m_blob = blob<pid_blob, Alloc>::create(1, alloc);
         new (m_blob->data()) pid_blob(node, id, creation);
         #ifdef EIXX_DEBUG
         std::cerr << "Initialized pid " << *this
@@ -163,7 +165,7 @@ public:
         if (this != &rhs) {
             release();
             m_blob = rhs.m_blob;
-            if (!m_blob) m_blob->inc_rc();
+            if (m_blob) m_blob->inc_rc();
         }
         return *this;
     }
@@ -208,6 +210,10 @@ public:
     }
     bool operator!= (const epid<Alloc>& rhs) const { return !(*this == rhs); }
 
+    uint32_t hash() const {
+        return eixx::detail::hash_combine(node().hash(), id_internal());
+    }
+
     /** less operator, needed for maps */
     bool operator< (const epid<Alloc>& t2) const {
         int n = node().compare(t2.node());
@@ -217,7 +223,7 @@ public:
         if (id_internal() > t2.id_internal())   return false;
         return false;
     }
-    size_t encode_size() const { return 13 + node().size(); }
+    size_t encode_size() const { return 10 + node().encode_size(); }
 
     void encode(char* buf, int& idx, size_t size) const;
 
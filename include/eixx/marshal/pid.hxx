@@ -36,16 +36,14 @@ template <class Alloc>
 void epid<Alloc>::decode(const char *buf, int& idx, size_t size, const Alloc& alloc)
     throw(err_decode_exception, err_bad_argument)
 {
-    const char* s  = buf + idx;
-    const char* s0 = s;
-    if (get8(s) != ERL_PID_EXT || get8(s) != ERL_ATOM_EXT)
+    if (buf[idx] != ERL_PID_EXT)
         throw err_decode_exception("Error decoding pid", -1);
 
-    int len = get16be(s);
-    detail::check_node_length(len);
-
-    atom l_node(s, len);
-    s += len;
+    // The node may be an atom cache reference
+    int i = idx + 1;
+    atom l_node(buf, i, size, false);
+    detail::check_node_length(l_node.size());
+    const char* s = buf + i;
 
     uint64_t i1 = get32be(s);
     uint64_t i2 = get32be(s);
@@ -54,7 +52,7 @@ void epid<Alloc>::decode(const char *buf, int& idx, size_t size, const Alloc& al
 
     init(l_node, l_id, l_creation, alloc);
 
-    idx += s - s0;
+    idx = s - buf;
     BOOST_ASSERT((size_t)idx <= size);
 }
 
@@ -64,12 +62,9 @@ void epid<Alloc>::encode(char* buf, int& idx, size_t size) const
     char* s  = buf + idx;
     char* s0 = s;
     put8(s,ERL_PID_EXT);
-    put8(s,ERL_ATOM_EXT);
-    const std::string& nd = node().to_string();
-    unsigned short n = nd.size();
-    put16be(s, n);
-    memmove(s, nd.c_str(), n);
-    s += n;
+    int i = idx + 1;
+    node().encode(buf, i, size);
+    s = buf + i;
 
     /* now the integers */
     put32be(s, id() & 0x7fff); /* 15 bits */
@@ -61,11 +61,13 @@ class port {
             m_blob->release();
     }
 
+    friend class eterm<Alloc>;
+
     // Must only be called from constructor!
     void init(const atom& node, int id, uint8_t creation, 
               const Alloc& alloc) throw(err_bad_argument) 
     {
-        m_blob = new blob<port_blob, Alloc>(1, alloc);
+        m_blob = blob<port_blob, Alloc>::create(1, alloc);
         new (m_blob->data()) port_blob(node, id & 0x0fffffff, creation & 0x03);
     }
 
@@ -154,6 +156,11 @@ public:
         return id() == t.id() && node() == t.node() && creation() == t.creation();
     }
 
+    uint32_t hash() const {
+        uint32_t h = eixx::detail::hash_combine(node().hash(), id());
+        return eixx::detail::hash_combine(h, creation());
+    }
+
     /// Less operator, needed for maps
     bool operator<(const port<Alloc>& rhs) const {
         int n = node().compare(rhs.node());
@@ -166,7 +173,7 @@ public:
         return false;
     }
 
-    size_t encode_size() const { return 9 + node().size(); }
+    size_t encode_size() const { return 6 + node().encode_size(); }
 
     void encode(char* buf, int& idx, size_t size) const;
 
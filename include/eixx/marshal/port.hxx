@@ -36,20 +36,20 @@ template <class Alloc>
 port<Alloc>::port(const char *buf, int& idx, size_t size, const Alloc& a_alloc)
     throw(err_decode_exception)
 {
-    const char* s  = buf + idx;
-    const char* s0 = s;
-    if (get8(s) != ERL_PORT_EXT || get8(s) != ERL_ATOM_EXT)
+    if (buf[idx] != ERL_PORT_EXT)
         throw err_decode_exception("Error decoding port", -1);
-    int len = get16be(s);
-    detail::check_node_length(len);
-    atom l_node(s, len);
-    s += len;
+
+    // The node may be an atom cache reference
+    int i = idx + 1;
+    atom l_node(buf, i, size, false);
+    detail::check_node_length(l_node.size());
+    const char* s = buf + i;
 
     int     l_id  = get32be(s)  & 0x0fffffff;   /* 28 bits */
     uint8_t l_cre = get8(s)     & 0x03;         /* 2 bits */
     init(l_node, l_id, l_cre, a_alloc);
 
-    idx += s - s0;
+    idx = s - buf;
     BOOST_ASSERT((size_t)idx <= size);
 }
 
@@ -59,12 +59,9 @@ void port<Alloc>::encode(char* buf, int& idx, size_t size) const
     char* s  = buf + idx;
     char* s0 = s;
     put8(s,ERL_PORT_EXT);
-    put8(s,ERL_ATOM_EXT);
-    const std::string& str = node().to_string();
-    unsigned short n = str.size();
-    put16be(s, n);
-    memmove(s, str.c_str(), n);
-    s += n;
+    int i = idx + 1;
+    node().encode(buf, i, size);
+    s = buf + i;
 
     /* now the integers */
     put32be(s, id() & 0x0fffffff);  /* 28 bits */
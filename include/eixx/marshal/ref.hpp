@@ -75,7 +75,7 @@ class ref {
     void init(const atom& a_node, uint32_t a_id0, uint64_t a_id1, uint8_t a_cre,
               const Alloc& alloc) throw(err_bad_argument)
     {
-        m_blob = new blob<ref_blob, Alloc>(1, alloc);
+        m_blob = blob<ref_blob, Alloc>::create(1, alloc);
         new (m_blob->data()) ref_blob(a_node, a_id0, a_id1, a_cre);
     }
 
@@ -84,6 +84,8 @@ class ref {
             m_blob->release();
     }
 
+    friend class eterm<Alloc>;
+
     uint32_t id0() const { return m_blob->data()->u.s.id0; }
     uint64_t id1() const { return m_blob->data()->u.s.id1; }
 
@@ -199,6 +201,13 @@ public:
                ::memcmp(&m_blob->data()->u, &t.m_blob->data()->u, sizeof(m_blob->data()->u)) == 0;
     }
 
+    uint32_t hash() const {
+        uint32_t h = node().hash();
+        for (size_t i=0; i < COUNT; i++)
+            h = eixx::detail::hash_combine(h, ids()[i]);
+        return h;
+    }
+
     /// Less operator, needed for maps
     bool operator<(const ref<Alloc>& rhs) const {
         if (!rhs.m_blob)        return m_blob;
@@ -213,7 +222,7 @@ public:
     }
 
     size_t encode_size() const
-    { return 1+2+(3+node().size()) + COUNT*4 + 1; }
+    { return 1+2+node().encode_size() + COUNT*4 + 1; }
 
     void encode(char* buf, int& idx, size_t size) const;
 
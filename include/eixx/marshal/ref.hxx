@@ -47,13 +47,11 @@ ref<Alloc>::ref(const char* buf, int& idx, size_t size, const Alloc& a_alloc)
             int count = get16be(s);
             if (count != COUNT)
                 throw err_decode_exception("Error decoding ref's count", idx+1);
-            if (get8(s) != ERL_ATOM_EXT)
-                throw err_decode_exception("Error decoding ref's atom", idx+3);
-
-            int len = get16be(s);
-            detail::check_node_length(len);
-            atom l_node(s, len);
-            s += len;
+            // The node may be an atom cache reference
+            int i = s - buf;
+            atom l_node(buf, i, size, false);
+            detail::check_node_length(l_node.size());
+            s = buf + i;
 
             uint8_t  l_creation = get8(s) & 0x03;
             uint32_t l_id0 = get32be(s);
@@ -78,12 +76,9 @@ void ref<Alloc>::encode(char* buf, int& idx, size_t size) const
     /* first, number of integers */
     put16be(s, COUNT);
     /* then the nodename */
-    put8(s,ERL_ATOM_EXT);
-    const std::string& str = node().to_string();
-    unsigned short n = str.size();
-    put16be(s, n);
-    memmove(s, str.c_str(), n);
-    s += n;
+    int i = s - buf;
+    node().encode(buf, i, size);
+    s = buf + i;
 
     /* now the integers */
     if (m_blob) {
@@ -46,64 +46,59 @@ template <class Alloc>
 class string
 {
 protected:
-    blob<char, Alloc>* m_blob;
+    // Strings of up to char_blob::capacity-1 characters are stored inline.
+    char_blob<Alloc> m_blob;
 
-    void release() {
-        if (m_blob)
-            m_blob->release();
+    void release() { m_blob.release(); }
+
+    static uint32_t chars_hash(const char* s, size_t n) {
+        uint32_t h = n;
+        for (const char* end = s + n; s != end; ++s)
+            h = eixx::detail::hash_combine(h, eixx::detail::hash_combine(
+                    LONG, eixx::detail::hash_u64((unsigned char)*s)));
+        return h;
     }
 
+    friend class eterm<Alloc>;
+
 public:
     typedef const char* const_iterator;
 
     static const string& null() { static string s; return s; }
 
-    string() : m_blob(nullptr) {}
+    string() {}
 
     string(size_t a_sz, const Alloc& a = Alloc())
-        : m_blob(new blob<char, Alloc>(a_sz+1, a))
+        : m_blob(a_sz+1, a)
     {
-        m_blob->data()[m_blob->size()-1] = '\0';
+        m_blob.data()[a_sz] = '\0';
     }
 
     string(const char* s, const Alloc& a = Alloc()) {
         BOOST_ASSERT(s);
-        if (!s[0]) {
-            m_blob = nullptr;
+        if (!s[0])
             return;
-        }
-        m_blob = new blob<char, Alloc>(strlen(s)+1, a);
-        memcpy(m_blob->data(), s, m_blob->size()-1);
-        m_blob->data()[m_blob->size()-1] = '\0';
+        size_t n = strlen(s);
+        new (&m_blob) char_blob<Alloc>(s, n+1, a);
     }
     string(const std::string& s, const Alloc& a = Alloc()) {
-        if (s.empty()) {
-            m_blob = nullptr;
+        if (s.empty())
             return;
-        }
-        m_blob = new blob<char, Alloc>(s.size()+1, a);
-        memcpy(m_blob->data(), s.c_str(), m_blob->size());
-        m_blob->data()[m_blob->size()-1] = '\0';
+        new (&m_blob) char_blob<Alloc>(s.c_str(), s.size()+1, a);
     }
     string(const char* s, size_t n, const Alloc& a = Alloc()) {
-        if (n == 0) {
-            m_blob = nullptr;
+        if (n == 0)
             return;
-        }
-        m_blob = new blob<char, Alloc>(n+1, a);
+        new (&m_blob) char_blob<Alloc>(n+1, a);
         if (s != NULL) {
-            memcpy(m_blob->data(), s, m_blob->size());
-            m_blob->data()[m_blob->size()-1] = '\0';
+            memcpy(m_blob.data(), s, n);
+            m_blob.data()[n] = '\0';
         } else
-            m_blob->data()[0] = '\0';
-    }
-    string(const string<Alloc>& s) : m_blob(s.m_blob) {
-        if (m_blob) m_blob->inc_rc();
+            m_blob.data()[0] = '\0';
     }
+    string(const string<Alloc>& s) : m_blob(s.m_blob) {}
 
-    string(string<Alloc>&& s) : m_blob(s.m_blob) {
-        s.m_blob = nullptr;
-    }
+    string(string<Alloc>&& s) : m_blob(std::move(s.m_blob)) {}
 
     string(const char* buf, int& idx, size_t size, const Alloc& a_alloc = Alloc())
         throw(err_decode_exception);
@@ -113,51 +108,44 @@ public:
     }
 
     string<Alloc>& operator= (const string<Alloc>& s) {
-        if (this != &s) {
-            release();
-            m_blob = s.m_blob;
-            if (m_blob) m_blob->inc_rc();
-        }
+        m_blob = s.m_blob;
         return *this;
     }
 
     string<Alloc>& operator= (string<Alloc>&& s) {
-        if (this != &s) {
-            release();
-            m_blob = s.m_blob;
-            s.m_blob = nullptr;
-        }
+        m_blob = std::move(s.m_blob);
         return *this;
     }
 
     void operator= (const std::string& s) {
-        if (!m_blob)
-            new (this) string<Alloc>(s);
-        else {
-            string<Alloc> str(s, m_blob->get_allocator());
-            *this = str;
-        }
+        *this = string<Alloc>(s, m_blob.get_allocator());
     }
 
-    const_iterator begin() const { return m_blob ? c_str() : NULL; }
-    const_iterator end()   const { return m_blob ? c_str()+size() : NULL; }
+    const_iterator begin() const { return m_blob.null() ? NULL : c_str(); }
+    const_iterator end()   const { return m_blob.null() ? NULL : c_str()+size(); }
 
-    const char* c_str()  const { return m_blob ? m_blob->data() : ""; }
-    size_t      size()   const { return m_blob ? m_blob->size()-1 : 0; }
-    std::string to_str() const { return m_blob ? std::string(m_blob->data(), m_blob->size()-1) : ""; }
+    const char* c_str()  const { return m_blob.null() ? "" : m_blob.data(); }
+    size_t      size()   const { return m_blob.null() ? 0  : m_blob.size()-1; }
+    std::string to_str() const { return std::string(c_str(), size()); }
     size_t      length() const { return size(); }
     bool        empty()  const { return c_str()[0] == '\0'; }
 
-    void        clear()        { release(); m_blob = NULL; }
+    void        clear()        { release(); }
+
+    /// Hash value of the string's characters. It is the hash value of the
+    /// list of their codes (see list::hash()), which is an equal term.
+    uint32_t    hash() const { return m_blob.hash(size(), &chars_hash); }
 
     // Use only for debugging
-    int         use_count() const { return m_blob ? m_blob->use_count() : -1000000; }
+    int         use_count() const { return m_blob.null() ? -1000000 : m_blob.use_count(); }
 
     bool operator== (const char* rhs) const {
         return strcmp(c_str(), rhs) == 0;
     }
     bool operator== (const string<Alloc>& rhs) const {
-        return size() == rhs.size() && strcmp(c_str(), rhs.c_str()) == 0;
+        return m_blob.same(rhs.m_blob)
+            || (size() == rhs.size() && !m_blob.hash_mismatch(rhs.m_blob)
+                && strcmp(c_str(), rhs.c_str()) == 0);
     }
     bool operator<  (const string<Alloc>& rhs) const {
         return strcmp(c_str(), rhs.c_str()) < 0;
@@ -208,12 +196,10 @@ string<Alloc>::string(const char* buf, int& idx, size_t size, const Alloc& a_all
     switch (etype) {
         case ERL_STRING_EXT: {
             int len = get16be(s);
-            if (len == 0)
-                m_blob = NULL;
-            else {
-                m_blob = new blob<char, Alloc>(len+1, a_alloc);
-                memcpy(m_blob->data(), s, len);
-                m_blob->data()[len] = '\0';
+            if (len > 0) {
+                new (&m_blob) char_blob<Alloc>(len+1, a_alloc);
+                memcpy(m_blob.data(), s, len);
+                m_blob.data()[len] = '\0';
                 s += len;
             }
             break;
@@ -225,21 +211,21 @@ string<Alloc>::string(const char* buf, int& idx, size_t size, const Alloc& a_all
              * non-character in the list.
              */
             int len = get32be(s);
-            if (len == 0)
-                m_blob = NULL;
-            else {
-                m_blob = new blob<char, Alloc>(len+1, a_alloc);
+            if (len > 0) {
+                new (&m_blob) char_blob<Alloc>(len+1, a_alloc);
+                char* p = m_blob.data();
                 for (int i=0; i<len; i++) {
-                    if ((etype = get8(s)) != ERL_SMALL_INTEGER_EXT)
+                    if ((etype = get8(s)) != ERL_SMALL_INTEGER_EXT) {
+                        release();
                         throw err_decode_exception("Error decoding string", s+i-s0);
-                    m_blob->data()[i] = get8(s);
+                    }
+                    p[i] = get8(s);
                 }
-                m_blob->data()[len] = '\0';
+                p[len] = '\0';
             }
             break;
         }
         case ERL_NIL_EXT:
-            m_blob = NULL;
             break;
 
         default:
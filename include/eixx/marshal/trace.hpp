@@ -123,6 +123,8 @@ public:
         return static_cast<const tuple<Alloc>&>(this) < static_cast<const tuple<Alloc>&>(rhs);
     }
 
+    uint32_t hash() const { return tuple<Alloc>::hash(); }
+
     size_t encode_size() const { return tuple<Alloc>::encode_size(); }
 
     void encode(char* buf, int& idx, size_t size) const {
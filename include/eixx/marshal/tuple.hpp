@@ -61,13 +61,20 @@ class tuple {
     void release() { release(m_blob); m_blob = nullptr; }
 
     void release(blob<eterm<Alloc>, Alloc>* p) {
-        if (p && p->release(false)) {
-            for(size_t i=0, n=size(); i < n; i++)
-                p->data()[i].~eterm();
-            p->free();
-        }
+        if (p && p->dec_rc())
+            free_blob(p);
+    }
+
+    /// Destroy tuple's elements and free its storage after the reference
+    /// count dropped to 0.
+    static void free_blob(blob<eterm<Alloc>, Alloc>* p) {
+        for(size_t i=0, n=p->size()-1; i < n; i++)
+            p->data()[i].~eterm();
+        p->free();
     }
 
+    friend class eterm<Alloc>;
+
 protected:
     template <typename V>
     void init_element(size_t i, const V& v) {
@@ -84,7 +91,7 @@ public:
     tuple() : m_blob(NULL) {}
 
     explicit tuple(size_t arity, const Alloc& alloc = Alloc())
-        : m_blob(new blob<eterm<Alloc>, Alloc>(arity+1, alloc))
+        : m_blob(blob<eterm<Alloc>, Alloc>::create(arity+1, alloc))
     {
         memset(m_blob->data(), 0, sizeof(eterm<Alloc>)*m_blob->size());
         set_init_size(0);
@@ -104,7 +111,7 @@ public:
         : tuple(items, N, alloc) {}
 
     tuple(const eterm<Alloc>* items, size_t a_size, const Alloc& alloc = Alloc())
-        : m_blob(new blob<eterm<Alloc>, Alloc>(a_size+1, alloc)) {
+        : m_blob(blob<eterm<Alloc>, Alloc>::create(a_size+1, alloc)) {
         for(size_t i=0; i < a_size; i++) {
             new (&m_blob->data()[i]) eterm<Alloc>(items[i]);
         }
@@ -145,6 +152,8 @@ public:
     }
 
     bool operator== (const tuple<Alloc>& rhs) const {
+        if (m_blob == rhs.m_blob)
+            return true;
         if (size() != rhs.size())
             return false;
         for(const_iterator it1 = begin(),
@@ -163,6 +172,7 @@ public:
 
     eterm<Alloc>& operator[] (int idx) {
         BOOST_ASSERT(m_blob && (size_t)idx < size());
+        m_blob->reset_hash();
         return m_blob->data()[idx];
     }
 
@@ -180,11 +190,30 @@ public:
 
     bool   initialized()   const   { return size() == get_init_size(); }
 
-    iterator       begin()         { BOOST_ASSERT(m_blob); return m_blob->data();   }
+    iterator       begin()         { BOOST_ASSERT(m_blob); m_blob->reset_hash(); return m_blob->data(); }
     iterator       end()           { BOOST_ASSERT(m_blob); return &m_blob->data()[m_blob->size()-1]; }
     const_iterator begin() const   { BOOST_ASSERT(m_blob); return m_blob->data();   }
     const_iterator end()   const   { BOOST_ASSERT(m_blob); return &m_blob->data()[m_blob->size()-1]; }
 
+    /// Hash value of the tuple's elements. It is cached in the tuple's
+    /// storage once the tuple is initialized, unless an element can be
+    /// changed in place through another term sharing it.
+    uint32_t hash() const {
+        BOOST_ASSERT(m_blob);
+        if (uint32_t h = m_blob->cached_hash())
+            return h;
+        uint32_t h = size();
+        bool cache = initialized();
+        for (const_iterator it = begin(), iend = end(); it != iend; ++it) {
+            h = eixx::detail::hash_combine(h, it->hash());
+            cache &= !is_mutable_type(it->type());
+        }
+        h = detail::nonzero_hash(h);
+        if (cache)
+            m_blob->cache_hash(h);
+        return h;
+    }
+
     size_t encode_size() const {
         BOOST_ASSERT(initialized());
         size_t result = size() <= 0xff ? 2 : 5;
@@ -43,7 +43,7 @@ tuple<Alloc>::tuple(const char* buf, int& idx, size_t size, const Alloc& a_alloc
     int arity;
     if (ei_decode_tuple_header(buf, &idx, &arity) < 0)
         err_decode_exception("Error decoding tuple header", idx);
-    m_blob = new blob<eterm<Alloc>, Alloc>(arity+1, a_alloc);
+    m_blob = blob<eterm<Alloc>, Alloc>::create(arity+1, a_alloc);
     for (int i=0; i < arity; i++) {
         new (&m_blob->data()[i]) eterm<Alloc>(buf, idx, size, a_alloc);
     }
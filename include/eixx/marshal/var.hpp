@@ -53,7 +53,8 @@ class var
     template <class Alloc>
     bool check_type(const eterm<Alloc>& t) const {
         return is_any() || m_type == UNDEFINED || t.type() == m_type
-            || (m_type == STRING && t.is_list() && t.to_list().empty());
+            || (m_type == STRING && t.is_list() && t.to_list().empty())
+            || (m_type == LIST   && t.type() == STRING);
     }
 
     eterm_type set(eterm_type t) { return m_name == am_ANY_ ? UNDEFINED : t; }
@@ -70,12 +71,13 @@ public:
     var(const var& v)                                       : var(v.name(), v.type()) {}
 
     const char*             c_str()         const { return m_name.c_str(); }
-    const std::string&      str()           const { return m_name.to_string(); }
+    std::string             str()           const { return m_name.to_string(); }
     atom                    name()          const { return m_name; }
     size_t                  length()        const { return m_name.length(); }
 
     eterm_type              type()          const { return m_type; }
     bool                    is_any()        const { return name() == am_ANY_; }
+    uint32_t                hash()          const { return m_name.hash(); }
 
     std::string to_string() const {
         std::stringstream s;
@@ -42,7 +42,8 @@ public:
         : buf(a_buf), idx(a_idx), size(a_size)
     {}
 
-    void operator() (bool   a) const { ei_encode_boolean (buf, &idx, a); }
+    // Booleans are atoms, so they are encoded like the atoms of a connection
+    void operator() (bool   a) const { (a ? "true"_atom : "false"_atom).encode(buf, idx, size); }
     void operator() (long   a) const { ei_encode_longlong(buf, &idx, a); }
     void operator() (double a) const { ei_encode_double  (buf, &idx, a); }
 
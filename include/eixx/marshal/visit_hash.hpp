@@ -0,0 +1,59 @@
+//----------------------------------------------------------------------------
+/// \file  visit_hash.hpp
+//----------------------------------------------------------------------------
+/// \brief A class implementing hash value calculating visitor.
+//----------------------------------------------------------------------------
+// Copyright (c) 2010 Serge Aleynikov <saleyn@gmail.com>
+// Created: 2026-10-17
+//----------------------------------------------------------------------------
+/*
+***** BEGIN LICENSE BLOCK *****
+
+Copyright 2010 Serge Aleynikov <saleyn at gmail dot com>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+***** END LICENSE BLOCK *****
+*/
+
+#ifndef _IMPL_VISIT_HASH_HPP_
+#define _IMPL_VISIT_HASH_HPP_
+
+#include <string.h>
+#include <eixx/marshal/visit.hpp>
+#include <eixx/util/hashtable.hpp>
+
+namespace eixx {
+namespace marshal {
+
+template <typename Alloc>
+struct visit_eterm_hash
+    : public static_visitor<visit_eterm_hash<Alloc>, uint32_t> {
+
+    uint32_t operator()(bool   a) const { return a; }
+    uint32_t operator()(long   a) const { return eixx::detail::hash_u64(a); }
+    uint32_t operator()(double a) const {
+        uint64_t n = 0;
+        if (a != 0.0)   // 0.0 == -0.0
+            memcpy(&n, &a, sizeof(n));
+        return eixx::detail::hash_u64(n);
+    }
+
+    template <typename T>
+    uint32_t operator()(const T& a) const { return a.hash(); }
+};
+
+} // namespace marshal
+} // namespace eixx
+
+#endif // _IMPL_VISIT_HASH_HPP_
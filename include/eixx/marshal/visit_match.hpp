@@ -49,10 +49,22 @@ public:
 
     bool operator()(const tuple<Alloc>& a) const { return a.match(m_pattern, m_binding); }
     bool operator()(const list<Alloc>&  a) const { return a.match(m_pattern, m_binding); }
+    bool operator()(const map<Alloc>&   a) const { return a.match(m_pattern, m_binding); }
     bool operator()(const var&          a) const { return a.match(m_pattern, m_binding); }
 
+    bool operator()(const string<Alloc>& a) const {
+        // A string matches a list pattern of its characters' codes
+        if (m_pattern.type() == LIST)
+            return list_view<Alloc>(eterm<Alloc>(a)).match(m_pattern, m_binding);
+        return match_value(a);
+    }
+
+    template <typename T>
+    bool operator()(const T& a) const { return match_value(a); }
+
+private:
     template <typename T>
-    bool operator()(const T& a) const {
+    bool match_value(const T& a) const {
         // default behaviour.
         eterm<Alloc> et(a);
         if (m_pattern.type() == VAR)
@@ -49,6 +49,7 @@ public:
 
     bool operator()(const tuple<Alloc>& a) const { return a.subst(m_out, m_binding); }
     bool operator()(const list<Alloc>&  a) const { return a.subst(m_out, m_binding); }
+    bool operator()(const map<Alloc>&   a) const { return a.subst(m_out, m_binding); }
     bool operator()(const var&          a) const { return a.subst(m_out, m_binding); }
 
     template <typename T>
@@ -29,14 +29,25 @@ limitations under the License.
 #ifndef _EIXX_ATOM_TABLE_HPP_
 #define _EIXX_ATOM_TABLE_HPP_
 
+#include <algorithm>
+#include <atomic>
 #include <string>
 #include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <boost/assert.hpp>
 #include <eixx/marshal/defaults.hpp>
 #include <eixx/marshal/endian.hpp>
 #include <eixx/marshal/string.hpp>
 #include <eixx/eterm_exception.hpp>
 #include <eixx/util/hashtable.hpp>
+#include <eixx/util/string_util.hpp>
 #include <ei.h>
 
 namespace eixx {
@@ -51,21 +62,320 @@ namespace util {
     /// and its content is never cleared.  The table contains a unique
     /// list of strings represented as atoms added throughout the lifetime
     /// of the application.
-    template
-    <
-        typename String  = std::string,
-        typename Vector  = std::vector<String>,
-        typename HashMap = char_int_hash_map,
-        typename Mutex   = eid::mutex
-    >
-    class basic_atom_table : private detail::hsieh_hash_fun {
-        static const int s_default_max_atoms = 1024*1024;
-
-        int find_value(size_t bucket, const char* a_atom) {
-            typename HashMap::const_local_iterator
-                lit = m_index.begin(bucket), lend = m_index.end(bucket);
-            while(lit != lend && strcmp(a_atom, lit->first) != 0) ++lit;
-            return lit == lend ? -1 : lit->second;
+    ///
+    /// Atom names are stored in UTF-8, and a name may have up to 255
+    /// (MAXATOMLEN-1) characters, i.e. up to 1020 bytes.
+    ///
+    /// Atom names are appended to an arena of chunks allocated as the
+    /// table grows. Each name is preceded by its 32-bit length and followed
+    /// by NUL, and the table of names maps an atom's index to the first
+    /// character of its name and its length, so that either is found with
+    /// a single indexed load. The table of names and the index are sized
+    /// for the maximum number of atoms, but they are allocated zeroed with
+    /// calloc(), so that their memory is committed as the table fills up.
+    ///
+    /// Atoms are found through a fixed-size open-addressed index, whose
+    /// slots hold the atom's hash value and its position in the table.
+    /// Since the table never shrinks, lookups don't take any locks: a slot
+    /// is published with a release store after the atom's name was stored.
+    /// Insertion of new atoms is serialized by a mutex, so that concurrent
+    /// insertions of the same name end up with the same index.
+    ///
+    /// Optionally the table has a bounded second tier for transient atoms
+    /// that are only seen in decoded terms (see lookup_transient()). Such
+    /// atoms have negative indices, which combine a slot of the tier with
+    /// the generation of the slot's occupant. Terms holding a transient atom
+    /// keep a reference to its slot (see acquire()), and when the tier is
+    /// full, an atom that isn't referenced and wasn't used recently is
+    /// evicted (using the CLOCK algorithm), so the slot of an atom is never
+    /// reused while a term holds it. A plain atom value doesn't hold a
+    /// reference, and accessing the name of an evicted atom throws
+    /// err_bad_argument. The index only keeps the lower bits of the
+    /// generation, so a stale index may refer to the new occupant of its
+    /// slot after the slot was reused 2^15 times or more.
+    /// A transient atom that is looked up with lookup() (i.e. created by
+    /// the application rather than decoded) is pinned in the tier and never
+    /// evicted, so that an atom has a single index. Since the lookup of a
+    /// pinned atom takes the mutex, it's slower than that of a permanent one.
+    ///
+    /// The permanent atoms can be saved to a snapshot file, which is loaded
+    /// at startup by mapping it to memory (see save() and load()), so that
+    /// the atoms get the same indices without looking them up one by one.
+    template <typename Mutex = eid::mutex>
+    class basic_atom_table {
+    public:
+        /// Name of an atom: its NUL-terminated characters and its length.
+        struct name_t {
+            const char* name;
+            size_t      len;
+        };
+    private:
+        static const int    s_default_max_atoms = 1024*1024;
+        /// Size of an arena chunk holding atom names.
+        static const size_t s_chunk_size        = 64*1024;
+
+        /// Index slot: hash value in the upper 32 bits and the atom's
+        /// position in the lower 32 bits. Position 0 belongs to the empty
+        /// atom, which is not indexed, so an empty slot is 0.
+        typedef std::atomic<uint64_t> slot_t;
+
+        enum {
+            /// Maximum size of the transient tier (the other 15 or more bits
+            /// of a transient index hold the generation).
+            s_max_transient = 1 << 16,
+            /// Maximum number of characters of an atom's name.
+            s_max_chars     = MAXATOMLEN - 1,
+            /// Maximum number of bytes of an atom's name.
+            s_max_bytes     = 4*s_max_chars,
+            /// Size of a transient atom's name record for names of up to
+            /// s_max_chars bytes, and of the record for longer names.
+            s_tname_size    = (sizeof(uint32_t) + s_max_chars + 1 + 3) & ~3,
+            s_tname_max     = (sizeof(uint32_t) + s_max_bytes + 1 + 3) & ~3
+        };
+
+        /// Header of a snapshot file. It's followed by the hash values and
+        /// by the name records of atoms 1 through count-1, the latter in the
+        /// arena format. The file uses the native byte order.
+        struct snapshot_header {
+            char     magic[8];
+            uint32_t version;
+            uint32_t count;         // Number of atoms including the empty one
+            uint64_t names_size;    // Size of the name records
+            uint64_t checksum;      // checksum() of the data after the header
+        };
+
+        static const char* snapshot_magic() { return "EIXXATOM"; }
+
+        /// Fletcher checksum of the \a n bytes at \a p (a multiple of 4)
+        /// computed a 32-bit word at a time, which is much cheaper than
+        /// hashing the names of the atoms.
+        static uint64_t checksum(const char* p, size_t n) {
+            uint64_t a = 0, b = 0;
+            for (const char* end = p + n; p != end; p += sizeof(uint32_t)) {
+                uint32_t w;
+                memcpy(&w, p, sizeof(w));
+                a += w;
+                b += a;
+            }
+            return (b << 32 | b >> 32) ^ a;
+        }
+
+        static size_t record_size(size_t n) {
+            return (sizeof(uint32_t) + n + 1 + 3) & ~size_t(3);
+        }
+
+        /// Reference count of a vacant slot of the transient tier.
+        static const uint32_t s_dead = 0xFFFFFFFF;
+
+        /// Slot of the transient tier.
+        struct tslot {
+            /// Generation of the slot's occupant, incremented on eviction
+            std::atomic<uint32_t> gen;
+            /// Number of references held by terms, s_dead while the slot
+            /// is being reused
+            std::atomic<uint32_t> refs;
+            /// Referenced bit of the CLOCK algorithm
+            std::atomic<bool>     used;
+            bool                  pinned;
+            uint32_t              hash;
+            /// Next slot + 1 in the same bucket, 0 ends the chain
+            uint32_t              next;
+            /// Name record allocated when the slot is first occupied, and
+            /// replaced by one of s_tname_max bytes for a longer name
+            char*                 name;
+            bool                  long_name;
+        };
+
+        /// True if the name \a a_name of \a n bytes isn't too long.
+        static bool valid_length(const char* a_name, size_t n) {
+            return n <= s_max_chars
+                || (n <= s_max_bytes && utf8_length(a_name, n) <= s_max_chars);
+        }
+
+        /// Find the atom \a a_name of \a n bytes with hash value \a h.
+        /// @return atom's index or -1 if it's not in the table, in which
+        ///         case \a a_slot is the empty slot where it belongs.
+        int find_value(uint32_t h, const char* a_name, size_t n, size_t& a_slot) const {
+            for (size_t i = h & m_mask;; i = (i+1) & m_mask) {
+                uint64_t v = m_index[i].load(std::memory_order_acquire);
+                if (v == 0) {
+                    a_slot = i;
+                    return -1;
+                }
+                if (uint32_t(v >> 32) == h) {
+                    int k = uint32_t(v);
+                    const name_t& e = m_names[k];
+                    if (e.len == n && memcmp(e.name, a_name, n) == 0)
+                        return k;
+                }
+            }
+        }
+
+        static size_t name_length(const char* a_name) {
+            return reinterpret_cast<const uint32_t*>(a_name)[-1];
+        }
+
+        static size_t index_size(size_t a_max_atoms) {
+            // Keep the load factor of the index below 1/2
+            size_t n = 16;
+            while (n < 2*a_max_atoms) n <<= 1;
+            return n;
+        }
+
+        /// Copy the name \a a_name of \a n bytes to the arena.
+        /// @return pointer to the copy.
+        const char* store(const char* a_name, size_t n) {
+            // Length prefix, characters and NUL, rounded up to keep
+            // length prefixes aligned.
+            size_t sz = record_size(n);
+            if (m_chunk_left < sz) {
+                char* p = static_cast<char*>(malloc(s_chunk_size));
+                if (!p)
+                    throw std::bad_alloc();
+                m_chunks.push_back(p);
+                m_chunk_ptr  = p;
+                m_chunk_left = s_chunk_size;
+            }
+            char* p = m_chunk_ptr;
+            *reinterpret_cast<uint32_t*>(p) = n;
+            p += sizeof(uint32_t);
+            memcpy(p, a_name, n);
+            p[n] = '\0';
+            m_chunk_ptr  += sz;
+            m_chunk_left -= sz;
+            return p;
+        }
+
+        /// Add the atom \a a_name of \a n bytes with hash value \a h to
+        /// the permanent table at the empty index slot \a a_slot. Must be
+        /// called under m_lock.
+        int insert(uint32_t h, const char* a_name, size_t n, size_t a_slot) {
+            int k = m_count.load(std::memory_order_relaxed);
+            if ((size_t)(k+1) == m_capacity)
+                throw std::runtime_error("Atom hash table is full!");
+            m_names[k].name = store(a_name, n);
+            m_names[k].len  = n;
+            m_count.store(k+1, std::memory_order_release);
+            m_index[a_slot].store(uint64_t(h) << 32 | k, std::memory_order_release);
+            return k;
+        }
+
+        int transient_index(size_t i) const {
+            uint32_t gen = m_tslots[i].gen.load(std::memory_order_relaxed) & m_tgen_mask;
+            return int(0x80000000u | gen << m_tbits | uint32_t(i));
+        }
+
+        /// True if \a n is the index of the current occupant of the slot \a t.
+        bool current(const tslot& t, int n) const {
+            return ((uint32_t)n & 0x7fffffff) >> m_tbits
+                == (t.gen.load(std::memory_order_acquire) & m_tgen_mask);
+        }
+
+        /// Find the transient atom \a a_name of \a n bytes with hash
+        /// value \a h. Must be called under m_lock.
+        /// @return atom's slot + 1 or 0 if it's not in the transient tier.
+        size_t tfind(uint32_t h, const char* a_name, size_t n) const {
+            for (uint32_t i = m_tbuckets[h & m_tmask]; i; i = m_tslots[i-1].next) {
+                const tslot& t = m_tslots[i-1];
+                const char*  p = t.name + sizeof(uint32_t);
+                if (t.hash == h && name_length(p) == n && memcmp(p, a_name, n) == 0)
+                    return i;
+            }
+            return 0;
+        }
+
+        /// Find a slot of the transient tier that isn't referenced and
+        /// wasn't used since the last pass of the clock hand and remove its
+        /// atom from the tier. Must be called under m_lock.
+        /// @return the slot + 1 or 0 if all atoms are pinned or referenced.
+        size_t evict() {
+            for (size_t k = 0, n = 2*(m_tmask+1); k < n; k++) {
+                size_t i = m_thand;
+                m_thand  = (m_thand + 1) & m_tmask;
+                tslot& t = m_tslots[i];
+                if (t.pinned || t.refs.load(std::memory_order_relaxed) != 0
+                             || t.used.exchange(false, std::memory_order_relaxed))
+                    continue;
+                // A term may have taken a reference since it was checked
+                uint32_t r = 0;
+                if (!t.refs.compare_exchange_strong(r, s_dead, std::memory_order_acquire))
+                    continue;
+                uint32_t* p = &m_tbuckets[t.hash & m_tmask];
+                while (*p != i+1)
+                    p = &m_tslots[*p-1].next;
+                *p = t.next;
+                t.gen.store(t.gen.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+                ++m_evicted;
+                return i+1;
+            }
+            return 0;
+        }
+
+        /// Add the atom \a a_name of \a n bytes with hash value \a h to
+        /// the transient tier. Must be called under m_lock.
+        /// @return atom's index or 0 if the tier is full of pinned atoms.
+        int tinsert(uint32_t h, const char* a_name, size_t n) {
+            size_t i = m_tcount < m_tmask+1 ? ++m_tcount : evict();
+            if (i-- == 0)
+                return 0;
+            tslot& t = m_tslots[i];
+            if (!t.name)
+                t.name = zalloc<char>(n <= s_max_chars ? s_tname_size : s_tname_max);
+            else if (n > s_max_chars && !t.long_name) {
+                // The former name stays valid for readers of an evicted atom
+                m_tretired.push_back(t.name);
+                t.name = zalloc<char>(s_tname_max);
+            }
+            t.long_name = t.long_name || n > s_max_chars;
+            *reinterpret_cast<uint32_t*>(t.name) = n;
+            memcpy(t.name + sizeof(uint32_t), a_name, n);
+            t.name[sizeof(uint32_t) + n] = '\0';
+            t.hash   = h;
+            t.pinned = false;
+            t.used.store(true, std::memory_order_relaxed);
+            t.next   = m_tbuckets[h & m_tmask];
+            m_tbuckets[h & m_tmask] = i+1;
+            // Publish the name and the new generation to acquire()
+            t.refs.store(0, std::memory_order_release);
+            return transient_index(i);
+        }
+
+        /// Slot of the transient atom with index \a n or NULL if it was
+        /// evicted. The atom is marked as used.
+        tslot* transient_slot(int n) const {
+            BOOST_ASSERT(m_tslots);
+            tslot& t = m_tslots[(uint32_t)n & m_tmask];
+            if (!current(t, n))
+                return nullptr;
+            if (!t.used.load(std::memory_order_relaxed))
+                t.used.store(true, std::memory_order_relaxed);
+            return &t;
+        }
+
+        /// Name of the transient atom with index \a n. The name is only
+        /// stable while the atom is referenced (see acquire()), since the
+        /// slot of an evicted atom is reused.
+        /// @throws err_bad_argument if the atom was evicted.
+        const char* transient_name(int n) const {
+            const tslot* t = transient_slot(n);
+            if (!t)
+                throw err_bad_argument("Atom was evicted from transient atom table", n);
+            return t->name + sizeof(uint32_t);
+        }
+
+        template <typename T>
+        static T* zalloc(size_t n) {
+            T* p = static_cast<T*>(calloc(n, sizeof(T)));
+            if (!p)
+                throw std::bad_alloc();
+            return p;
+        }
+
+        /// Length-prefixed record of the empty atom.
+        static const char* empty_name() {
+            alignas(uint32_t) static const char s_empty[sizeof(uint32_t)+1] = {0};
+            return s_empty + sizeof(uint32_t);
         }
     public:
         /// Returns the default atom table maximum size. The value can be
@@ -76,69 +386,412 @@ namespace util {
             return n > 0 && n < 1024*1024*100 ? n : s_default_max_atoms;
         }
 
+        /// Returns the default size of the transient atom tier, which is
+        /// disabled (0) unless the EI_TRANSIENT_ATOM_TABLE_SIZE environment
+        /// variable is set.
+        static size_t default_transient_size() {
+            const char* p = getenv("EI_TRANSIENT_ATOM_TABLE_SIZE");
+            int n = p ? atoi(p) : 0;
+            return n > 0 ? std::min<size_t>(n, s_max_transient) : 0;
+        }
+
         /// Returns the maximum number of atoms that can be stored in the atom table.
-        size_t capacity()  const { return m_atoms.capacity(); }
+        size_t capacity()  const { return m_capacity; }
 
         /// Returns the current number of atoms stored in the atom table.
-        size_t allocated() const { return m_atoms.size();     }
+        size_t allocated() const { return m_count.load(std::memory_order_acquire); }
+
+        /// Returns the number of slots of the transient tier (0 if disabled).
+        size_t transient_capacity()  const { return m_tslots ? m_tmask+1 : 0; }
+
+        /// Returns the number of atoms in the transient tier.
+        size_t transient_allocated() const {
+            lock_guard<Mutex> guard(m_lock);
+            return m_tcount;
+        }
 
-        explicit basic_atom_table(int a_max_atoms = default_size())
-            : m_index(a_max_atoms) {
-            m_atoms.reserve(a_max_atoms);
-            m_atoms.push_back(""); // The 0-th element is an empty atom ("").
-            m_index[""] = 0;
+        /// Returns the number of atoms evicted from the transient tier.
+        size_t evicted() const {
+            lock_guard<Mutex> guard(m_lock);
+            return m_evicted;
+        }
+
+        /// Create an atom table that holds up to \a a_max_atoms atoms.
+        /// The \a n names in \a a_predefined are added to the table in
+        /// the given order, so that they get indices 1 through \a n.
+        /// If \a a_transient_atoms is not 0, the table has a transient
+        /// tier of that many atoms rounded up to a power of 2.
+        explicit basic_atom_table(int a_max_atoms = default_size(),
+                                  const char* const* a_predefined = nullptr,
+                                  size_t n = 0,
+                                  size_t a_transient_atoms = 0)
+            : m_capacity(a_max_atoms)
+            , m_mask(index_size(a_max_atoms) - 1)
+            , m_index(zalloc<slot_t>(m_mask + 1))
+            , m_names(zalloc<name_t>(a_max_atoms))
+            , m_count(1)
+            , m_chunk_ptr(nullptr), m_chunk_left(0)
+            , m_tslots(nullptr), m_tbuckets(nullptr)
+            , m_tmask(0), m_tbits(0), m_tgen_mask(0)
+            , m_tcount(0), m_thand(0), m_evicted(0)
+        {
+            m_names[0].name = empty_name(); // The 0-th element is an empty atom ("").
+            if (a_transient_atoms) {
+                BOOST_ASSERT(a_transient_atoms <= (size_t)s_max_transient);
+                while ((size_t(1) << m_tbits) < a_transient_atoms) m_tbits++;
+                m_tmask     = (size_t(1) << m_tbits) - 1;
+                m_tgen_mask = (1u << (31 - m_tbits)) - 1;
+                m_tslots    = zalloc<tslot>(m_tmask+1);
+                m_tbuckets  = zalloc<uint32_t>(m_tmask+1);
+            }
+            for (size_t i=0; i < n; i++) {
+                int idx = lookup(a_predefined[i]);
+                BOOST_ASSERT((size_t)idx == i+1); (void)idx;
+            }
         }
 
         ~basic_atom_table() {
             lock_guard<Mutex> guard(m_lock);
-            m_atoms.clear();
-            m_index.clear();
+            for (char* p : m_chunks)
+                free(p);
+            for (size_t i=0; i < m_tcount; i++)
+                free(m_tslots[i].name);
+            for (char* p : m_tretired)
+                free(p);
+            free(m_tslots);
+            free(m_tbuckets);
+            free(m_names);
+            free(m_index);
+            for (auto& m : m_maps)
+                munmap(m.first, m.second);
+        }
+
+        /// Save the permanent atoms to the snapshot file \a a_file. The
+        /// file is written under a temporary name and then renamed, so
+        /// that a snapshot being loaded is never partially written.
+        /// @throws std::runtime_error if the file can't be written.
+        void save(const std::string& a_file) const {
+            lock_guard<Mutex> guard(m_lock);
+            snapshot_header hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            memcpy(hdr.magic, snapshot_magic(), sizeof(hdr.magic));
+            hdr.version    = 2;
+            hdr.count      = m_count.load(std::memory_order_relaxed);
+            hdr.names_size = 0;
+            for (size_t k=1; k < hdr.count; k++)
+                hdr.names_size += record_size(m_names[k].len);
+
+            // Hash values followed by the name records
+            size_t hash_bytes = (hdr.count-1) * sizeof(uint32_t);
+            std::vector<char> data(hash_bytes + hdr.names_size);
+            char* q = data.data() + hash_bytes;
+            for (size_t k=1; k < hdr.count; k++) {
+                const char* p = m_names[k].name;
+                size_t      n = m_names[k].len;
+                uint32_t    h = eid::hsieh_hash_fun::hash(p, n);
+                memcpy(&data[(k-1) * sizeof(uint32_t)], &h, sizeof(h));
+                memcpy(q, p - sizeof(uint32_t), sizeof(uint32_t) + n + 1);
+                q += record_size(n);
+            }
+            hdr.checksum = checksum(data.data(), data.size());
+
+            std::string tmp = a_file + ".tmp";
+            FILE* f = fopen(tmp.c_str(), "wb");
+            if (!f)
+                throw std::runtime_error("Cannot create atom table snapshot "
+                                         + tmp + ": " + strerror(errno));
+            bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1
+                   && fwrite(data.data(), 1, data.size(), f) == data.size();
+            if (fclose(f) != 0 || !ok || rename(tmp.c_str(), a_file.c_str()) != 0) {
+                int err = errno;
+                unlink(tmp.c_str());
+                throw std::runtime_error("Cannot write atom table snapshot "
+                                         + a_file + ": " + strerror(err));
+            }
+        }
+
+        /// Load the atoms saved by save() to the snapshot file \a a_file.
+        /// The file is mapped to memory, which holds the names of loaded
+        /// atoms, so that they aren't copied and inserted one by one. The
+        /// atoms get the same indices as in the table that saved them.
+        /// The saved hash values are used as they are: the file is checked
+        /// against the checksum that save() stored in it instead, so that a
+        /// corrupted snapshot is rejected without hashing the names.
+        /// The atoms already in this table (e.g. the predefined ones) must
+        /// be the first atoms of the snapshot, so it's meant to be loaded
+        /// at startup before the table is used by other threads.
+        /// @throws std::runtime_error if the snapshot can't be loaded, in
+        ///         which case the table is left unchanged, so that the
+        ///         application can go on with the atoms it has.
+        void load(const std::string& a_file) {
+            int fd = open(a_file.c_str(), O_RDONLY);
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) < 0) {
+                int err = errno;
+                if (fd >= 0) close(fd);
+                throw std::runtime_error("Cannot open atom table snapshot "
+                                         + a_file + ": " + strerror(err));
+            }
+            size_t size = st.st_size;
+            void*  m    = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+            int    err  = errno;
+            close(fd);
+            if (m == MAP_FAILED)
+                throw std::runtime_error("Cannot map atom table snapshot "
+                                         + a_file + ": " + strerror(err));
+            try {
+                load_snapshot(static_cast<const char*>(m), size);
+            } catch (std::exception& e) {
+                munmap(m, size);
+                throw std::runtime_error(e.what() + (": " + a_file));
+            }
+            lock_guard<Mutex> guard(m_lock);
+            m_maps.push_back(std::make_pair(m, size));
+        }
+
+        /// Lookup an atom's name in the atom table by index.
+        const char* get(int n) const { return (*this)[n]; }
+
+        /// Lookup an atom's name in the atom table by index.
+        /// @throws err_bad_argument if it's an evicted transient atom.
+        const char* operator[] (int n) const {
+            if (n < 0)
+                return transient_name(n);
+            BOOST_ASSERT((size_t)n < allocated());
+            return m_names[n].name;
+        }
+
+        /// Check if the atom with index \a n can be used, i.e. it's not
+        /// an evicted transient atom, and mark it as recently used.
+        bool touch(int n) const {
+            return n >= 0 || transient_slot(n) != nullptr;
+        }
+
+        /// Take a reference to the atom with index \a n, so that it isn't
+        /// evicted until the reference is released with release(). This
+        /// does nothing to permanent atoms.
+        /// @return false if it's an evicted transient atom.
+        bool acquire(int n) const {
+            if (n >= 0)
+                return true;
+            tslot&   t = m_tslots[(uint32_t)n & m_tmask];
+            uint32_t r = t.refs.load(std::memory_order_relaxed);
+            do {
+                if (r == s_dead)
+                    return false;
+            } while (!t.refs.compare_exchange_weak(r, r+1, std::memory_order_acquire,
+                                                           std::memory_order_relaxed));
+            if (!current(t, n)) {
+                t.refs.fetch_sub(1, std::memory_order_release);
+                return false;
+            }
+            if (!t.used.load(std::memory_order_relaxed))
+                t.used.store(true, std::memory_order_relaxed);
+            return true;
+        }
+
+        /// Take another reference to the atom with index \a n, which
+        /// the caller already holds a reference to.
+        void ref(int n) const {
+            if (n < 0)
+                m_tslots[(uint32_t)n & m_tmask].refs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /// Release a reference to the atom with index \a n taken by
+        /// acquire() or ref().
+        void release(int n) const {
+            if (n < 0)
+                m_tslots[(uint32_t)n & m_tmask].refs.fetch_sub(1, std::memory_order_release);
+        }
+
+        /// Generation of the slot of the atom with index \a n (0 for
+        /// permanent atoms). Unlike the index, it has all 32 bits, so that
+        /// a cache can tell if a transient atom it stored was replaced.
+        uint32_t generation(int n) const {
+            return n >= 0 ? 0
+                 : m_tslots[(uint32_t)n & m_tmask].gen.load(std::memory_order_acquire);
         }
 
-        /// Lookup an atom in the atom table by index.
-        const String& get(int n) const { return (*this)[n]; }
+        /// Length of the name of the atom with index \a n.
+        size_t length(int n) const {
+            return n < 0 ? name_length(transient_name(n)) : m_names[n].len;
+        }
 
-        /// Lookup an atom in the atom table by index.
-        const String& operator[] (int n) const {
-            BOOST_ASSERT((size_t)n < m_atoms.size());
-            return m_atoms[n];
+        /// Name and length of the atom with index \a n.
+        /// @throws err_bad_argument if it's an evicted transient atom.
+        name_t name(int n) const {
+            if (n >= 0) {
+                BOOST_ASSERT((size_t)n < allocated());
+                return m_names[n];
+            }
+            const char* p = transient_name(n);
+            return name_t{p, name_length(p)};
         }
 
         /// Lookup an atom in the atom table by name. If the atom is not
         /// present in the atom table - add it.  Return the index of the 
-        /// atom in the atom table.
+        /// atom in the atom table. The name doesn't need to be
+        /// NUL-terminated, and finding an existing atom doesn't allocate.
         /// @throws std::runtime_error if atom table is full.
-        /// @throws err_bad_argument if atom size is longer than MAXATOMLEN
-        int lookup(const char* a_name, size_t n) { return lookup(String(a_name, n)); }
-        int lookup(const char* a_name)           { return lookup(String(a_name)); }
-        int lookup(const String& a_name)
+        /// @throws err_bad_argument if atom is longer than MAXATOMLEN-1
+        ///         characters
+        int lookup(const char* a_name, size_t len)
             throw(std::runtime_error, err_bad_argument)
         {
-            if (a_name.size() == 0)
+            return lookup(a_name, len, eid::hsieh_hash_fun::hash(a_name, len));
+        }
+
+        /// Lookup an atom like lookup(a_name, len) given the hash value
+        /// \a h of its name computed by eid::hsieh_hash_fun::hash(),
+        /// which allows to compute it at compile time.
+        int lookup(const char* a_name, size_t len, uint32_t h)
+            throw(std::runtime_error, err_bad_argument)
+        {
+            if (len == 0)
                 return 0;
-            if (a_name.size() > MAXATOMLEN)
+            if (!valid_length(a_name, len))
                 throw err_bad_argument("Atom size is too long!");
-            size_t bucket = m_index.bucket(a_name.c_str());
-            int n = find_value(bucket, a_name.c_str());
+            size_t slot = 0;
+            int n = find_value(h, a_name, len, slot);
             if (n >= 0)
                 return n;
 
             lock_guard<Mutex> guard(m_lock);
-            n = find_value(bucket, a_name.c_str());
+            // Another thread might have added the atom or taken the slot
+            n = find_value(h, a_name, len, slot);
             if (n >= 0)
                 return n;
+            if (m_tslots) {
+                if (size_t i = tfind(h, a_name, len)) {
+                    m_tslots[i-1].pinned = true;
+                    return transient_index(i-1);
+                }
+            }
+            return insert(h, a_name, len, slot);
+        }
 
-            n = m_atoms.size();
-            if ((size_t)(n+1) == m_atoms.capacity())
-                throw std::runtime_error("Atom hash table is full!");
-            m_atoms.push_back(a_name);
-            m_index[m_atoms.back().c_str()] = n;
-            return n;
+        /// Lookup an atom like lookup(), but add a new atom to the
+        /// transient tier if the table has one. This is meant for atoms
+        /// received from remote nodes, so that their number doesn't grow
+        /// the permanent table. A transient atom may be evicted as soon
+        /// as it's returned, unless a reference to it is acquired.
+        /// @param a_gen unless NULL, is set to the atom's generation
+        ///        (see generation()).
+        /// @throws std::runtime_error if atom table is full.
+        /// @throws err_bad_argument if atom is longer than MAXATOMLEN-1
+        ///         characters
+        int lookup_transient(const char* a_name, size_t len, uint32_t* a_gen = nullptr)
+            throw(std::runtime_error, err_bad_argument)
+        {
+            if (a_gen)
+                *a_gen = 0;
+            if (!m_tslots || len == 0 || !valid_length(a_name, len))
+                return lookup(a_name, len);
+            uint32_t h = eid::hsieh_hash_fun::hash(a_name, len);
+            size_t slot = 0;
+            int n = find_value(h, a_name, len, slot);
+            if (n >= 0)
+                return n;
+
+            lock_guard<Mutex> guard(m_lock);
+            n = find_value(h, a_name, len, slot);
+            if (n >= 0)
+                return n;
+            size_t i = tfind(h, a_name, len);
+            if (i)
+                m_tslots[i-1].used.store(true, std::memory_order_relaxed);
+            else if ((n = tinsert(h, a_name, len)) != 0)
+                i = ((uint32_t)n & m_tmask) + 1;
+            else
+                return insert(h, a_name, len, slot);
+            if (a_gen)
+                *a_gen = m_tslots[i-1].gen.load(std::memory_order_relaxed);
+            return transient_index(i-1);
         }
+
+        /// @copydoc lookup
+        int lookup(const char* a_name)        { return lookup(a_name, strlen(a_name)); }
+        /// @copydoc lookup
+        int lookup(const std::string& a_name) { return lookup(a_name.c_str(), a_name.size()); }
     private:
-        Vector  m_atoms;
-        HashMap m_index;
-        Mutex   m_lock;
+        /// Load the snapshot of \a a_size bytes at \a a_data, which must
+        /// remain valid for the lifetime of the table.
+        void load_snapshot(const char* a_data, size_t a_size) {
+            snapshot_header hdr;
+            if (a_size < sizeof(hdr))
+                throw std::runtime_error("Invalid atom table snapshot");
+            memcpy(&hdr, a_data, sizeof(hdr));
+            size_t hash_bytes = size_t(hdr.count ? hdr.count-1 : 0) * sizeof(uint32_t);
+            if (memcmp(hdr.magic, snapshot_magic(), sizeof(hdr.magic)) != 0
+             || hdr.version != 2 || hdr.count == 0 || hdr.names_size % sizeof(uint32_t)
+             || a_size != sizeof(hdr) + hash_bytes + hdr.names_size)
+                throw std::runtime_error("Invalid atom table snapshot");
+            if (hdr.checksum != checksum(a_data + sizeof(hdr), a_size - sizeof(hdr)))
+                throw std::runtime_error("Invalid checksum of atom table snapshot");
+
+            // Hash value of the k-th atom is hashes[k-1]
+            const uint32_t* hashes = reinterpret_cast<const uint32_t*>(a_data + sizeof(hdr));
+            const char*     p      = a_data + sizeof(hdr) + hash_bytes;
+            const char*     end    = p + hdr.names_size;
+
+            lock_guard<Mutex> guard(m_lock);
+            if (hdr.count >= m_capacity)
+                throw std::runtime_error("Atom table snapshot doesn't fit in the atom table");
+            if (m_tcount)
+                throw std::runtime_error("Atom table snapshot must be loaded before transient atoms");
+
+            // Validate all records before the table is modified
+            size_t count = m_count.load(std::memory_order_relaxed);
+            std::vector<const char*> names(hdr.count);
+            for (size_t k=1; k < hdr.count; k++) {
+                size_t n = end - p < (ptrdiff_t)sizeof(uint32_t) ? 0 : name_length(p + sizeof(uint32_t));
+                if (n == 0 || n > s_max_bytes || (size_t)(end - p) < record_size(n)
+                 || p[sizeof(uint32_t) + n] != '\0')
+                    throw std::runtime_error("Invalid atom table snapshot");
+                names[k] = p + sizeof(uint32_t);
+                if (k < count && (m_names[k].len != n || memcmp(m_names[k].name, names[k], n) != 0))
+                    throw std::runtime_error("Atom table snapshot doesn't match the atom table");
+                p += record_size(n);
+            }
+            if (p != end || hdr.count < count)
+                throw std::runtime_error("Atom table snapshot doesn't match the atom table");
+
+            // Index the new atoms in the order they were added to the
+            // saved table
+            for (size_t k=count; k < hdr.count; k++) {
+                uint32_t h = hashes[k-1];
+                size_t   i = h & m_mask;
+                while (m_index[i].load(std::memory_order_relaxed))
+                    i = (i+1) & m_mask;
+                m_names[k].name = names[k];
+                m_names[k].len  = name_length(names[k]);
+                m_index[i].store(uint64_t(h) << 32 | k, std::memory_order_release);
+            }
+            m_count.store(hdr.count, std::memory_order_release);
+        }
+
+        const size_t        m_capacity;
+        const size_t        m_mask;
+        slot_t*             m_index;
+        name_t*             m_names;
+        std::atomic<size_t> m_count;
+        mutable Mutex       m_lock;
+        // Arena of atom names (modified under m_lock)
+        std::vector<char*>  m_chunks;
+        char*               m_chunk_ptr;
+        size_t              m_chunk_left;
+        // Transient tier (modified under m_lock)
+        tslot*              m_tslots;
+        uint32_t*           m_tbuckets;
+        size_t              m_tmask;
+        uint32_t            m_tbits;
+        uint32_t            m_tgen_mask;
+        size_t              m_tcount;
+        size_t              m_thand;
+        size_t              m_evicted;
+        std::vector<char*>  m_tretired;     // Replaced name records
+        // Mapped snapshot files
+        std::vector<std::pair<void*, size_t>> m_maps;
     };
 
     typedef basic_atom_table<> atom_table;
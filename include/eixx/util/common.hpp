@@ -103,6 +103,20 @@ private:
     uint32_t m_value;
 };
 
+/// Non-atomic counterpart of atomic<T> for data confined to a single thread.
+template <typename T>
+struct plain_counter {
+    plain_counter(T a = 0): m_value(a) {}
+    T operator++ ()                 { return ++m_value; }
+    T operator-- ()                 { return --m_value; }
+    T operator++ (int)              { return m_value++; }
+    operator T () const             { return m_value; }
+    void operator= (const T& rhs)   { m_value = rhs; }
+    void operator+= (const T& a)    { m_value += a; }
+private:
+    T m_value;
+};
+
 /// Return the index of a_string in the a_list using a_default index if 
 /// a_string is not found in the list.
 template <int N>
@@ -53,14 +53,23 @@ struct hash_map_base : public src::unordered_map<K, V, Hash>
 // See http://www.azillionmonkeys.com/qed/hash.html
 // Copyright 2004-2008 (c) by Paul Hsieh 
 struct hsieh_hash_fun {
-    static uint16_t get16bits(const char* d) { return *(const uint16_t *)d; }
+    /// Little-endian 16-bit word at \a d. It's composed of bytes so that
+    /// the hash can be computed at compile time.
+    static constexpr uint16_t get16bits(const char* d) {
+        return uint16_t((uint8_t)d[0] | (uint8_t)d[1] << 8);
+    }
 
     size_t operator()(const char* data) const {
-        int len = strlen(data);
-        uint32_t hash = len, tmp;
-        int rem;
+        return hash(data, strlen(data));
+    }
 
-        if (len <= 0 || data == NULL) return 0;
+    /// Hash \a a_len bytes pointed to by \a data.
+    static constexpr uint32_t hash(const char* data, size_t a_len) {
+        int len = a_len;
+        uint32_t hash = len, tmp = 0;
+        int rem = 0;
+
+        if (len <= 0) return 0;
 
         rem = len & 3;
         len >>= 2;
@@ -102,6 +111,19 @@ struct hsieh_hash_fun {
     }
 };
 
+/// Mix the hash value \a v into \a h.
+inline uint32_t hash_combine(uint32_t h, uint32_t v) {
+    return h ^ (v + 0x9e3779b9 + (h << 6) + (h >> 2));
+}
+
+/// Fold a 64-bit value into a 32-bit hash value.
+inline uint32_t hash_u64(uint64_t v) {
+    v ^= v >> 33;
+    v *= 0xff51afd7ed558ccdULL;
+    v ^= v >> 33;
+    return uint32_t(v);
+}
+
 } // namespace detail
 
 typedef detail::hash_map_base<const char*, size_t, detail::hsieh_hash_fun> char_int_hash_map;
@@ -90,6 +90,71 @@ inline const char* fast_atoi(const char* a_str, const char* a_end, T& res) {
     return a_str;
 }
 
+/// Number of characters of the UTF-8 string \a s of \a n bytes, i.e. the
+/// number of its bytes that don't continue a multi-byte sequence.
+inline size_t utf8_length(const char* s, size_t n) {
+    size_t res = 0;
+    for (const char* end = s + n; s != end; ++s)
+        res += (*s & 0xC0) != 0x80;
+    return res;
+}
+
+/// True if the string \a s of \a n bytes is ASCII, which is the same in
+/// Latin-1 and UTF-8.
+inline bool is_ascii(const char* s, size_t n) {
+    for (const char* end = s + n; s != end; ++s)
+        if (*s & 0x80)
+            return false;
+    return true;
+}
+
+/// Convert the Latin-1 string \a s of \a n bytes to UTF-8 stored at
+/// \a out, which must have room for 2*n bytes.
+/// @return the number of bytes stored at \a out.
+inline size_t latin1_to_utf8(const char* s, size_t n, char* out) {
+    char* p = out;
+    for (const char* end = s + n; s != end; ++s) {
+        uint8_t c = *s;
+        if (c < 0x80)
+            *p++ = c;
+        else {
+            *p++ = 0xC0 | c >> 6;
+            *p++ = 0x80 | (c & 0x3F);
+        }
+    }
+    return p - out;
+}
+
+/// Size of the Latin-1 representation of the UTF-8 string \a s of \a n
+/// bytes.
+/// @return (size_t)-1 if it has characters above U+00FF or an invalid
+///         sequence, so that it can't be converted to Latin-1.
+inline size_t utf8_latin1_size(const char* s, size_t n) {
+    size_t res = 0;
+    for (const char* end = s + n; s != end; ++s, ++res) {
+        uint8_t c = *s;
+        if (c < 0x80)
+            continue;
+        if ((c & 0xFE) != 0xC2 || s+1 == end || (s[1] & 0xC0) != 0x80)
+            return (size_t)-1;
+        ++s;
+    }
+    return res;
+}
+
+/// Convert the UTF-8 string \a s of \a n bytes, which must be
+/// representable in Latin-1 (see utf8_latin1_size()), to Latin-1 stored
+/// at \a out.
+/// @return the number of bytes stored at \a out.
+inline size_t utf8_to_latin1(const char* s, size_t n, char* out) {
+    char* p = out;
+    for (const char* end = s + n; s != end; ++s) {
+        uint8_t c = *s;
+        *p++ = c < 0x80 ? c : (c << 6) | (*++s & 0x3F);
+    }
+    return p - out;
+}
+
 } // namespace eixx
 
 namespace std {
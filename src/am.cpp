@@ -1,50 +0,0 @@
-/*
-***** BEGIN LICENSE BLOCK *****
-
-Copyright 2010 Serge Aleynikov <saleyn at gmail dot com>
-
-Licensed under the Apache License, Version 2.0 (the "License");
-you may not use this file except in compliance with the License.
-You may obtain a copy of the License at
-
-    http://www.apache.org/licenses/LICENSE-2.0
-
-Unless required by applicable law or agreed to in writing, software
-distributed under the License is distributed on an "AS IS" BASIS,
-WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
-See the License for the specific language governing permissions and
-limitations under the License.
-
-***** END LICENSE BLOCK *****
-*/
-
-#include <eixx/marshal/am.hpp>
-#include <boost/concept_check.hpp>
-
-namespace eixx {
-
-    const atom am_badarg            = atom("badarg");
-    const atom am_badrpc            = atom("badrpc");
-    const atom am_call              = atom("call");
-    const atom am_cast              = atom("cast");
-    const atom am_erlang            = atom("erlang");
-    const atom am_error             = atom("error");
-    const atom am_false             = atom("false");
-    const atom am_format            = atom("format");
-    const atom am_gen_cast          = atom("$gen_cast");
-    const atom am_io_lib            = atom("io_lib");
-    const atom am_latin1            = atom("latin1");
-    const atom am_noconnection      = atom("noconnection");
-    const atom am_noproc            = atom("noproc");
-    const atom am_normal            = atom("normal");
-    const atom am_ok                = atom("ok");
-    const atom am_request           = atom("request");
-    const atom am_rex               = atom("rex");
-    const atom am_rpc               = atom("rpc");
-    const atom am_true              = atom("true");
-    const atom am_undefined         = atom("undefined");
-    const atom am_unsupported       = atom("unsupported");
-    const atom am_user              = atom("user");
-
-} // namespace eixx
-
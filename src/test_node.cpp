@@ -37,7 +37,8 @@ static const atom N3 = atom("N3");
 
 bool on_io_request(otp_mailbox& a_mbox, eixx::transport_msg*& a_msg) {
 
-    static const eterm s_put_chars = eterm::format("{io_request,_,_,{put_chars,S}}");
+    static const eterm s_put_chars =
+        eterm::format("{io_request,_,_,{put_chars,S}}").freeze();
 
     if (!a_msg)
         return true;
@@ -53,7 +54,7 @@ bool on_io_request(otp_mailbox& a_mbox, eixx::transport_msg*& a_msg) {
 }
 
 bool on_main_msg(otp_mailbox& a_mbox, eixx::transport_msg*& a_msg) {
-    static const eterm s_now_pattern  = eterm::format("{rex, {N1, N2, N3}}");
+    static const eterm s_now_pattern  = eterm::format("{rex, {N1, N2, N3}}").freeze();
     static const eterm s_stop         = atom("stop");
 
     if (!a_msg)
@@ -23,9 +23,53 @@ limitations under the License.
 #include "test_alloc.hpp"
 #include <eixx/eixx.hpp>
 #include <set>
+#include <thread>
+#include <unordered_map>
 
 using namespace eixx;
 
+// Counts heap allocations made by the current thread while it's alive,
+// to verify that some operations don't allocate. Allocations of other
+// threads and of code outside of its scope aren't counted.
+struct alloc_counter {
+    size_t          count;
+    alloc_counter*  prev;
+
+    alloc_counter()  : count(0), prev(current()) { current() = this; }
+    ~alloc_counter() { current() = prev; }
+
+    static alloc_counter*& current() {
+        static thread_local alloc_counter* s_current = nullptr;
+        return s_current;
+    }
+};
+
+// All the replaceable allocation and deallocation functions are replaced
+// together, so that memory obtained with malloc() is always released with
+// free() (tools like ASan report any mismatch).
+static void* counted_malloc(size_t n) noexcept {
+    if (alloc_counter* c = alloc_counter::current())
+        c->count++;
+    return malloc(n ? n : 1);
+}
+
+static void* counted_new(size_t n) {
+    if (void* p = counted_malloc(n))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new  (size_t n)                          { return counted_new(n); }
+void* operator new[](size_t n)                          { return counted_new(n); }
+void* operator new  (size_t n, const std::nothrow_t&) noexcept { return counted_malloc(n); }
+void* operator new[](size_t n, const std::nothrow_t&) noexcept { return counted_malloc(n); }
+void  operator delete  (void* p) noexcept                        { free(p); }
+void  operator delete[](void* p) noexcept                        { free(p); }
+void  operator delete  (void* p, size_t) noexcept                { free(p); }
+void  operator delete[](void* p, size_t) noexcept                { free(p); }
+void  operator delete  (void* p, const std::nothrow_t&) noexcept { free(p); }
+void  operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
+
 BOOST_AUTO_TEST_CASE( test_atomable )
 {
 	util::atom_table t(10);
@@ -37,6 +81,222 @@ BOOST_AUTO_TEST_CASE( test_atomable )
 	BOOST_REQUIRE_EQUAL(n, t.lookup("abc"));
 }
 
+BOOST_AUTO_TEST_CASE( test_atomable_mt )
+{
+    // Threads adding the same names concurrently get the same indexes
+    util::atom_table t(1000);
+    const int nthreads = 4, natoms = 200;
+    std::vector<std::vector<int>> res(nthreads, std::vector<int>(natoms));
+    std::vector<std::thread> threads;
+    for (int n=0; n < nthreads; n++)
+        threads.emplace_back([&, n]() {
+            for (int i=0; i < natoms; i++)
+                res[n][i] = t.lookup("a" + std::to_string(i));
+        });
+    for (auto& th : threads)
+        th.join();
+    BOOST_REQUIRE_EQUAL(natoms + 1u, t.allocated());
+    for (int i=0; i < natoms; i++) {
+        BOOST_REQUIRE_EQUAL("a" + std::to_string(i), t[res[0][i]]);
+        for (int n=1; n < nthreads; n++)
+            BOOST_REQUIRE_EQUAL(res[0][i], res[n][i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_atomable_arena )
+{
+    // Names of 1 to MAXATOMLEN-1 bytes take about 80KB, which is more than
+    // a 64KB arena chunk, so some names are stored in a new chunk
+    util::atom_table t(1000);
+    std::vector<std::string> names;
+    std::vector<int>         idx;
+    for (int i=0; i < 600; i++) {
+        std::string s = std::to_string(i) + '_';
+        s.resize(std::max(s.size(), size_t(1 + i * 7 % (MAXATOMLEN-1))), 'a' + i % 26);
+        names.push_back(s);
+        idx.push_back(t.lookup(s));
+    }
+    BOOST_REQUIRE_EQUAL(601u, t.allocated());
+    for (size_t i=0; i < names.size(); i++) {
+        util::atom_table::name_t n = t.name(idx[i]);
+        BOOST_REQUIRE_EQUAL(names[i].size(), n.len);
+        BOOST_REQUIRE_EQUAL(names[i].size(), t.length(idx[i]));
+        BOOST_REQUIRE_EQUAL(names[i], std::string(n.name, n.len));
+        BOOST_REQUIRE_EQUAL('\0', n.name[n.len]);
+        BOOST_REQUIRE_EQUAL(n.name, t[idx[i]]);
+        BOOST_REQUIRE_EQUAL(idx[i], t.lookup(names[i]));
+    }
+
+    // atom::to_string() references the name stored in the table
+    atom a("arena_atom");
+    BOOST_REQUIRE(a.to_string() == "arena_atom");
+    BOOST_REQUIRE_EQUAL(a.c_str(), a.to_string().data());
+    std::string s = a.to_string();
+    BOOST_REQUIRE_EQUAL("arena_atom", s);
+}
+
+BOOST_AUTO_TEST_CASE( test_atomable_transient )
+{
+    util::atom_table t(100, nullptr, 0, 4);
+    BOOST_REQUIRE_EQUAL(4u, t.transient_capacity());
+    int perm = t.lookup("perm");
+    BOOST_REQUIRE_EQUAL(perm, t.lookup_transient("perm", 4));
+
+    // Atoms that are only decoded go to the transient tier
+    int a = t.lookup_transient("a", 1);
+    int b = t.lookup_transient("b", 1);
+    int c = t.lookup_transient("c", 1);
+    int d = t.lookup_transient("d", 1);
+    BOOST_REQUIRE(a < 0 && b < 0 && c < 0 && d < 0);
+    BOOST_REQUIRE_EQUAL(c, t.lookup_transient("c", 1));
+    BOOST_REQUIRE_EQUAL("c", t[c]);
+    BOOST_REQUIRE_EQUAL(1u, t.length(c));
+    BOOST_REQUIRE_EQUAL(4u, t.transient_allocated());
+
+    // An atom created by the application is pinned
+    BOOST_REQUIRE_EQUAL(b, t.lookup("b"));
+
+    // The least recently used atom is evicted when the tier is full
+    int e = t.lookup_transient("e", 1);
+    BOOST_REQUIRE(e < 0);
+    BOOST_REQUIRE_EQUAL(1u, t.evicted());
+    BOOST_REQUIRE_THROW(t[a], err_bad_argument);
+    BOOST_REQUIRE_EQUAL("e", t[e]);
+    int a2 = t.lookup_transient("a", 1);
+    BOOST_REQUIRE(a2 < 0 && a2 != a);
+    BOOST_REQUIRE_EQUAL("a", t[a2]);
+
+    for (int i=0; i < 20; i++)
+        BOOST_REQUIRE(t.lookup_transient(("x" + std::to_string(i)).c_str(), 2 + (i > 9)) < 0);
+    BOOST_REQUIRE_EQUAL("b", t[b]);
+    BOOST_REQUIRE_EQUAL(b, t.lookup_transient("b", 1));
+    BOOST_REQUIRE_EQUAL(2u, t.allocated());
+    BOOST_REQUIRE_EQUAL(4u, t.transient_allocated());
+
+    // A referenced atom is never evicted, and its slot isn't reused
+    uint32_t gen;
+    int r = t.lookup_transient("ref", 3, &gen);
+    BOOST_REQUIRE(r < 0);
+    BOOST_REQUIRE_EQUAL(gen, t.generation(r));
+    BOOST_REQUIRE(t.acquire(r));
+    for (int i=0; i < 20; i++)
+        t.lookup_transient(("y" + std::to_string(i)).c_str(), 2 + (i > 9));
+    BOOST_REQUIRE_EQUAL(gen, t.generation(r));
+    BOOST_REQUIRE_EQUAL("ref", t[r]);
+    BOOST_REQUIRE_EQUAL(r, t.lookup_transient("ref", 3));
+    t.ref(r);
+    t.release(r);
+    t.release(r);
+    for (int i=0; i < 20; i++)
+        t.lookup_transient(("z" + std::to_string(i)).c_str(), 2 + (i > 9));
+    BOOST_REQUIRE_THROW(t[r], err_bad_argument);
+    BOOST_REQUIRE(!t.acquire(r));
+    BOOST_REQUIRE(t.generation(r) != gen);
+
+    // When all atoms are pinned or referenced, new ones are permanent
+    int held[2];
+    for (int i=0; i < 2; i++) {
+        held[i] = t.lookup_transient(i ? "h1" : "h0", 2);
+        BOOST_REQUIRE(t.acquire(held[i]));
+    }
+    int z = t.lookup_transient("z", 1);
+    BOOST_REQUIRE(z < 0 && t.acquire(z));
+    BOOST_REQUIRE(t.lookup_transient("perm2", 5) > 0);
+    BOOST_REQUIRE_EQUAL("h0", t[held[0]]);
+    BOOST_REQUIRE_EQUAL("h1", t[held[1]]);
+    for (int i=0; i < 2; i++)
+        t.release(held[i]);
+    t.release(z);
+
+    // Without the transient tier atoms are permanent
+    util::atom_table t2(100);
+    BOOST_REQUIRE_EQUAL(0u, t2.transient_capacity());
+    BOOST_REQUIRE(t2.lookup_transient("a", 1) > 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_atomable_snapshot )
+{
+    const char* names[] = {"x", "y"};
+    const std::string file("test_atom_table.snapshot");
+    std::vector<int> idx;
+    {
+        util::atom_table t(1000, names, 2);
+        for (int i=0; i < 100; i++)
+            idx.push_back(t.lookup("atom_" + std::to_string(i)));
+        t.save(file);
+    }
+    // Atoms get the same indices in a table with the same or another size
+    for (int size : {1000, 100000}) {
+        util::atom_table t(size, names, 2);
+        t.load(file);
+        BOOST_REQUIRE_EQUAL(103u, t.allocated());
+        for (int i=0; i < 100; i++) {
+            std::string s("atom_" + std::to_string(i));
+            BOOST_REQUIRE_EQUAL(s, t[idx[i]]);
+            BOOST_REQUIRE_EQUAL(s.size(), t.length(idx[i]));
+            BOOST_REQUIRE_EQUAL(idx[i], t.lookup(s));
+        }
+        BOOST_REQUIRE_EQUAL(103u, t.allocated());
+        BOOST_REQUIRE_EQUAL(103, t.lookup("new_atom"));
+        BOOST_REQUIRE_EQUAL(1, t.lookup("x"));
+    }
+    {
+        // Atoms of the table must be the first atoms of the snapshot
+        util::atom_table t(1000);
+        t.lookup("z");
+        BOOST_REQUIRE_THROW(t.load(file), std::runtime_error);
+        util::atom_table t2(50);
+        BOOST_REQUIRE_THROW(t2.load(file), std::runtime_error);
+        BOOST_REQUIRE_THROW(t2.load(file + ".missing"), std::runtime_error);
+        BOOST_REQUIRE_EQUAL(1u, t2.allocated());
+    }
+    {
+        // The snapshot of "aa" and "bb" has the header, two hash values
+        // and two 8-byte name records
+        util::atom_table t(100);
+        t.lookup("aa");
+        t.lookup("bb");
+        t.save(file);
+    }
+    std::string data;
+    {
+        FILE* f = fopen(file.c_str(), "rb");
+        BOOST_REQUIRE(f);
+        char buf[256];
+        for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0;)
+            data.append(buf, n);
+        fclose(f);
+        BOOST_REQUIRE_EQUAL(32u + 2*4 + 2*8, data.size());
+    }
+    auto write = [&file](const std::string& a_data) {
+        FILE* f = fopen(file.c_str(), "wb");
+        BOOST_REQUIRE(f);
+        BOOST_REQUIRE_EQUAL(a_data.size(), fwrite(a_data.c_str(), 1, a_data.size(), f));
+        fclose(f);
+    };
+    // A snapshot whose data doesn't match its checksum is rejected, and
+    // the table is left unchanged
+    for (size_t off : {32u + 4u, 32u + 2*4 + 8 + 4, 32u + 2*4 + 2*8 - 1}) {
+        std::string s(data);
+        s[off] ^= 1;
+        write(s);
+        util::atom_table t(100);
+        BOOST_CHECK_EXCEPTION(t.load(file), std::runtime_error, [](const std::runtime_error& e) {
+            return strstr(e.what(), "Invalid checksum") != nullptr;
+        });
+        BOOST_REQUIRE_EQUAL(1u, t.allocated());
+        BOOST_REQUIRE_EQUAL(1, t.lookup("bb"));
+    }
+    {
+        write(data);
+        util::atom_table t(100);
+        t.load(file);
+        BOOST_REQUIRE_EQUAL(3u, t.allocated());
+        BOOST_REQUIRE_EQUAL(2, t.lookup("bb"));
+    }
+    unlink(file.c_str());
+}
+
 BOOST_AUTO_TEST_CASE( test_atom )
 {
     {
@@ -69,6 +329,335 @@ BOOST_AUTO_TEST_CASE( test_atom )
 
         BOOST_REQUIRE_EQUAL("a", et1.to_string(1));
     }
+    {
+        // A name in a character array ends at the first NUL
+        char buf[8] = "abc";
+        BOOST_REQUIRE_EQUAL(atom("abc"), atom(buf));
+        BOOST_REQUIRE_EQUAL(atom("abc"), atom("abcdef", 3));
+    }
+    {
+        // UTF-8 atoms are decoded as their UTF-8 bytes
+        const uint8_t buf[] = {ERL_SMALL_ATOM_UTF8_EXT,4,0xc3,0xa9,97,98,
+                               ERL_ATOM_UTF8_EXT,0,4,0xc3,0xa9,97,98,
+                               ERL_SMALL_ATOM_UTF8_EXT,4,116,114,117,101};
+        int i = 0;
+        atom a((const char*)buf, i, sizeof(buf));
+        BOOST_REQUIRE_EQUAL(6, i);
+        BOOST_REQUIRE_EQUAL(atom("\xc3\xa9" "ab"), a);
+        BOOST_REQUIRE_EQUAL(a, atom((const char*)buf, i, sizeof(buf)));
+        eterm t((const char*)buf, i, sizeof(buf));
+        BOOST_REQUIRE_EQUAL(BOOL, t.type());
+        BOOST_REQUIRE_EQUAL(sizeof(buf), (size_t)i);
+
+        // Encoding for a peer that supports UTF-8 atoms
+        std::string e128;
+        for (int k=0; k < 128; k++) e128 += "\xc3\xa9";
+        eterm et = tuple::make(a, true, std::string(256, 'x'), atom(e128));
+        marshal::atom_cache_scope scope(nullptr, true);
+        string s = et.encode(0);
+        BOOST_REQUIRE_EQUAL(et.encode_size(0, true), s.size());
+        i = 3;
+        BOOST_REQUIRE_EQUAL(ERL_SMALL_ATOM_UTF8_EXT, s.c_str()[i]);
+        BOOST_REQUIRE_EQUAL(a, atom(s.c_str(), i, s.size()));
+        BOOST_REQUIRE_EQUAL(ERL_SMALL_ATOM_UTF8_EXT, s.c_str()[i]);
+        i = 1;
+        BOOST_REQUIRE_EQUAL(et, eterm(s.c_str(), i, s.size()));
+        BOOST_REQUIRE_EQUAL(ERL_ATOM_UTF8_EXT, s.c_str()[s.size() - 259]);
+    }
+    {
+        // Latin-1 atoms are converted to UTF-8
+        const uint8_t buf[] = {ERL_ATOM_EXT,0,3,0xe9,97,98, ERL_SMALL_ATOM_EXT,1,0xff};
+        int i = 0;
+        atom a((const char*)buf, i, sizeof(buf));
+        BOOST_REQUIRE_EQUAL(atom("\xc3\xa9" "ab"), a);
+        BOOST_REQUIRE_EQUAL(atom("\xc3\xbf"), atom((const char*)buf, i, sizeof(buf)));
+        BOOST_REQUIRE_EQUAL(sizeof(buf), (size_t)i);
+
+        // ... and back to Latin-1 when they are encoded with ATOM_EXT
+        eterm t(a);
+        string s = t.encode(0);
+        BOOST_REQUIRE_EQUAL(t.encode_size(0, true), s.size());
+        BOOST_REQUIRE_EQUAL(std::string((const char*)buf, 6), std::string(s.c_str() + 1, 6));
+        i = 1;
+        BOOST_REQUIRE_EQUAL(t, eterm(s.c_str(), i, s.size()));
+
+        // Atoms beyond Latin-1 are encoded in UTF-8
+        t = atom("\xce\xbb");
+        s = t.encode(0);
+        BOOST_REQUIRE_EQUAL(t.encode_size(0, true), s.size());
+        BOOST_REQUIRE_EQUAL(ERL_SMALL_ATOM_UTF8_EXT, s.c_str()[1]);
+        i = 1;
+        BOOST_REQUIRE_EQUAL(t, eterm(s.c_str(), i, s.size()));
+    }
+    {
+        // An atom has up to 255 characters of up to 4 bytes each, and the
+        // longest one is encoded without being truncated
+        std::string n;
+        for (int k=0; k < 255; k++) n += "\xf0\x9f\x98\x80";
+        atom a(n);
+        BOOST_REQUIRE_EQUAL(1020u, a.size());
+        BOOST_REQUIRE_THROW(atom(n + "x"), err_bad_argument);
+        BOOST_REQUIRE_THROW(atom(std::string(256, 'x')), err_bad_argument);
+        BOOST_REQUIRE_EQUAL(255u, atom(std::string(255, 'x')).size());
+
+        eterm t(a);
+        string s = t.encode(0);
+        BOOST_REQUIRE_EQUAL(t.encode_size(0, true), s.size());
+        BOOST_REQUIRE_EQUAL(1u + 3 + 1020, s.size());
+        BOOST_REQUIRE_EQUAL(ERL_ATOM_UTF8_EXT, s.c_str()[1]);
+        int i = 1;
+        BOOST_REQUIRE_EQUAL(t, eterm(s.c_str(), i, s.size()));
+
+        // Decoding a longer atom throws a decode error
+        std::string b = std::string(1, ERL_ATOM_UTF8_EXT) + '\0' + '\x04'
+                      + n.substr(0, 1020) + "x";
+        b[2] = 1021 & 0xFF; b[1] = 1021 >> 8;
+        i = 0;
+        BOOST_REQUIRE_THROW(atom(b.c_str(), i, b.size()), err_decode_exception);
+        b = std::string(1, ERL_ATOM_EXT) + '\x01' + '\x00' + std::string(256, '\xe9');
+        i = 0;
+        BOOST_REQUIRE_THROW(atom(b.c_str(), i, b.size()), err_decode_exception);
+    }
+    {
+        // Finding known atoms doesn't allocate
+        std::vector<eterm> items;
+        for (int i=0; i < 50; i++)
+            items.push_back(atom("known_atom_number_" + std::to_string(i)));
+        string s = eterm(tuple(items.data(), items.size())).encode(0);
+        int idx = 1, arity;
+        ei_decode_tuple_header(s.c_str(), &idx, &arity);
+        BOOST_REQUIRE_EQUAL(50, arity);
+        atom atoms[50];
+        std::string name2("known_atom_number_2");
+        atom a1, a2;
+        size_t count;
+        {
+            alloc_counter allocs;
+            for (int i=0; i < arity; i++)
+                atoms[i] = atom(s.c_str(), idx, s.size());
+            a1 = atom("known_atom_number_1");
+            a2 = atom(name2);
+            count = allocs.count;
+        }
+        BOOST_REQUIRE_EQUAL(0u, count);
+        {
+            alloc_counter allocs;
+            std::unique_ptr<std::string> p(new std::string(name2));
+            BOOST_REQUIRE(allocs.count > 0);
+        }
+        BOOST_REQUIRE_EQUAL(s.size(), (size_t)idx);
+        for (int i=0; i < arity; i++)
+            BOOST_REQUIRE(atoms[i] == items[i].to_atom());
+        BOOST_REQUIRE(a1 == atoms[1] && a2 == atoms[2]);
+    }
+}
+
+static int dispatch(const atom& a)
+{
+    switch (a.index()) {
+        case am::ok:                    return 1;
+        case "error"_atom.index():      return 2;
+        case am_undefined.index():      return 3;
+        default:                        return 0;
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_atom_literal )
+{
+    static_assert(am_ok.index() == am::ok, "am_ok must be well-known");
+    static_assert("$gen_cast"_atom.index() == am::gen_cast, "well-known");
+    static_assert(atom().index() == am::null_, "empty atom");
+
+    // Well-known atoms are at their fixed indices in the atom table
+    BOOST_REQUIRE_EQUAL(std::string("ok"),        am_ok.c_str());
+    BOOST_REQUIRE_EQUAL(std::string("_"),         am_ANY_.c_str());
+    BOOST_REQUIRE_EQUAL(am::gen_call, atom("$gen_call").index());
+    BOOST_REQUIRE_EQUAL(am::ok,       atom("ok").index());
+    BOOST_REQUIRE_EQUAL(am::timeout,  atom(std::string("timeout")).index());
+    BOOST_REQUIRE(atom("true") == am_true);
+
+    BOOST_REQUIRE_EQUAL(1, dispatch(atom("ok")));
+    BOOST_REQUIRE_EQUAL(2, dispatch(am_error));
+    BOOST_REQUIRE_EQUAL(3, dispatch("undefined"_atom));
+    BOOST_REQUIRE_EQUAL(0, dispatch(atom("some_atom")));
+
+    // Other literals are looked up in the atom table
+    atom a = "some_other_literal"_atom;
+    BOOST_REQUIRE(a.index() >= am::count_);
+    BOOST_REQUIRE_EQUAL(atom("some_other_literal"), a);
+    BOOST_REQUIRE_EQUAL(a, "some_other_literal"_atom);
+    BOOST_REQUIRE_EQUAL(atom(), ""_atom);
+}
+
+// Encode a term after a distribution header using the atom cache
+static std::string cache_encode(marshal::atom_cache_out& out, const eterm& t)
+{
+    marshal::atom_cache_scope scope(&out);
+    out.begin();
+    size_t n = t.encode_size(0, false);
+    size_t h = out.header_size();
+    std::string buf(h + n, '\0');
+    char* s = &buf[0];
+    out.encode_header(s);
+    BOOST_REQUIRE_EQUAL(h, (size_t)(s - buf.c_str()));
+    t.encode(s, n, 0, false);
+    return buf;
+}
+
+static eterm cache_decode(marshal::atom_cache_in& in, const std::string& buf)
+{
+    const char* s   = buf.c_str();
+    const char* end = s + buf.size();
+    BOOST_REQUIRE_EQUAL(131, (uint8_t)s[0]);
+    BOOST_REQUIRE_EQUAL('D', s[1]);
+    s += 2;
+    marshal::atom_cache_in::header_refs refs;
+    size_t n = in.decode_header(s, end, refs);
+    marshal::atom_cache_scope scope(refs.data(), n);
+    int i = 0;
+    eterm t(s, i, end - s);
+    BOOST_REQUIRE_EQUAL(end - s, i);
+    return t;
+}
+
+BOOST_AUTO_TEST_CASE( test_atom_cache )
+{
+    allocator_t alloc;
+    std::unique_ptr<marshal::atom_cache_out> out(new marshal::atom_cache_out());
+    std::unique_ptr<marshal::atom_cache_in>  in (new marshal::atom_cache_in());
+
+    eterm t = tuple::make(am_ok, atom("cached_atom"), epid("abc@fc12", 1, 2, 3, alloc),
+                          true, atom("cached_atom"), alloc);
+
+    // New atoms are sent with their names, and only referenced afterwards
+    std::string b1 = cache_encode(*out, t);
+    BOOST_REQUIRE_EQUAL(4u, out->count()); // including the boolean
+    std::string b2 = cache_encode(*out, t);
+    BOOST_REQUIRE(b2.size() < b1.size());
+    BOOST_REQUIRE(b2.find("cached_atom") == std::string::npos);
+
+    eterm t1 = cache_decode(*in, b1);
+    eterm t2 = cache_decode(*in, b2);
+    BOOST_REQUIRE_EQUAL(t, t1);
+    BOOST_REQUIRE_EQUAL(t, t2);
+    BOOST_REQUIRE_EQUAL(BOOL, t2.to_tuple()[3].type());
+    BOOST_REQUIRE_EQUAL(atom("abc@fc12"), t2.to_tuple()[2].to_pid().node());
+
+    // A reference to an entry that the receiver hasn't seen
+    std::unique_ptr<marshal::atom_cache_in> in2(new marshal::atom_cache_in());
+    BOOST_CHECK_THROW(cache_decode(*in2, b2), err_decode_exception);
+
+    // A reference without a distribution header
+    const uint8_t buf[] = {ERL_ATOM_CACHE_REF, 0};
+    int i = 0;
+    BOOST_CHECK_THROW(eterm((const char*)buf, i, sizeof(buf)), err_decode_exception);
+
+    // Terms encoded without an atom cache are unaffected
+    string enc = t.encode(0);
+    i = 1;
+    BOOST_REQUIRE_EQUAL(t, eterm(enc.c_str(), i, enc.size(), alloc));
+}
+
+BOOST_AUTO_TEST_CASE( test_atom_cache_otp )
+{
+    // Two REG_SEND messages from 'a@host' to rex, laid out as an OTP node
+    // encodes them (erl_ext_dist, "Distribution Header"). Every atom of the
+    // control tuple and the payload, including the node of the sender's
+    // pid, is a reference. A cache entry is at the atom's index in the
+    // sender's atom table modulo 2048, i.e. segment = index >> 8.
+    const uint8_t msg1[] = {
+        131, 'D', 4,
+        0x8A, 0x9C, 0x00,                           // all new, short atoms
+        0xA7, 6, 'a','@','h','o','s','t',           // 2:0xA7 'a@host'
+        0x1F, 0,                                    // 0:0x1F ''
+        0x3C, 3, 'r','e','x',                       // 4:0x3C rex
+        0x05, 5, 'h','e','l','l','o',               // 1:0x05 hello
+        // {6, <'a@host'.85.0>, '', rex}
+        ERL_SMALL_TUPLE_EXT, 4, ERL_SMALL_INTEGER_EXT, 6,
+        ERL_PID_EXT, ERL_ATOM_CACHE_REF, 0, 0,0,0,85, 0,0,0,0, 1,
+        ERL_ATOM_CACHE_REF, 1, ERL_ATOM_CACHE_REF, 2,
+        // {hello, 'a@host'}
+        ERL_SMALL_TUPLE_EXT, 2, ERL_ATOM_CACHE_REF, 3, ERL_ATOM_CACHE_REF, 0
+    };
+    const uint8_t msg2[] = {
+        131, 'D', 4,
+        0x02, 0xE4, 0x00,                           // world is new
+        0xA7, 0x1F, 0x3C,
+        0x11, 5, 'w','o','r','l','d',               // 6:0x11 world
+        ERL_SMALL_TUPLE_EXT, 4, ERL_SMALL_INTEGER_EXT, 6,
+        ERL_PID_EXT, ERL_ATOM_CACHE_REF, 0, 0,0,0,85, 0,0,0,0, 1,
+        ERL_ATOM_CACHE_REF, 1, ERL_ATOM_CACHE_REF, 2,
+        ERL_SMALL_TUPLE_EXT, 2, ERL_ATOM_CACHE_REF, 3, ERL_ATOM_CACHE_REF, 0
+    };
+
+    allocator_t alloc;
+    epid  from("a@host", 85, 0, 1, alloc);
+    eterm ctrl = tuple::make(6, from, atom(), atom("rex"), alloc);
+    std::unique_ptr<marshal::atom_cache_in> in(new marshal::atom_cache_in());
+
+    int n = 0;
+    for (auto& m : {std::make_pair((const char*)msg1, sizeof(msg1)),
+                    std::make_pair((const char*)msg2, sizeof(msg2))}) {
+        const char* s   = m.first + 2;
+        const char* end = m.first + m.second;
+        marshal::atom_cache_in::header_refs refs;
+        BOOST_REQUIRE_EQUAL(4u, in->decode_header(s, end, refs));
+        marshal::atom_cache_scope scope(refs.data(), refs.size());
+        int i = 0;
+        eterm c(s, i, end - s, alloc);
+        eterm msg(s, i, end - s, alloc);
+        BOOST_REQUIRE_EQUAL(end - s, i);
+        BOOST_REQUIRE_EQUAL(ctrl, c);
+        BOOST_REQUIRE_EQUAL(eterm(tuple::make(atom(n++ ? "world" : "hello"), atom("a@host"), alloc)), msg);
+        // The node of a pid is always a permanent atom
+        BOOST_REQUIRE(c.to_tuple()[1].to_pid().node().index() > 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_atom_decode_cache )
+{
+    allocator_t alloc;
+    std::string long_name(40, 'x');
+    eterm t = tuple::make(atom("decode_cache1"), atom("decode_cache2"), atom(long_name),
+                          epid("abc@fc12", 1, 2, 3, alloc), atom("decode_cache1"), alloc);
+    string enc = t.encode(0);
+
+    std::unique_ptr<marshal::atom_decode_cache> cache(new marshal::atom_decode_cache());
+    {
+        marshal::atom_cache_scope scope(*cache);
+        int i = 1;
+        BOOST_REQUIRE_EQUAL(t, eterm(enc.c_str(), i, enc.size(), alloc));
+        // The repeated atom is found in the cache, the long one isn't cached
+        BOOST_REQUIRE_EQUAL(1u, cache->hits());
+        BOOST_REQUIRE_EQUAL(4u, cache->misses());
+        i = 1;
+        BOOST_REQUIRE_EQUAL(t, eterm(enc.c_str(), i, enc.size(), alloc));
+        BOOST_REQUIRE_EQUAL(5u, cache->hits());
+        BOOST_REQUIRE_EQUAL(5u, cache->misses());
+    }
+    // The cache is only used in its scope
+    int i = 1;
+    BOOST_REQUIRE_EQUAL(t, eterm(enc.c_str(), i, enc.size(), alloc));
+    BOOST_REQUIRE_EQUAL(5u, cache->hits());
+
+    // The same bytes with a Latin-1 and a UTF-8 tag are cached separately
+    const uint8_t latin1[] = {ERL_SMALL_ATOM_EXT,      2, 0xC3, 0xA9};
+    const uint8_t utf8[]   = {ERL_SMALL_ATOM_UTF8_EXT, 2, 0xC3, 0xA9};
+    {
+        marshal::atom_cache_scope scope(*cache);
+        for (int k=0; k < 2; k++) {
+            i = 0;
+            atom((const char*)latin1, i, sizeof(latin1));
+            i = 0;
+            atom((const char*)utf8, i, sizeof(utf8));
+        }
+        BOOST_REQUIRE_EQUAL(7u, cache->hits());
+        BOOST_REQUIRE_EQUAL(7u, cache->misses());
+        int j = 0;
+        i = 0;
+        BOOST_REQUIRE_EQUAL(atom("\xc3\x83\xc2\xa9"), atom((const char*)latin1, i, sizeof(latin1)));
+        BOOST_REQUIRE_EQUAL(atom("\xc3\xa9"), atom((const char*)utf8, j, sizeof(utf8)));
+    }
 }
 
 BOOST_AUTO_TEST_CASE( test_bool )
@@ -122,6 +711,105 @@ BOOST_AUTO_TEST_CASE( test_binary )
     }
 }
 
+BOOST_AUTO_TEST_CASE( test_binary_slice )
+{
+    allocator_t alloc;
+    std::string data;
+    for (int i=0; i < 1000; i++)
+        data += std::to_string(i) + ',';
+    binary b(data, alloc);
+    BOOST_REQUIRE(!b.is_slice());
+
+    binary s1 = b.slice(10, 100);
+    BOOST_REQUIRE(s1.is_slice());
+    BOOST_REQUIRE_EQUAL(b.data() + 10, s1.data());
+    BOOST_REQUIRE_EQUAL(100u, s1.size());
+    BOOST_REQUIRE(s1 == binary(data.substr(10, 100), alloc));
+
+    // A slice of a slice references the original storage
+    binary s2 = s1.slice(20, 30);
+    BOOST_REQUIRE_EQUAL(b.data() + 30, s2.data());
+    BOOST_REQUIRE(s2 == b.slice(30, 30));
+    BOOST_REQUIRE_EQUAL(std::string(b.data() + 30, 30), std::string(s2.data(), s2.size()));
+
+    // Short slices are stored inline
+    binary s3 = b.slice(0, 4);
+    BOOST_REQUIRE(!s3.is_slice());
+    BOOST_REQUIRE(s3 == binary("0,1,", 4, alloc));
+    BOOST_REQUIRE_EQUAL(0u, b.slice(5, 0).size());
+    BOOST_REQUIRE_EQUAL(0u, b.slice(b.size(), 0).size());
+    BOOST_CHECK_THROW(b.slice(b.size() - 5, 6), err_bad_argument);
+    BOOST_CHECK_THROW(b.slice(b.size() + 1, 0), err_bad_argument);
+
+    // Encoding, decoding and printing use the slice's bytes only
+    eterm t(s1);
+    string enc = t.encode(0);
+    BOOST_REQUIRE_EQUAL(1 + 5 + 100u, enc.size());
+    int i = 1;
+    eterm d(enc.c_str(), i, enc.size(), alloc);
+    BOOST_REQUIRE(d == t);
+    BOOST_REQUIRE_EQUAL(eterm(binary(data.substr(10, 100), alloc)).to_string(), t.to_string());
+    binary s4 = d.to_binary().slice(1, 50);
+    BOOST_REQUIRE(s4 == s1.slice(1, 50));
+    BOOST_REQUIRE_EQUAL(s4.hash(), s1.slice(1, 50).hash());
+
+    // Compacted slice owns its data
+    binary s5 = s1;
+    s5.compact();
+    BOOST_REQUIRE(!s5.is_slice());
+    BOOST_REQUIRE(s5.data() != s1.data());
+    BOOST_REQUIRE(s5 == s1);
+    b = binary();
+    BOOST_REQUIRE(s2 == s1.slice(20, 30));
+}
+
+BOOST_AUTO_TEST_CASE( test_binary_slice_scope )
+{
+    allocator_t alloc;
+    std::string big(10000, 'x');
+    eterm t = tuple::make(binary(big, alloc), binary("abc", 3, alloc), alloc);
+    string s = t.encode(0);
+    binary buf(s.c_str(), s.size(), alloc);
+    BOOST_REQUIRE_EQUAL(1, buf.use_count());
+    {
+        int i = 1;
+        eterm d(buf.data(), i, buf.size(), alloc);
+        BOOST_REQUIRE(d == t);
+        // Without a scope binaries are copied
+        BOOST_REQUIRE_EQUAL(1, buf.use_count());
+    }
+    {
+        eterm d;
+        {
+            binary_slice_scope scope(buf);
+            int i = 1;
+            d = eterm(buf.data(), i, buf.size(), alloc);
+        }
+        BOOST_REQUIRE(d == t);
+        const binary& b = d.to_tuple()[0].to_binary();
+        BOOST_REQUIRE(b.data() > buf.data() && b.data() + b.size() <= buf.data() + buf.size());
+        BOOST_REQUIRE_EQUAL(big, std::string(b.data(), b.size()));
+        // Only the large binary references the buffer
+        BOOST_REQUIRE_EQUAL(2, buf.use_count());
+        eterm d2(d);
+        BOOST_REQUIRE_EQUAL(2, buf.use_count());
+        buf = binary();
+        BOOST_REQUIRE(d2 == t);
+        BOOST_REQUIRE_EQUAL(std::string(b.data(), b.size()), big);
+    }
+    {
+        // A view decodes large binaries into slices of its storage
+        eterm_view v(s.c_str(), s.size(), alloc);
+        eterm d = v.to_eterm();
+        BOOST_REQUIRE(d == t);
+        const binary& b = d.to_tuple()[0].to_binary();
+        BOOST_REQUIRE(b.data() > v.data() && b.data() < v.data() + v.encoded_size());
+        binary b2 = v[0].to_binary();
+        BOOST_REQUIRE(b2 == b);
+        BOOST_REQUIRE_EQUAL(b.data(), b2.data());
+    }
+}
+
 BOOST_AUTO_TEST_CASE( test_list )
 {
     allocator_t alloc;
@@ -258,6 +946,339 @@ BOOST_AUTO_TEST_CASE( test_list4 )
     }
 }
 
+BOOST_AUTO_TEST_CASE( test_list_random_access )
+{
+    allocator_t alloc;
+    std::vector<eterm> items;
+    for (int i=0; i < 1000; i++)
+        items.push_back(eterm(i));
+    string s = eterm(list(items.data(), items.size(), alloc)).encode(0);
+    int idx = 1;
+    list l(s.c_str(), idx, s.size(), alloc);
+
+    // Decoded lists are contiguous
+    BOOST_REQUIRE(l.contiguous());
+    BOOST_REQUIRE_EQUAL(999, l.nth(999).to_long());
+    BOOST_REQUIRE_EQUAL(500, l[500].to_long());
+    BOOST_REQUIRE_THROW(l.nth(1000), err_bad_argument);
+
+    static_assert(std::is_same<std::iterator_traits<list::iterator>::iterator_category,
+                               std::forward_iterator_tag>::value,
+                  "list::iterator is a forward iterator");
+    list::contiguous_iterator b = l.contiguous_begin(), e = l.contiguous_end();
+    BOOST_REQUIRE_EQUAL(1000, e - b);
+    BOOST_REQUIRE_EQUAL(10,   (b + 10)->to_long());
+    BOOST_REQUIRE_EQUAL(999,  (e - 1)->to_long());
+    BOOST_REQUIRE(b + 1000 == e);
+    BOOST_REQUIRE(b < e && !(e < b));
+    BOOST_REQUIRE_EQUAL(7, b[7].to_long());
+    auto it = std::lower_bound(b, e, eterm(123),
+        [](const eterm& a, const eterm& v) { return a.to_long() < v.to_long(); });
+    BOOST_REQUIRE_EQUAL(123, it - b);
+    BOOST_REQUIRE_EQUAL(1000, std::distance(l.begin(), l.end()));
+
+    // A tail of a contiguous list is contiguous
+    list t = l.tail(99);
+    BOOST_REQUIRE_EQUAL(900, t.contiguous_end() - t.contiguous_begin());
+    BOOST_REQUIRE_EQUAL(100, t.contiguous_begin()->to_long());
+
+    list empty(0, alloc);
+    BOOST_REQUIRE(empty.contiguous_begin() == empty.contiguous_end());
+
+    // Cells appended past the list's initial size are linked
+    list l2(2, alloc);
+    for (int i=0; i < 5; i++)
+        l2.push_back(eterm(i));
+    l2.close();
+    BOOST_REQUIRE(!l2.contiguous());
+    BOOST_REQUIRE_EQUAL(4, l2[4].to_long());
+    BOOST_REQUIRE_EQUAL(5, std::distance(l2.begin(), l2.end()));
+    BOOST_REQUIRE_EQUAL(3, std::next(l2.begin(), 3)->to_long());
+    BOOST_REQUIRE_THROW(l2.contiguous_begin(), err_bad_argument);
+}
+
+BOOST_AUTO_TEST_CASE( test_list_tail )
+{
+    allocator_t alloc;
+    {
+        eterm t;
+        {
+            list l = {eterm(1), eterm(2), eterm(3), eterm(4)};
+            list t1 = l.tail(0);
+            BOOST_REQUIRE_EQUAL(3u, t1.length());
+            BOOST_REQUIRE(t1.contiguous());
+            BOOST_REQUIRE(t1 == list({eterm(2), eterm(3), eterm(4)}));
+            BOOST_REQUIRE_EQUAL(list({eterm(2), eterm(3), eterm(4)}).hash(), t1.hash());
+            BOOST_REQUIRE_EQUAL(4, t1[2].to_long());
+            list t2 = t1.tail(1);
+            BOOST_REQUIRE_EQUAL("[4]", eterm(t2).to_string());
+            BOOST_REQUIRE(t2.tail(0).empty());
+            BOOST_REQUIRE(t2.tail(0).initialized());
+            BOOST_REQUIRE_THROW(t2.tail(1), err_bad_argument);
+            // The tail outlives the list it references
+            t = eterm(t1);
+        }
+        eterm c(t);
+        BOOST_REQUIRE_EQUAL("[2,3,4]", c.to_string());
+        string s = t.encode(0);
+        BOOST_REQUIRE(s == eterm(list({eterm(2), eterm(3), eterm(4)})).encode(0));
+        eterm d(s.c_str(), s.size());
+        BOOST_REQUIRE(d == t);
+        BOOST_REQUIRE(t.match(eterm::format("[2, X, 4]")));
+    }
+    {
+        // Recursive head/tail traversal of a decoded list
+        std::vector<eterm> items;
+        for (int i=0; i < 1000; i++)
+            items.push_back(eterm(i));
+        string s = eterm(list(items.data(), items.size(), alloc)).encode(0);
+        int idx = 1;
+        list l(s.c_str(), idx, s.size(), alloc);
+        long sum = 0;
+        for (list p = l; !p.empty(); p = p.tail(0))
+            sum += p.nth(0).to_long();
+        BOOST_REQUIRE_EQUAL(999*1000/2, sum);
+    }
+    {
+        // Tail of a list with cells appended past its initial size
+        list l(1, alloc);
+        for (int i=0; i < 5; i++)
+            l.push_back(eterm(i));
+        l.close();
+        list t = l.tail(2);
+        BOOST_REQUIRE(!t.contiguous());
+        BOOST_REQUIRE_EQUAL("[3,4]", eterm(t).to_string());
+        BOOST_REQUIRE_EQUAL(2, std::distance(t.begin(), t.end()));
+    }
+    {
+        // An open list can still grow past the end of its tail
+        list l(alloc);
+        l.push_back(eterm(1));
+        l.push_back(eterm(2));
+        BOOST_CHECK_THROW(l.tail(0), err_bad_argument);
+        l.close();
+        BOOST_REQUIRE_EQUAL("[2]", eterm(l.tail(0)).to_string());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_list_grow )
+{
+    allocator_t alloc;
+    {
+        list l(alloc);
+        for (int i=0; i < 10000; i++)
+            l.push_back(eterm(i));
+        l.close();
+        BOOST_REQUIRE_EQUAL(10000u, l.length());
+        int i = 0;
+        for (auto it = l.begin(), e = l.end(); it != e; ++it, ++i)
+            BOOST_REQUIRE_EQUAL(i, it->to_long());
+        BOOST_REQUIRE_EQUAL(10000, i);
+        BOOST_REQUIRE_EQUAL(9999, l.nth(9999).to_long());
+    }
+    {
+        list l(alloc);
+        l.reserve(100);
+        for (int i=0; i < 100; i++)
+            l.push_back(eterm(i));
+        l.close();
+        BOOST_REQUIRE(l.contiguous());
+        BOOST_REQUIRE_EQUAL(99, l[99].to_long());
+        BOOST_REQUIRE_THROW(l.reserve(200), err_bad_argument);
+    }
+    {
+        // Reserve after some cells of the header's array were used
+        list l(4, alloc);
+        l.push_back(eterm(0));
+        l.push_back(eterm(1));
+        l.reserve(10);
+        for (int i=2; i < 12; i++)
+            l.push_back(eterm(i));
+        l.close();
+        BOOST_REQUIRE_EQUAL(12u, l.length());
+        BOOST_REQUIRE(!l.contiguous());
+        for (int i=0; i < 12; i++)
+            BOOST_REQUIRE_EQUAL(i, l[i].to_long());
+        eterm t(l);
+        BOOST_REQUIRE_EQUAL("[0,1,2,3,4,5,6,7,8,9,10,11]", t.to_string());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_packed_list )
+{
+    allocator_t alloc;
+    {
+        std::vector<eterm> items;
+        for (int i=0; i < 1000; i++)
+            items.push_back(eterm(i * 0.5 - 100));
+        string s = eterm(list(items.data(), items.size(), alloc)).encode(0);
+        int idx = 1;
+        packed_list<double> l(s.c_str(), idx, s.size(), alloc);
+        BOOST_REQUIRE_EQUAL(s.size(), (size_t)idx);
+        BOOST_REQUIRE_EQUAL(1000u, l.size());
+        BOOST_REQUIRE_EQUAL(-100.0, l[0]);
+        BOOST_REQUIRE_EQUAL(399.5,  l[999]);
+
+        // Encoded as a regular list
+        BOOST_REQUIRE_EQUAL(s.size() - 1, l.encode_size());
+        std::vector<char> buf(l.encode_size());
+        idx = 0;
+        l.encode(buf.data(), idx, buf.size());
+        BOOST_REQUIRE_EQUAL(buf.size(), (size_t)idx);
+        BOOST_REQUIRE(memcmp(buf.data(), s.c_str() + 1, buf.size()) == 0);
+
+        list t = l.to_list();
+        BOOST_REQUIRE(t.contiguous());
+        BOOST_REQUIRE(eterm(t) == eterm(list(items.data(), items.size(), alloc)));
+
+        eterm_view v(s.c_str(), s.size(), alloc);
+        BOOST_REQUIRE(v.to_packed_list<double>() == l);
+        BOOST_REQUIRE_THROW(v.to_packed_list<long>(), err_decode_exception);
+    }
+    {
+        // Integers of all encodings
+        const long values[] = {0, 255, 256, -1, 100000, -2147483648L, 2147483648L,
+                               -5000000000L, 0x7fffffffffffffffL, -0x7fffffffffffffffL};
+        const size_t n = sizeof(values)/sizeof(values[0]);
+        packed_list<long> l(values, n, alloc);
+        std::vector<char> buf(l.encode_size());
+        int idx = 0;
+        l.encode(buf.data(), idx, buf.size());
+        BOOST_REQUIRE_EQUAL(buf.size(), (size_t)idx);
+
+        idx = 0;
+        eterm t(buf.data(), idx, buf.size(), alloc);
+        BOOST_REQUIRE_EQUAL(LIST, t.type());
+        BOOST_REQUIRE(t == eterm(l.to_list()));
+        for (size_t i=0; i < n; i++)
+            BOOST_REQUIRE_EQUAL(values[i], t.to_list().nth(i).to_long());
+
+        idx = 0;
+        packed_list<long> d(buf.data(), idx, buf.size(), alloc);
+        BOOST_REQUIRE(d == l);
+        BOOST_REQUIRE_EQUAL("[0,255,256,-1,100000,-2147483648,2147483648,-5000000000,"
+                            "9223372036854775807,-9223372036854775807]", eterm(d.to_list()).to_string());
+
+        // Integers are accepted by packed lists of doubles
+        idx = 0;
+        packed_list<double> f(buf.data(), idx, buf.size(), alloc);
+        BOOST_REQUIRE_EQUAL(100000.0, f[4]);
+    }
+    {
+        // Lists of bytes are sent as strings
+        string s = eterm::format("[1,2,3]").encode(0);
+        int idx = 1;
+        packed_list<long> l(s.c_str(), idx, s.size(), alloc);
+        BOOST_REQUIRE(l == packed_list<long>({1, 2, 3}));
+        BOOST_REQUIRE(l.is_byte_list());
+        BOOST_REQUIRE_EQUAL(s.size() - 1, l.encode_size());
+        std::vector<char> buf(l.encode_size());
+        idx = 0;
+        l.encode(buf.data(), idx, buf.size());
+        BOOST_REQUIRE(memcmp(buf.data(), s.c_str() + 1, buf.size()) == 0);
+        BOOST_REQUIRE_EQUAL("[1,2,3]", eterm(l.to_list()).to_string());
+
+        s = eterm::format("[]").encode(0);
+        idx = 1;
+        packed_list<double> e(s.c_str(), idx, s.size(), alloc);
+        BOOST_REQUIRE(e.empty());
+        BOOST_REQUIRE(e.to_list().empty());
+        BOOST_REQUIRE_EQUAL(1u, e.encode_size());
+
+        s = eterm::format("[1,a]").encode(0);
+        idx = 1;
+        BOOST_REQUIRE_THROW(packed_list<long>(s.c_str(), idx, s.size(), alloc), err_decode_exception);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_list_of_bytes )
+{
+    allocator_t alloc;
+    {
+        // Lists of integers in 0..255 are encoded as strings
+        list l = {eterm(104), eterm(105), eterm(0), eterm(255)};
+        BOOST_REQUIRE(l.is_byte_list());
+        string s = eterm(l).encode(0);
+        const uint8_t expect[] = {131,107,0,4,104,105,0,255};
+        BOOST_REQUIRE(s.equal(expect));
+        BOOST_REQUIRE_EQUAL(s.size() - 1, l.encode_size());
+
+        eterm_view v(s.c_str(), s.size(), alloc);
+        BOOST_REQUIRE_EQUAL(STRING, v.type());
+        BOOST_REQUIRE_EQUAL(4u, v.size());
+        BOOST_REQUIRE_EQUAL(LONG, v[1].type());
+        BOOST_REQUIRE_EQUAL(105, v[1].to_long());
+        BOOST_REQUIRE_EQUAL(255, v[3].to_eterm().to_long());
+        long sum = 0;
+        for (auto& e : v)
+            sum += e.to_long();
+        BOOST_REQUIRE_EQUAL(104+105+255, sum);
+        BOOST_REQUIRE(v.to_list() == l);
+        BOOST_REQUIRE(v.to_packed_list<long>() == packed_list<long>({104, 105, 0, 255}));
+        BOOST_REQUIRE_THROW(v[4], err_bad_argument);
+
+        // A decoded string is equal to the list it was encoded from
+        eterm d(s.c_str(), s.size(), alloc);
+        BOOST_REQUIRE_EQUAL(STRING, d.type());
+        BOOST_REQUIRE(d == eterm(l) && eterm(l) == d);
+        BOOST_REQUIRE_EQUAL(0, d.compare(eterm(l)));
+        BOOST_REQUIRE_EQUAL(eterm(l).hash(), d.hash());
+        BOOST_REQUIRE_EQUAL(eterm(list::make()).hash(), eterm("").hash());
+        BOOST_REQUIRE(eterm("") == eterm(list::make()));
+        BOOST_REQUIRE(d != eterm(list({eterm(104), eterm(105), eterm(0)})));
+        BOOST_REQUIRE(d != eterm(list({eterm(104), eterm(105), eterm(0), eterm(255.0)})));
+        BOOST_REQUIRE_THROW(d.to_list(), err_wrong_type);
+        varbind binding;
+        BOOST_REQUIRE(d.match(eterm::format("[104, X, 0, 255]"), &binding));
+        BOOST_REQUIRE_EQUAL(105, binding.find("X")->to_long());
+        BOOST_REQUIRE(d.match(eterm::format("L::list()")));
+        BOOST_REQUIRE(eterm(l).match(d));
+        BOOST_REQUIRE(!d.match(eterm::format("[104]")));
+
+        // The string is viewed as a list without copying it
+        list_view lv = d.to_list_view();
+        BOOST_REQUIRE(lv.is_str());
+        BOOST_REQUIRE_EQUAL(4u, lv.length());
+        BOOST_REQUIRE_EQUAL(255, lv[3].to_long());
+        BOOST_REQUIRE_THROW(lv[4], err_bad_argument);
+        BOOST_REQUIRE(std::equal(lv.begin(), lv.end(), l.begin()));
+        BOOST_REQUIRE_EQUAL(STRING, d.type());
+        eterm ls(std::string(100, 'a'));
+        list_view lsv = ls.to_list_view();
+        BOOST_REQUIRE_EQUAL(2, ls.to_str().use_count());
+        BOOST_REQUIRE_EQUAL(100, std::count(lsv.begin(), lsv.end(), eterm('a')));
+        list_view ll = eterm(l).to_list_view();
+        BOOST_REQUIRE(!ll.is_str());
+        BOOST_REQUIRE(std::equal(ll.begin(), ll.end(), lv.begin()));
+        BOOST_REQUIRE_EQUAL(105, ll.nth(1).to_long());
+        BOOST_REQUIRE(eterm("").to_list_view().empty());
+        BOOST_REQUIRE_THROW(eterm(1).to_list_view(), err_wrong_type);
+    }
+    {
+        // Other lists, including a list of bytes that isn't contiguous
+        BOOST_REQUIRE(!list({eterm(1), eterm(256)}).is_byte_list());
+        BOOST_REQUIRE(!list({eterm(1), eterm(-1)}).is_byte_list());
+        BOOST_REQUIRE(!list({eterm(1), eterm(true)}).is_byte_list());
+        BOOST_REQUIRE(!list({eterm(1), eterm(2.0)}).is_byte_list());
+        BOOST_REQUIRE(!list::make().is_byte_list());
+
+        std::vector<eterm> items(100, eterm(7));
+        items[99] = eterm(1000);
+        BOOST_REQUIRE(!list(items.data(), items.size(), alloc).is_byte_list());
+
+        list l(1, alloc);
+        for (int i=0; i < 40; i++)
+            l.push_back(eterm(i));
+        l.close();
+        BOOST_REQUIRE(!l.contiguous());
+        BOOST_REQUIRE(l.is_byte_list());
+        string s = eterm(l).encode(0);
+        BOOST_REQUIRE_EQUAL(107, (uint8_t)s.c_str()[1]);
+        BOOST_REQUIRE_EQUAL(3u + 40, l.encode_size());
+        BOOST_REQUIRE(eterm_view(s.c_str(), s.size(), alloc).to_list() == l);
+    }
+}
+
 BOOST_AUTO_TEST_CASE( test_double )
 {
     allocator_t alloc;
@@ -357,6 +1378,41 @@ BOOST_AUTO_TEST_CASE( test_string )
     }
 }
 
+BOOST_AUTO_TEST_CASE( test_short_string_binary )
+{
+    allocator_t alloc;
+    const char data[] = "abcdefghijklmnop";
+
+    // Sizes around the inline storage capacity must behave identically
+    for (size_t n = 0; n < sizeof(data); n++) {
+        std::string expect(data, n);
+
+        string s(data, n, alloc);
+        BOOST_REQUIRE_EQUAL(n, s.size());
+        BOOST_REQUIRE_EQUAL(expect, s.to_str());
+        BOOST_REQUIRE_EQUAL('\0', s.c_str()[n]);
+
+        binary b(data, n, alloc);
+        BOOST_REQUIRE_EQUAL(n, b.size());
+        BOOST_REQUIRE(memcmp(data, b.data(), n) == 0);
+
+        eterm es(s), eb(b);
+        eterm es2(es), eb2 = eb;
+        BOOST_REQUIRE(es == es2);
+        BOOST_REQUIRE(eb == eb2);
+        BOOST_REQUIRE(es2.to_str() == string(expect, alloc));
+        BOOST_REQUIRE(eb2.to_binary() == binary(expect, alloc));
+
+        string bufs = es.encode(0), bufb = eb.encode(0);
+        BOOST_REQUIRE_EQUAL(es.encode_size(0), bufs.size());
+        BOOST_REQUIRE_EQUAL(eb.encode_size(0), bufb.size());
+        eterm ds(bufs.c_str(), bufs.size(), alloc);
+        eterm db(bufb.c_str(), bufb.size(), alloc);
+        BOOST_REQUIRE(ds == es || (n == 0 && ds.type() == LIST));
+        BOOST_REQUIRE(db == eb);
+    }
+}
+
 BOOST_AUTO_TEST_CASE( test_pid )
 {
     allocator_t alloc;
@@ -617,6 +1673,244 @@ BOOST_AUTO_TEST_CASE( test_trace )
     }
 }
 
+BOOST_AUTO_TEST_CASE( test_map )
+{
+    allocator_t alloc;
+    {
+        map m1{{atom("b"), 2}, {eterm(1), "one"}, {eterm(1.0), "float"},
+               {eterm({atom("x")}), 3}, {atom("a"), 1}};
+        eterm et1(m1);
+        BOOST_REQUIRE(et1.initialized());
+        BOOST_REQUIRE_EQUAL(MAP, et1.type());
+        BOOST_REQUIRE_EQUAL(5ul, m1.size());
+        // Keys are kept in the Erlang term order, with 1 and 1.0 being distinct
+        BOOST_REQUIRE_EQUAL("#{1 => \"one\",1.0 => \"float\",a => 1,b => 2,{x} => 3}",
+                            et1.to_string());
+        BOOST_REQUIRE_EQUAL(2,       m1[atom("b")].to_long());
+        BOOST_REQUIRE_EQUAL("one",   m1[eterm(1)].to_str());
+        BOOST_REQUIRE_EQUAL("float", m1[eterm(1.0)].to_str());
+        BOOST_REQUIRE_EQUAL(3,       m1[eterm({atom("x")})].to_long());
+        BOOST_REQUIRE(m1.has(atom("a")));
+        BOOST_REQUIRE(!m1.has(atom("c")));
+        BOOST_REQUIRE(m1.find(eterm(2)) == NULL);
+        BOOST_REQUIRE_THROW(m1[atom("c")], err_bad_argument);
+
+        map m2{{atom("a"), 1}, {atom("b"), 0}, {atom("b"), 2}, {eterm({atom("x")}), 3},
+               {eterm(1.0), "float"}, {eterm(1), "one"}};
+        BOOST_REQUIRE(et1 == eterm(m2));
+        BOOST_REQUIRE(et1 != eterm(map{{atom("a"), 1}}));
+        BOOST_REQUIRE(eterm(map{{atom("a"), 1}}) < et1);
+
+        // Integer keys precede float keys regardless of their values
+        map m3{{eterm(1.5), 1}, {eterm(2), 2}, {eterm({1.0}), 3}, {eterm({3}), 4}};
+        BOOST_REQUIRE_EQUAL("#{2 => 2,1.5 => 1,{3} => 4,{1.0} => 3}", eterm(m3).to_string());
+        BOOST_REQUIRE_EQUAL(2, m3[eterm(2)].to_long());
+        BOOST_REQUIRE_EQUAL(3, m3[eterm({1.0})].to_long());
+        BOOST_REQUIRE(eterm(1.5) < eterm(2));
+        BOOST_REQUIRE(eterm(2).compare(eterm(1.5), true) < 0);
+    }
+    {
+        // number < atom < tuple < map < list < binary
+        eterm terms[] = {
+            eterm(binary("a", 1, alloc)), eterm(list({1, 2})), eterm(map{}),
+            eterm({atom("a")}), eterm(atom("a")), eterm(2.5), eterm(2) };
+        for (size_t i=1; i < sizeof(terms)/sizeof(terms[0]); i++) {
+            BOOST_REQUIRE(terms[i] < terms[i-1]);
+            BOOST_REQUIRE(terms[i-1].compare(terms[i]) > 0);
+        }
+        BOOST_REQUIRE_EQUAL(0, eterm("ab").compare(eterm(list({'a', 'b'}))));
+        BOOST_REQUIRE(eterm("ab") < eterm("abc"));
+        BOOST_REQUIRE(eterm(list(nullptr)) < eterm("a"));
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_hash )
+{
+    allocator_t alloc;
+    {
+        // Equal terms built separately have equal hashes
+        eterm t1 = eterm::format("{tab, [1, 2.5, \"abcdefghij\"], <<\"xyz1234567\">>}");
+        eterm t2 = eterm::format("{tab, [1, 2.5, \"abcdefghij\"], <<\"xyz1234567\">>}");
+        BOOST_REQUIRE(t1 == t2);
+        BOOST_REQUIRE_EQUAL(t1.hash(), t2.hash());
+        BOOST_REQUIRE_EQUAL(t1.hash(), t1.hash());      // cached
+        BOOST_REQUIRE_EQUAL(t1.hash(), eterm(t1).hash());
+
+        BOOST_REQUIRE_EQUAL(eterm(0.0).hash(), eterm(-0.0).hash());
+        BOOST_REQUIRE_EQUAL(eterm("").hash(), eterm(string()).hash());
+        BOOST_REQUIRE_EQUAL(eterm(list(nullptr)).hash(), eterm(list(0, alloc)).hash());
+        BOOST_REQUIRE_EQUAL(eterm(map{{atom("a"), 1}, {atom("b"), 2}}).hash(),
+                            eterm(map{{atom("b"), 2}, {atom("a"), 1}}).hash());
+
+        BOOST_REQUIRE(eterm(1).hash()        != eterm(1.0).hash());
+        BOOST_REQUIRE(eterm(atom("a")).hash() != eterm(atom("b")).hash());
+        BOOST_REQUIRE(eterm({1, 2}).hash()   != eterm({2, 1}).hash());
+    }
+    {
+        // Modifying a tuple drops its cached hash
+        tuple t = tuple::make(1, 2, alloc);
+        uint32_t h = t.hash();
+        t[1] = eterm(3);
+        BOOST_REQUIRE(h != t.hash());
+        BOOST_REQUIRE_EQUAL(t.hash(), tuple::make(1, 3, alloc).hash());
+    }
+    {
+        // Modifying a tuple nested in other terms keeps them consistent
+        tuple inner = tuple::make(1, 2, alloc);
+        eterm l1(list({eterm(inner)}, alloc));
+        eterm l2(list({eterm(tuple::make(5, 2, alloc))}, alloc));
+        eterm t1(tuple::make(inner, 0, alloc));
+        eterm t2(tuple::make(tuple::make(5, 2, alloc), 0, alloc));
+        eterm m1(map{{atom("k"), eterm(inner)}});
+        eterm m2(map{{atom("k"), eterm(tuple::make(5, 2, alloc))}});
+        BOOST_REQUIRE(l1 != l2 && t1 != t2 && m1 != m2);
+        l1.hash(); l2.hash(); t1.hash(); t2.hash(); m1.hash(); m2.hash();
+        inner[0] = eterm(5);
+        BOOST_REQUIRE_EQUAL("[{5,2}]", l1.to_string());
+        BOOST_REQUIRE(l1 == l2);
+        BOOST_REQUIRE_EQUAL(l1.hash(), l2.hash());
+        BOOST_REQUIRE(t1 == t2);
+        BOOST_REQUIRE_EQUAL(t1.hash(), t2.hash());
+        BOOST_REQUIRE(m1 == m2);
+        BOOST_REQUIRE_EQUAL(m1.hash(), m2.hash());
+    }
+    {
+        // Modifying a list through its parent keeps the tail consistent
+        list l = {eterm(1), eterm(2), eterm(3)};
+        list t = l.tail(0);
+        uint32_t h = t.hash();
+        *l.begin() = eterm(0);
+        *++l.begin() = eterm(7);
+        BOOST_REQUIRE(h != t.hash());
+        BOOST_REQUIRE_EQUAL(list({eterm(7), eterm(3)}).hash(), t.hash());
+    }
+    {
+        std::unordered_map<eterm, int> m;
+        for (int i=0; i < 100; i++)
+            m[eterm({atom("tab"), i})] = i;
+        BOOST_REQUIRE_EQUAL(100u, m.size());
+        for (int i=0; i < 100; i++)
+            BOOST_REQUIRE_EQUAL(i, m[eterm({atom("tab"), i})]);
+        BOOST_REQUIRE(m.find(eterm({atom("tab"), 100})) == m.end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_eterm_view )
+{
+    allocator_t alloc;
+    eterm t = eterm::format(
+        "{call, 12345678901, [1.5, abc, \"abc\", <<\"xyz\">>], #{a => 1}, {}, []}");
+    string s = t.encode(0);
+    eterm_view v(s.c_str(), s.size(), alloc);
+
+    BOOST_REQUIRE(v.is_tuple());
+    BOOST_REQUIRE_EQUAL(6u, v.size());
+    BOOST_REQUIRE_EQUAL(s.size() - 1, v.encoded_size());
+    BOOST_REQUIRE_EQUAL(atom("call"), v[0].to_atom());
+    BOOST_REQUIRE_EQUAL(12345678901, v[1].to_long());
+    BOOST_REQUIRE(v[3].is_map());
+    BOOST_REQUIRE_EQUAL(1u, v[3].size());
+    BOOST_REQUIRE_EQUAL(0u, v[4].size());
+    BOOST_REQUIRE(v[5].is_list());
+    BOOST_REQUIRE_EQUAL(0u, v[5].size());
+    BOOST_REQUIRE(v.to_eterm() == t);
+    BOOST_REQUIRE(v[3].to_eterm() == t.to_tuple()[3]);
+    BOOST_REQUIRE_EQUAL(t.to_string(), v.to_string());
+
+    eterm_view l = v[2];
+    BOOST_REQUIRE(l.is_list());
+    BOOST_REQUIRE_EQUAL(4u, l.size());
+    BOOST_REQUIRE_EQUAL(1.5, l[0].to_double());
+    BOOST_REQUIRE_EQUAL(atom("abc"), l[1].to_atom());
+    BOOST_REQUIRE_EQUAL(string("abc"), l[2].to_str());
+    BOOST_REQUIRE(binary({'x','y','z'}) == l[3].to_binary());
+
+    int n = 0;
+    for (eterm_view::const_iterator it = l.begin(); it != l.end(); ++it, ++n)
+        BOOST_REQUIRE(it->to_eterm() == t.to_tuple()[2].to_list().nth(n));
+    BOOST_REQUIRE_EQUAL(4, n);
+
+    BOOST_CHECK_THROW(l[4],             err_bad_argument);
+    BOOST_CHECK_THROW(v[0].to_long(),   err_wrong_type);
+    BOOST_CHECK_THROW(v[1][0],          err_wrong_type);
+
+    // The view keeps the encoded bytes alive
+    eterm_view e(eterm(atom("ok")), alloc);
+    BOOST_REQUIRE_EQUAL(atom("ok"), e.to_atom());
+    BOOST_REQUIRE(eterm_view(eterm(true), alloc).to_bool());
+    BOOST_REQUIRE(eterm_view().empty());
+
+    // The transport message decodes the payload on demand
+    connect::transport_msg<allocator_t> tm;
+    tm.set(ERL_SEND, tuple::make(ERL_SEND, atom(), atom("a"), alloc), v);
+    BOOST_REQUIRE(tm.has_msg());
+    BOOST_REQUIRE(tm.msg_view().is_tuple());
+    BOOST_REQUIRE(tm.msg() == t);
+    tm.set(ERL_SEND, tuple::make(ERL_SEND, atom(), atom("a"), alloc));
+    BOOST_REQUIRE(!tm.has_msg());
+
+    // Concurrent readers of the payload decode it once
+    tm.set(ERL_SEND, tuple::make(ERL_SEND, atom(), atom("a"), alloc), v);
+    {
+        const connect::transport_msg<allocator_t>& ctm = tm;
+        std::vector<const eterm*> msgs(4);
+        std::vector<std::thread>  threads;
+        for (size_t i=0; i < msgs.size(); i++)
+            threads.emplace_back([&ctm, &msgs, i] { msgs[i] = &ctm.msg(); });
+        for (auto& th : threads)
+            th.join();
+        for (auto m : msgs) {
+            BOOST_REQUIRE_EQUAL(&tm.msg(), m);
+            BOOST_REQUIRE(*m == t);
+        }
+        connect::transport_msg<allocator_t> tm2(ctm);
+        BOOST_REQUIRE(tm2.msg() == t);
+    }
+
+    // The atoms of the payload are looked up in the connection's cache
+    {
+        auto cache = std::make_shared<marshal::atom_decode_cache>();
+        tm.set(ERL_SEND, tuple::make(ERL_SEND, atom(), atom("a"), alloc), v, cache);
+        BOOST_REQUIRE(tm.msg() == t);
+        BOOST_REQUIRE_EQUAL(0u, cache->hits());
+        BOOST_REQUIRE_EQUAL(3u, cache->misses());
+        tm.set(ERL_SEND, tuple::make(ERL_SEND, atom(), atom("a"), alloc), v, cache);
+        connect::transport_msg<allocator_t> tm2(tm);
+        BOOST_REQUIRE(tm2.msg() == t);
+        BOOST_REQUIRE_EQUAL(3u, cache->hits());
+        // The payload is decoded without the cache while it's in use
+        std::unique_lock<marshal::atom_decode_cache> lock(*cache);
+        BOOST_REQUIRE(tm.msg() == t);
+        BOOST_REQUIRE_EQUAL(3u, cache->hits());
+        BOOST_REQUIRE_EQUAL(3u, cache->misses());
+    }
+
+    // The type of a view is known without adding its atom to the atom table
+    {
+        size_t n = atom::atom_table().allocated();
+        const char raw[] = "\x83\x64\x00\x0b" "view_atom_1";
+        eterm_view a(raw, sizeof(raw)-1, alloc);
+        BOOST_REQUIRE(a.is_atom());
+        BOOST_REQUIRE_EQUAL(n, atom::atom_table().allocated());
+        const char raw2[] = "\x83\x77\x04" "true";
+        BOOST_REQUIRE(eterm_view(raw2, sizeof(raw2)-1, alloc).is_bool());
+        BOOST_CHECK_THROW(eterm_view("\x83\x64\x00\x0b" "view", 7, alloc),
+                          err_decode_exception);
+    }
+
+    // Within a binary_slice_scope the view references the buffer
+    {
+        binary buf(s.c_str(), s.size(), alloc);
+        eterm_view v2;
+        {
+            binary_slice_scope scope(buf);
+            v2 = eterm_view(buf.data(), buf.size(), alloc);
+        }
+        BOOST_REQUIRE_EQUAL(2, buf.use_count());
+        BOOST_REQUIRE(v2.to_eterm() == t);
+    }
+}
+
 BOOST_AUTO_TEST_CASE( test_varbind )
 {
     allocator_t alloc;
@@ -262,6 +262,34 @@ BOOST_AUTO_TEST_CASE( test_encode_trace )
     BOOST_REQUIRE_EQUAL("{1,2,3,#Pid<abc@fc12.96.0.3>,4}", eterm(t1).to_string());
 }
 
+BOOST_AUTO_TEST_CASE( test_encode_map )
+{
+    map m{{atom("b"), eterm("xy")}, {atom("a"), eterm(1)}};
+    eterm t(m);
+    string s(t.encode(0));
+    const uint8_t expect[] = {131,116,0,0,0,2,100,0,1,97,97,1,100,0,1,98,
+                              107,0,2,120,121};
+    BOOST_REQUIRE(s.equal(expect));
+    BOOST_REQUIRE_EQUAL(sizeof(expect), t.encode_size(0));
+
+    // Keys sent out of order are sorted on decoding
+    const uint8_t unsorted[] = {131,116,0,0,0,2,100,0,1,98,107,0,2,120,121,
+                                100,0,1,97,97,1};
+    eterm t1((const char*)unsorted, sizeof(unsorted));
+    BOOST_REQUIRE_EQUAL(MAP, t1.type());
+    BOOST_REQUIRE_EQUAL(2ul, t1.to_map().size());
+    BOOST_REQUIRE(t1 == t);
+    BOOST_REQUIRE_EQUAL("#{a => 1,b => \"xy\"}", t1.to_string());
+    BOOST_REQUIRE_EQUAL(1, t1.to_map()[atom("a")].to_long());
+
+    const uint8_t empty[] = {131,116,0,0,0,0};
+    eterm t2((const char*)empty, sizeof(empty));
+    BOOST_REQUIRE_EQUAL(MAP, t2.type());
+    BOOST_REQUIRE(t2.to_map().empty());
+    BOOST_REQUIRE_EQUAL("#{}", t2.to_string());
+    BOOST_REQUIRE(t2.encode(0).equal(empty));
+}
+
 BOOST_AUTO_TEST_CASE( test_encode_rpc )
 {
     static const unsigned char s_expected[] = {
@@ -119,6 +119,18 @@ BOOST_AUTO_TEST_CASE( test_eterm_format_list )
     BOOST_REQUIRE_EQUAL("[1,2.1,abc]", et.to_string());
 }
 
+BOOST_AUTO_TEST_CASE( test_eterm_format_map )
+{
+    eterm et( eterm::format("#{b => ~i, \"s\" => [1], a => x, a => ~a}", 1, "y") );
+
+    BOOST_REQUIRE_EQUAL(MAP, et.type());
+    BOOST_REQUIRE_EQUAL("#{a => y,b => 1,\"s\" => [1]}", et.to_string());
+    BOOST_REQUIRE_EQUAL("#{}", eterm::format("#{ }").to_string());
+    BOOST_REQUIRE_EQUAL("#{a => #{1 => 2}}", eterm::format("#{a := #{1 := 2}}").to_string());
+    BOOST_REQUIRE_THROW(eterm::format("#{a => 1"), err_format_exception);
+    BOOST_REQUIRE_THROW(eterm::format("#{a, 1}"),  err_format_exception);
+}
+
 BOOST_AUTO_TEST_CASE( test_eterm_format_const )
 {
     allocator_t alloc;
@@ -410,6 +410,28 @@ BOOST_AUTO_TEST_CASE( test_match_list )
     BOOST_REQUIRE(b);
 }
 
+BOOST_AUTO_TEST_CASE( test_match_map )
+{
+    const eterm data = eterm::format("{quote, #{px => 1.5, qty => 100, sym => 'IBM'}}");
+
+    varbind binding;
+    BOOST_REQUIRE(data.match(eterm::format("{quote, #{qty := Q, sym := S}}"), &binding));
+    BOOST_REQUIRE_EQUAL(100, binding[atom("Q")]->to_long());
+    BOOST_REQUIRE_EQUAL(atom("IBM"), binding[atom("S")]->to_atom());
+
+    BOOST_REQUIRE(data.match(eterm::format("{quote, #{}}")));
+    BOOST_REQUIRE(data.match(eterm::format("{quote, M::map()}")));
+    BOOST_REQUIRE(!data.match(eterm::format("{quote, #{bid := _}}")));
+    BOOST_REQUIRE(!data.match(eterm::format("{quote, #{qty := 5}}")));
+
+    eterm p = eterm::format("#{k => V, V => k}");
+    varbind vars;
+    vars.bind(atom("V"), eterm(1));
+    eterm out;
+    BOOST_REQUIRE(p.subst(out, &vars));
+    BOOST_REQUIRE_EQUAL("#{1 => k,k => 1}", out.to_string());
+}
+
 BOOST_AUTO_TEST_CASE( test_match_list_tail )
 {
     BOOST_WARN_MESSAGE(false, "SKIPPING test_match_list_tail - needs extension to list matching!");
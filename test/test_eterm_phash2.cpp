@@ -0,0 +1,177 @@
+/*
+***** BEGIN LICENSE BLOCK *****
+
+Copyright 2010 Serge Aleynikov <saleyn at gmail dot com>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+***** END LICENSE BLOCK *****
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "test_alloc.hpp"
+#include <eixx/eixx.hpp>
+
+using namespace eixx;
+
+// Values of phash2/1 for terms that eterm::format() can build.
+//
+// NOTE: apart from s_beam_vectors below, these values were computed by
+// eixx::marshal::phash2, a transcription of make_hash2() in
+// erts/emulator/beam/utils.c, as no emulator was at hand. Regenerate the
+// table in the erl shell with:
+//   [io:format("~p ~p~n", [T, erlang:phash2(T)]) || T <- Terms].
+// For the wire vectors below use erlang:phash2(binary_to_term(Bin)).
+static const struct { const char* term; uint32_t hash; } s_format_vectors[] = {
+    { "a",                          97u         },
+    { "ok",                         1883u       },
+    { "true",                       506293u     },
+    { "'hello world'",              18131988u   },
+    { "0",                          88723725u   },
+    { "1",                          2614250u    },
+    { "-1",                         44071773u   },
+    { "255",                        44734653u   },
+    { "256",                        37021655u   },
+    { "134217727",                  112602999u  },
+    { "134217728",                  12354923u   },
+    { "-134217728",                 69672967u   },
+    { "-134217729",                 76739502u   },
+    { "1099511627776",              13893919u   },
+    { "-1099511627776",             48180921u   },
+    { "1152921504606846976",        31803508u   },
+    { "9223372036854775807",        28179613u   },
+    { "1.5",                        10380315u   },
+    { "-2.25",                      106798634u  },
+    { "0.0",                        20875736u   },
+    { "\"\"",                       113427502u  },
+    { "\"abc\"",                    117343302u  },
+    { "\"abcd\"",                   7922743u    },
+    { "\"abcdefghi\"",              77449587u   },
+    { "[]",                         113427502u  },
+    { "[1,2,3]",                    25788620u   },
+    { "[1,300,2]",                  82184728u   },
+    { "[[1],2]",                    21684294u   },
+    { "[a,b]",                      9075654u    },
+    { "[1,\"ab\",2]",               93524953u   },
+    { "{}",                         87486268u   },
+    { "{a}",                        35332806u   },
+    { "{a,1}",                      72425156u   },
+    { "{tab,{key,42}}",             49455560u   },
+    { "{1,[2,{3}]}",                70902327u   },
+    { "#{}",                        39679005u   },
+    { "#{a => 1}",                  59617982u   },
+    { "#{a => 1, b => [x]}",        20048764u   },
+    { "#{1 => 2, {k} => \"v\"}",    104796965u  },
+    { "<<>>",                       13708901u   },
+    { "<<1,2,3>>",                  6479071u    },
+    { "<<\"hello world, binary\">>", 55833654u  },
+};
+
+// Values of phash2/1 for terms given in the external format, covering
+// encodings that eixx doesn't produce itself (see the note above).
+static const struct {
+    const char* term; const char* buf; size_t size; uint32_t hash;
+} s_wire_vectors[] = {
+    { "<<1,2,3:4>>", "\x4d\x00\x00\x00\x03\x04\x01\x02\x30", 9, 11286013u },
+    { "'\\x{e9}' as ATOM_UTF8_EXT", "\x76\x00\x02\xc3\xa9", 5, 233u },
+    { "'\\x{e9}' as ATOM_EXT", "\x64\x00\x01\xe9", 4, 233u },
+    { "'\\x{3bb}' as SMALL_ATOM_UTF8_EXT", "\x77\x02\xce\xbb", 4, 3483u },
+    { "[1,2|3]", "\x6c\x00\x00\x00\x02\x61\x01\x61\x02\x61\x03", 11, 8851781u },
+    { "[1|\"ab\"]", "\x6c\x00\x00\x00\x01\x61\x01\x6b\x00\x02\x61\x62", 12, 13139385u },
+    { "[65] as INTEGER_EXT", "\x6c\x00\x00\x00\x01\x62\x00\x00\x00\x41\x6a", 11, 12572761u },
+    { "1 bsl 100", "\x6e\x0d\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x10", 16,
+      126219984u },
+    { "-(1 bsl 64 + 5)", "\x6e\x09\x01\x05\x00\x00\x00\x00\x00\x00\x00\x01", 12, 113907302u },
+    { "1.5 as FLOAT_EXT",
+      "\x63\x31\x2e\x35\x30\x30\x30\x30\x30\x30\x30\x30\x30\x30\x30\x30\x30\x30\x30\x30"
+      "\x30\x30\x30\x65\x2b\x30\x30\x00\x00\x00\x00\x00", 32, 10380315u },
+    { "<0.83.0> as NEW_PID_EXT",
+      "\x58\x77\x0d\x6e\x6f\x6e\x6f\x64\x65\x40\x6e\x6f\x68\x6f\x73\x74\x00\x00\x00\x53"
+      "\x00\x00\x00\x00\x00\x00\x00\x00", 28, 56813908u },
+    { "<0.83.0> as PID_EXT",
+      "\x67\x77\x0d\x6e\x6f\x6e\x6f\x64\x65\x40\x6e\x6f\x68\x6f\x73\x74\x00\x00\x00\x53"
+      "\x00\x00\x00\x00\x00", 25, 56813908u },
+    { "#Port<0.5>",
+      "\x59\x77\x0d\x6e\x6f\x6e\x6f\x64\x65\x40\x6e\x6f\x68\x6f\x73\x74\x00\x00\x00\x05"
+      "\x00\x00\x00\x00", 24, 125905316u },
+    { "#Port<0.5> as V4_PORT_EXT",
+      "\x78\x77\x0d\x6e\x6f\x6e\x6f\x64\x65\x40\x6e\x6f\x68\x6f\x73\x74\x00\x00\x00\x00"
+      "\x00\x00\x00\x05\x00\x00\x00\x00", 28, 125905316u },
+    { "#Port<0.4294967301> as V4_PORT_EXT",
+      "\x78\x77\x0d\x6e\x6f\x6e\x6f\x64\x65\x40\x6e\x6f\x68\x6f\x73\x74\x00\x00\x00\x01"
+      "\x00\x00\x00\x05\x00\x00\x00\x00", 28, 83004627u },
+    { "#Ref<0.7.3.154>",
+      "\x5a\x00\x03\x77\x0d\x6e\x6f\x6e\x6f\x64\x65\x40\x6e\x6f\x68\x6f\x73\x74\x00\x00"
+      "\x00\x00\x00\x00\x00\x9a\x00\x00\x00\x03\x00\x00\x00\x07", 34, 50162683u },
+};
+
+// Values of erlang:phash2(Term, 1 bsl 32) computed by an emulator, taken
+// from phash2_test/0 in erts/emulator/test/hash_SUITE.erl.
+static const struct { const char* term; uint32_t hash; } s_beam_vectors[] = {
+    { "0",                          3175731469u },
+};
+
+BOOST_AUTO_TEST_CASE( test_phash2_vectors )
+{
+    allocator_t alloc;
+    for (auto& v : s_beam_vectors) {
+        eterm t = eterm::format(alloc, v.term);
+        BOOST_CHECK_MESSAGE(t.phash2(1ull << 32) == v.hash,
+            "phash2(" << v.term << ", 1 bsl 32) = " << t.phash2(1ull << 32)
+            << ", expected " << v.hash);
+    }
+    for (auto& v : s_format_vectors) {
+        eterm t = eterm::format(alloc, v.term);
+        BOOST_CHECK_MESSAGE(t.phash2() == v.hash,
+            "phash2(" << v.term << ") = " << t.phash2() << ", expected " << v.hash);
+        // Same through the encoded form
+        string s = t.encode(0);
+        BOOST_REQUIRE_EQUAL(v.hash, eterm::phash2(s.c_str(), s.size()));
+    }
+    for (auto& v : s_wire_vectors)
+        BOOST_CHECK_MESSAGE(eterm::phash2(v.buf, v.size) == v.hash,
+            "phash2(" << v.term << ") = " << eterm::phash2(v.buf, v.size)
+            << ", expected " << v.hash);
+}
+
+BOOST_AUTO_TEST_CASE( test_phash2 )
+{
+    allocator_t alloc;
+    eterm t = eterm::format(alloc, "{tab,{key,42}}");
+    BOOST_REQUIRE_EQUAL(0u,          t.phash2(1));
+    BOOST_REQUIRE_EQUAL(8u,          t.phash2(16));
+    BOOST_REQUIRE_EQUAL(24u,         t.phash2(1000));
+    BOOST_REQUIRE_EQUAL(1794286024u, t.phash2(1ull << 32));
+    BOOST_REQUIRE_THROW(t.phash2(0),               err_bad_argument);
+    BOOST_REQUIRE_THROW(t.phash2((1ull << 32)+1),  err_bad_argument);
+
+    BOOST_REQUIRE_EQUAL(eterm(0.0).phash2(), eterm(-0.0).phash2());
+
+    // Key order doesn't matter, and big maps hash the same way as small ones
+    std::vector<eterm> kv;
+    for (int i=0; i < 40; i++) {
+        kv.push_back(atom("k" + std::to_string(i)));
+        kv.push_back(i);
+    }
+    BOOST_REQUIRE_EQUAL(77299368u, eterm(map(kv.data(), 40, alloc)).phash2());
+
+    // Large terms don't fit the stack buffer
+    list l(1000, alloc);
+    for (int i=0; i < 1000; i++)
+        l.push_back(eterm(i));
+    l.close();
+    string s = eterm(l).encode(0);
+    BOOST_REQUIRE_EQUAL(eterm::phash2(s.c_str(), s.size()), eterm(l).phash2());
+
+    BOOST_REQUIRE_THROW(eterm::phash2("\x83\x68\x02\x61", 4), err_decode_exception);
+}
@@ -21,6 +21,7 @@ limitations under the License.
 #include "test_alloc.hpp"
 #include <eixx/marshal/eterm.hpp>
 #include <eixx/marshal/list.hpp>
+#include <type_traits>
 
 using namespace eixx;
 using eixx::marshal::eterm;
@@ -68,16 +69,17 @@ BOOST_AUTO_TEST_CASE( test_refc_format )
     my_alloc alloc;
 
     list<my_alloc> lst(nullptr);  // Allocates static global empty list
-    BOOST_CHECK_EQUAL(2, g_alloc_count);
+    BOOST_CHECK_EQUAL(1, g_alloc_count);
 
     {
         for (int i=0; i < 10; i++) {
-            BOOST_CHECK_EQUAL(2, g_alloc_count);
+            BOOST_CHECK_EQUAL(1, g_alloc_count);
             eterm<my_alloc> term = eterm<my_alloc>::format(alloc,
                 "[~i, [{~s, ~i}, {~a, ~i}], {~f, ~i}, ~a]", 
                   1,   "ab", 2,  "xx", 3,   2.1, 10, "abc");
             BOOST_CHECK_EQUAL(LIST, term.type());
-            BOOST_CHECK_EQUAL(2+(6*2), g_alloc_count);
+            // The short "ab" string is stored inline
+            BOOST_CHECK_EQUAL(1+5, g_alloc_count);
 
             for (int j=0; j <= 10; j++)
                 eterm<my_alloc> term = eterm<my_alloc>::format(alloc, 
@@ -85,7 +87,7 @@ BOOST_AUTO_TEST_CASE( test_refc_format )
                       1,   "ab", 2,  "xx", 3,   2.1, 10, "abc");
         }
     }
-    BOOST_CHECK_EQUAL(2, g_alloc_count);
+    BOOST_CHECK_EQUAL(1, g_alloc_count);
 }
 
 BOOST_AUTO_TEST_CASE( test_refc_pool_format )
@@ -115,22 +117,114 @@ BOOST_AUTO_TEST_CASE( test_refc_list )
     my_alloc alloc;
 
     list<my_alloc> lst(nullptr);  // Allocates static global empty list
-    BOOST_CHECK_EQUAL(2, g_alloc_count);
+    BOOST_CHECK_EQUAL(1, g_alloc_count);
 
     {
         eterm<my_alloc> term = list<my_alloc>({1, 2, 3}, alloc);
-        BOOST_CHECK_EQUAL(4, g_alloc_count); // 1 for blob_t, 1 for blob's data
+        BOOST_CHECK_EQUAL(2, g_alloc_count); // 1 for the list blob
         auto term2 = term;
-        BOOST_CHECK_EQUAL(4, g_alloc_count);
+        BOOST_CHECK_EQUAL(2, g_alloc_count);
     }
-    BOOST_CHECK_EQUAL(2, g_alloc_count);
+    BOOST_CHECK_EQUAL(1, g_alloc_count);
 
     {
         // Construct a NIL list
         eterm<my_alloc> term = list<my_alloc>(nullptr);
-        BOOST_CHECK_EQUAL(2, g_alloc_count);
+        BOOST_CHECK_EQUAL(1, g_alloc_count);
         auto term2 = term;
-        BOOST_CHECK_EQUAL(2, g_alloc_count);
+        BOOST_CHECK_EQUAL(1, g_alloc_count);
+    }
+    BOOST_CHECK_EQUAL(1, g_alloc_count);
+}
+
+BOOST_AUTO_TEST_CASE( test_refc_binary )
+{
+    typedef counted_alloc<char> my_alloc;
+    typedef eixx::marshal::binary<my_alloc> binary_t;
+    my_alloc alloc;
+
+    int n = g_alloc_count;
+    {
+        binary_t bin("abcdefghijklmnop", 16, alloc);
+        BOOST_CHECK_EQUAL(n+1, g_alloc_count);
+        eterm<my_alloc> term(bin);
+        BOOST_CHECK_EQUAL(2, bin.use_count());
+        {
+            auto term2 = term;
+            BOOST_CHECK_EQUAL(3, bin.use_count());
+            binary_t bin2 = bin;
+            BOOST_CHECK_EQUAL(4, bin.use_count());
+        }
+        BOOST_CHECK_EQUAL(2, bin.use_count());
+        BOOST_CHECK_EQUAL(n+1, g_alloc_count);
+    }
+    BOOST_CHECK_EQUAL(n, g_alloc_count);
+
+    {
+        // Short binaries and strings are stored inline without allocation
+        binary_t bin("ok", 2, alloc);
+        eterm<my_alloc> term(bin);
+        eterm<my_alloc> str("error", alloc);
+        auto term2 = term;
+        BOOST_CHECK_EQUAL(n, g_alloc_count);
+        BOOST_CHECK(term2.to_binary() == bin);
+        BOOST_CHECK_EQUAL("error", str.to_str().c_str());
+    }
+    BOOST_CHECK_EQUAL(n, g_alloc_count);
+}
+
+BOOST_AUTO_TEST_CASE( test_refc_policy )
+{
+    using eixx::marshal::refcount_traits;
+
+    // The single-threaded pool allocator selects plain reference counting,
+    // other allocators use atomic counters.
+    BOOST_STATIC_ASSERT((std::is_same<plain_counter<int>,
+        refcount_traits<eixx::allocator_t>::counter_type>::value));
+    BOOST_STATIC_ASSERT((std::is_same<eixx::atomic<int>,
+        refcount_traits<counted_alloc<char> >::counter_type>::value));
+
+    eterm<eixx::allocator_t> term = list<eixx::allocator_t>({1, 2, 3});
+    {
+        eterm<eixx::allocator_t> t1(
+            eixx::marshal::binary<eixx::allocator_t>("abcdefghijklmnop", 16));
+        auto t2 = t1;
+        auto t3 = t1;
+        BOOST_CHECK_EQUAL(3, t1.to_binary().use_count());
+        BOOST_CHECK(t2 == t3);
+    }
+    auto copy = term;
+    BOOST_CHECK(copy == term);
+}
+
+BOOST_AUTO_TEST_CASE( test_refc_freeze )
+{
+    typedef counted_alloc<char> my_alloc;
+    typedef eixx::marshal::binary<my_alloc> binary_t;
+    my_alloc alloc;
+
+    list<my_alloc> lst(nullptr);  // Allocates static global empty list
+    int n = g_alloc_count;
+    binary_t bin("abcdefghijklmnop", 16, alloc);
+    {
+        eterm<my_alloc> term = eterm<my_alloc>::format(alloc,
+            "{~i, [{~s, ~i}, ~a], abc}", 1, "abcdefghijk", 2, "xx");
+        eterm<my_alloc> nested = eixx::marshal::tuple<my_alloc>::make(term, bin, alloc);
+        BOOST_CHECK_EQUAL(n+6, g_alloc_count);
+        BOOST_CHECK_EQUAL(2, bin.use_count());
+
+        nested.freeze();
+        BOOST_CHECK_EQUAL(-1, bin.use_count());
+        {
+            std::vector<eterm<my_alloc>> copies(10, nested);
+            copies.emplace_back(nested.to_tuple()[0]);
+            BOOST_CHECK_EQUAL(-1, bin.use_count());
+            BOOST_CHECK(copies[0] == nested);
+        }
+        BOOST_CHECK_EQUAL(n+6, g_alloc_count);
     }
-    BOOST_CHECK_EQUAL(2, g_alloc_count);
+    // Frozen terms are never freed
+    BOOST_CHECK_EQUAL(n+6, g_alloc_count);
+    BOOST_CHECK_EQUAL(-1, bin.use_count());
+    BOOST_CHECK_EQUAL(16u, bin.size());
 }
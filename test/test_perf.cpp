@@ -2,8 +2,10 @@
 //#include "test_alloc.hpp"   // Uses boost::pool_alloc, which does much worse
 #include <eixx/eixx.hpp>
 #include <stdio.h>
-#include <sys/time.h>
-#include <sys/resource.h>
+#include <time.h>
+#include <unordered_map>
+#include <chrono>
+#include <thread>
 
 /// Prevent variable optimization by the compiler
 #ifdef _MSC_VER
@@ -18,20 +20,21 @@ using namespace eixx;
 
 int iterations=1000000;
 size_t g_size = 0;
+// Measures the CPU time of the calling thread. Unlike getrusage(), whose
+// resolution is a scheduler tick, the thread CPU clock has nanosecond
+// resolution, so that short loops don't measure as 0.
 class timer {
-    struct rusage start, end;
-    void begin() { getrusage(RUSAGE_THREAD, &start); }
+    struct timespec start, end;
+    void begin() { clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start); }
 public:
     timer() { begin(); }
 
     void restart() { begin(); }
 
     void sample(const char* title, bool restart = true, size_t out = 0) {
-        getrusage(RUSAGE_THREAD, &end);
-        double diff = (double)(end.ru_utime.tv_sec  - start.ru_utime.tv_sec +
-                               end.ru_stime.tv_sec  - start.ru_stime.tv_sec) +
-                      (double)(end.ru_utime.tv_usec - start.ru_utime.tv_usec +
-                               end.ru_stime.tv_usec - start.ru_stime.tv_usec)/1000000.0;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+        double diff = (double)(end.tv_sec - start.tv_sec) +
+                      (double)(end.tv_nsec - start.tv_nsec)/1000000000.0;
         g_size += out;
 
         // out is used merely to trick the optimizer
@@ -80,6 +83,46 @@ int main(int argc, char* argv[]) {
             { atom t("test"); if (t==a) k++; size += eterm(t).encode_size(); }
         t.sample("Atom2", true, size);
     }
+    for (int j=0; j < iterations; j++)
+        { size += "test"_atom.encode_size(); }
+    t.sample("Atom literal", true, size);
+    {
+        // Dispatch on a message tag with a switch on well-known atom indices,
+        // which compiles to a jump table, and with a chain of comparisons.
+        const atom a[] = {am_call, am_cast, am_error, am_noproc,
+                          am_normal, am_ok, am_request, atom("test")};
+        int k = 0;
+        iterations *= 10;
+        t.restart();
+        for (int j=0; j < iterations; j++) {
+            const atom* p = &a[j & 7];
+            dont_optimize_var(p);
+            switch (p->index()) {
+                case am::call:                  k += 1; break;
+                case am::cast:                  k += 2; break;
+                case am::error:                 k += 3; break;
+                case am::noproc:                k += 4; break;
+                case am::normal:                k += 5; break;
+                case am::ok:                    k += 6; break;
+                case "request"_atom.index():    k += 7; break;
+            }
+        }
+        t.sample("Atom switch", true, size + k);
+        for (int j=0; j < iterations; j++) {
+            const atom* p = &a[j & 7];
+            dont_optimize_var(p);
+            if      (*p == am_call)     k += 1;
+            else if (*p == am_cast)     k += 2;
+            else if (*p == am_error)    k += 3;
+            else if (*p == am_noproc)   k += 4;
+            else if (*p == am_normal)   k += 5;
+            else if (*p == am_ok)       k += 6;
+            else if (*p == am_request)  k += 7;
+        }
+        t.sample("Atom == chain", true, size + k);
+        iterations /= 10;
+        size += k;
+    }
     static const char* ss="This is a test string. This is a test string. This is a test string."; 
     for (int j=0; j < iterations; j++) { 
         binary b(ss, sizeof(ss)); size += eterm(b).encode_size();
@@ -115,6 +158,70 @@ int main(int argc, char* argv[]) {
         t.sample("List2", true, size);
     }
 
+    {
+        // Fan compound terms out to many owners (e.g. delivering one message
+        // to a set of mailboxes) and then drop all the copies.
+        const eterm terms[] = {
+            eterm("test"), eterm(binary(ss, sizeof(ss))), eterm(tuple(l)), eterm(list(l)) };
+        std::vector<eterm> copies;
+        copies.reserve(iterations);
+        t.restart();
+        for (int j=0; j < iterations; j++)
+            copies.emplace_back(terms[j & 3]);
+        t.sample("Copy compound", true, copies.size());
+        copies.clear();
+        t.sample("Destroy compound", true, copies.capacity());
+
+        // Same with immortal terms that skip reference counting.
+        for (auto& e : terms) e.freeze();
+        t.restart();
+        for (int j=0; j < iterations; j++)
+            copies.emplace_back(terms[j & 3]);
+        t.sample("Copy frozen compound", true, copies.size());
+        copies.clear();
+        t.sample("Destroy frozen compound", true, copies.capacity());
+    }
+
+    {
+        // Decode a large tuple of binaries: one allocation per binary blob
+        // and one for the tuple itself.
+        static const char bin[] = "0123456789abcdef";
+        std::vector<eterm> items;
+        for (int j=0; j < 1000; j++)
+            items.emplace_back(binary(bin, sizeof(bin)-1));
+        auto buf = eterm(tuple(items.data(), items.size())).encode(0);
+
+        iterations /= 1000;
+        t.restart();
+        for (int j=0; j < iterations; j++) {
+            eterm x(buf.c_str(), buf.size());
+            size += x.to_tuple().size();
+        }
+        t.sample("Decode 1000 binaries tuple", true, size);
+        iterations *= 1000;
+    }
+
+    {
+        // Decode a control message-like tuple of atoms with and without
+        // a connection's atom cache.
+        auto buf = eterm(tuple::make(atom("gen_server_worker"), atom("my_registered_name"),
+                                     atom("node1@host.example.com"), am_ok, am_undefined,
+                                     atom("record_tag"))).encode(0);
+        for (int j=0; j < iterations; j++) {
+            eterm x(buf.c_str(), buf.size());
+            size += x.to_tuple().size();
+        }
+        t.sample("Decode atoms tuple", true, size);
+        marshal::atom_decode_cache cache;
+        marshal::atom_cache_scope  scope(cache);
+        t.restart();
+        for (int j=0; j < iterations; j++) {
+            eterm x(buf.c_str(), buf.size());
+            size += x.to_tuple().size();
+        }
+        t.sample("Decode atoms tuple (cached)", true, size);
+    }
+
     static const eterm s_md1 =
         eterm::format("{md, Xchg, Instr, [{q, [{BPx,BQty}], [{APx, AQty}]}]}");
     static const eterm s_md2 =
@@ -209,6 +316,162 @@ int main(int argc, char* argv[]) {
         iterations *= 10;
     }
 
+    {
+        // Lookup of {Table, Key} tuples in a hash map rehashes the same keys
+        std::unordered_map<eterm, int> m;
+        std::vector<eterm> keys;
+        for (int i=0; i < 1000; i++) {
+            keys.push_back(tuple{am_md, eterm(string("instrument-name")), i});
+            m[keys.back()] = i;
+        }
+        t.restart();
+        for (int j=0; j < iterations; j++)
+            size += m.find(keys[j % keys.size()])->second;
+        t.sample("Tuple key hash map lookup", true, size);
+    }
+
+    {
+        // Splitting a payload into 64-byte fields
+        binary payload(std::string(64*1024, 'x'));
+        iterations /= 10;
+        t.restart();
+        for (int j=0, e = iterations; j < e; j++)
+            size += payload.slice((j % 1024) * 64, 64).size();
+        t.sample("Binary slice (64 bytes)", true, size);
+
+        t.restart();
+        for (int j=0, e = iterations; j < e; j++)
+            size += binary(payload.data() + (j % 1024) * 64, 64).size();
+        t.sample("Binary copy (64 bytes)", true, size);
+        iterations *= 10;
+    }
+
+    {
+        // Building a list by appending to it. The latency is per element.
+        iterations /= 10;
+        t.restart();
+        for (int j=0, e = iterations / 1000; j < e; j++) {
+            list l;
+            for (int i=0; i < 1000; i++)
+                l.push_back(i);
+            l.close();
+            size += l.length();
+        }
+        t.sample("List push_back", true, size);
+        iterations *= 10;
+    }
+
+    {
+        // Head/tail traversal of a list. The latency is per element.
+        std::vector<eterm> items(100, eterm(1));
+        list l(items.data(), items.size());
+        iterations /= 10;
+        t.restart();
+        for (int j=0, e = iterations / 100; j < e; j++)
+            for (list p = l; !p.empty(); p = p.tail(0))
+                size += p.nth(0).to_long();
+        t.sample("List tail traversal", true, size);
+        iterations *= 10;
+    }
+
+    {
+        // Decoding and encoding a list of 1000 floats. The latency is per
+        // element, and enough passes are made for the packed list's few
+        // nanoseconds per element to add up to a measurable time.
+        std::vector<eterm> items;
+        for (int i=0; i < 1000; i++)
+            items.push_back(eterm(i * 1.5));
+        string s = eterm(list(items.data(), items.size())).encode(0);
+        iterations *= 10;
+        t.restart();
+        for (int j=0, e = iterations / 1000; j < e; j++) {
+            int idx = 1;
+            list l(s.c_str(), idx, s.size());
+            size += l.length();
+        }
+        t.sample("Decode list of doubles", true, size);
+
+        t.restart();
+        for (int j=0, e = iterations / 1000; j < e; j++) {
+            int idx = 1;
+            packed_list<double> l(s.c_str(), idx, s.size());
+            size += l.size();
+        }
+        t.sample("Decode packed_list<double>", true, size);
+
+        int idx = 1;
+        packed_list<double> l(s.c_str(), idx, s.size());
+        std::vector<char> buf(l.encode_size());
+        t.restart();
+        for (int j=0, e = iterations / 1000; j < e; j++) {
+            int idx = 0;
+            l.encode(buf.data(), idx, buf.size());
+            size += idx;
+        }
+        t.sample("Encode packed_list<double>", true, size);
+        iterations /= 10;
+    }
+
+    {
+        // Encoding a charlist of 1000 bytes, which goes out as a string,
+        // and a list of as many integers above 255, which goes out as a
+        // LIST_EXT of INTEGER_EXT. The latency is per element.
+        std::vector<eterm> bytes, ints;
+        for (int i=0; i < 1000; i++) {
+            bytes.push_back(eterm('a' + i % 26));
+            ints.push_back(eterm(256 + 'a' + i % 26));
+        }
+        list lb(bytes.data(), bytes.size()), li(ints.data(), ints.size());
+        std::vector<char> buf(li.encode_size());
+        iterations *= 10;
+        t.restart();
+        for (int j=0, e = iterations / 1000; j < e; j++) {
+            int idx = 0;
+            li.encode(buf.data(), idx, buf.size());
+            size += idx;
+        }
+        t.sample("Encode list of integers", true, size);
+
+        t.restart();
+        for (int j=0, e = iterations / 1000; j < e; j++) {
+            int idx = 0;
+            lb.encode(buf.data(), idx, buf.size());
+            size += idx;
+        }
+        t.sample("Encode list of bytes", true, size);
+        iterations /= 10;
+    }
+
+    {
+        // Concurrent lookup of known atoms by several decoding threads.
+        // Threads don't accumulate CPU time on this thread's timer, so the
+        // wall clock time is reported.
+        const int nthreads = 4;
+        std::vector<std::string> names;
+        for (int i=0; i < 1000; i++) {
+            names.push_back("atom_name_" + std::to_string(i));
+            atom a(names.back());
+        }
+        std::atomic<size_t> found(0);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int n=0; n < nthreads; n++)
+            threads.emplace_back([&, n]() {
+                size_t k = 0;
+                for (int j=0; j < iterations; j++)
+                    k += atom(names[(j + n*7) % names.size()]).index() > 0;
+                found += k;
+            });
+        for (auto& th : threads)
+            th.join();
+        double diff = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        size += found;
+        printf("%30s | latency: %5ldns, speed: %9ld/s (%d threads)\n",
+               "Atom lookup (MT)", long(1000000000.0*diff/iterations),
+               diff > 0 ? long((double)iterations*nthreads / diff) : 0, nthreads);
+        t.restart();
+    }
+
     if (g_size == 0)
         std::cerr << "No iterations performed!" << std::endl;
 